@@ -0,0 +1,104 @@
+#ifndef BOUNDED_QUEUE_HPP
+#define BOUNDED_QUEUE_HPP
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+
+template<typename T>
+class BoundedQueue
+{
+	mutable QMutex mMutex;
+	QWaitCondition mNotEmpty;
+	QWaitCondition mNotFull;
+	QQueue<T> mItems;
+	qsizetype mCapacity;
+	quint64 mItemsPushed;
+	bool mClosed;
+public:
+	BoundedQueue(qsizetype capacity=64)
+	{
+		mCapacity=qMax((qsizetype)1, capacity);
+		mItemsPushed=0;
+		mClosed=false;
+	}
+
+	bool push(T item)
+	{
+		QMutexLocker locker(&mMutex);
+		while(!mClosed && mItems.size()>=mCapacity)
+		{
+			mNotFull.wait(&mMutex);
+		}
+		if(mClosed)
+		{
+			return false;
+		}
+		mItems.enqueue(std::move(item));
+		mItemsPushed++;
+		mNotEmpty.wakeOne();
+		return true;
+	}
+
+	bool tryPush(T item)
+	{
+		QMutexLocker locker(&mMutex);
+		if(mClosed || mItems.size()>=mCapacity)
+		{
+			return false;
+		}
+		mItems.enqueue(std::move(item));
+		mItemsPushed++;
+		mNotEmpty.wakeOne();
+		return true;
+	}
+
+	bool pop(T &item)
+	{
+		QMutexLocker locker(&mMutex);
+		while(!mClosed && mItems.isEmpty())
+		{
+			mNotEmpty.wait(&mMutex);
+		}
+		if(mItems.isEmpty())
+		{
+			return false;
+		}
+		item=mItems.dequeue();
+		mNotFull.wakeOne();
+		return true;
+	}
+
+	void close()
+	{
+		QMutexLocker locker(&mMutex);
+		mClosed=true;
+		mNotEmpty.wakeAll();
+		mNotFull.wakeAll();
+	}
+
+	bool isFull() const
+	{
+		QMutexLocker locker(&mMutex);
+		return mItems.size()>=mCapacity;
+	}
+
+	qsizetype size() const
+	{
+		QMutexLocker locker(&mMutex);
+		return mItems.size();
+	}
+
+	qsizetype capacity() const
+	{
+		return mCapacity;
+	}
+
+	quint64 itemsPushed() const
+	{
+		QMutexLocker locker(&mMutex);
+		return mItemsPushed;
+	}
+};
+
+#endif // BOUNDED_QUEUE_HPP
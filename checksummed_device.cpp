@@ -0,0 +1,244 @@
+#include <cstring>
+#include <QtEndian>
+#include "checksummed_device.hpp"
+#include "util.hpp"
+
+ChecksummedDevice::ChecksummedDevice(QIODevice *device) : mDevice(device)
+{
+	mBlockPos=0;
+	mBlocksNum=0;
+	mEndReached=false;
+	mFailed=false;
+}
+
+ChecksummedDevice::~ChecksummedDevice()
+{
+	close();
+}
+
+bool ChecksummedDevice::open(QIODevice::OpenMode mode)
+{
+	mBlock.clear();
+	mBlockPos=0;
+	mBlocksNum=0;
+	mEndReached=false;
+	mFailed=false;
+	return QIODevice::open(mode | QIODevice::Unbuffered);
+}
+
+void ChecksummedDevice::close()
+{
+	if(isOpen() && (openMode() & QIODevice::WriteOnly))
+	{
+		finish();
+	}
+	QIODevice::close();
+}
+
+bool ChecksummedDevice::isSequential() const
+{
+	return true;
+}
+
+quint32 ChecksummedDevice::blocksNum() const
+{
+	return mBlocksNum;
+}
+
+bool ChecksummedDevice::fail(const QString &error)
+{
+	mFailed=true;
+	setErrorString(error);
+	return false;
+}
+
+bool ChecksummedDevice::writeBlock(const char *data, quint32 length, quint32 crc)
+{
+	char header[BLOCK_HEADER_SIZE];
+	qToLittleEndian<quint32>(length, header);
+	qToLittleEndian<quint32>(crc, header+4);
+	if(mDevice->write(header, BLOCK_HEADER_SIZE)!=BLOCK_HEADER_SIZE || mDevice->write(data, length)!=length)
+	{
+		return fail(QString("failed to write block %1: %2").arg(mBlocksNum).arg(mDevice->errorString()));
+	}
+	if(length>0)
+	{
+		mBlocksNum++;
+	}
+	return true;
+}
+
+qint64 ChecksummedDevice::writeData(const char *data, qint64 size)
+{
+	if(mFailed || mEndReached)
+	{
+		return -1;
+	}
+	qint64 bytesWritten=0;
+	while(bytesWritten<size)
+	{
+		qint64 chunkSize=qMin(size-bytesWritten, qint64(BLOCK_SIZE-mBlock.size()));
+		mBlock.append(data+bytesWritten, chunkSize);
+		bytesWritten+=chunkSize;
+		if(mBlock.size()==BLOCK_SIZE)
+		{
+			if(!writeBlock(mBlock.constData(), mBlock.size(), crc32c(mBlock.constData(), mBlock.size())))
+			{
+				return -1;
+			}
+			mBlock.clear();
+		}
+	}
+	return bytesWritten;
+}
+
+bool ChecksummedDevice::readBlock()
+{
+	qint64 offset=mDevice->pos();
+	char header[BLOCK_HEADER_SIZE];
+	if(mDevice->read(header, BLOCK_HEADER_SIZE)!=BLOCK_HEADER_SIZE)
+	{
+		return fail(QString("truncated before block %1 at offset %2").arg(mBlocksNum).arg(offset));
+	}
+	quint32 length=qFromLittleEndian<quint32>(header);
+	quint32 crc=qFromLittleEndian<quint32>(header+4);
+	mBlock.clear();
+	mBlockPos=0;
+	if(length==0)
+	{
+		if(crc!=mBlocksNum)
+		{
+			return fail(QString("end marker at offset %1 expects %2 blocks, %3 found").arg(offset).arg(crc).arg(mBlocksNum));
+		}
+		mEndReached=true;
+		return true;
+	}
+	if(length>BLOCK_SIZE)
+	{
+		return fail(QString("bad length of block %1 at offset %2").arg(mBlocksNum).arg(offset));
+	}
+	mBlock.resize(length);
+	if(mDevice->read(mBlock.data(), length)!=length)
+	{
+		mBlock.clear();
+		return fail(QString("truncated in block %1 at offset %2").arg(mBlocksNum).arg(offset));
+	}
+	if(crc32c(mBlock.constData(), length)!=crc)
+	{
+		mBlock.clear();
+		return fail(QString("checksum mismatch in block %1 at offset %2").arg(mBlocksNum).arg(offset));
+	}
+	mBlocksNum++;
+	return true;
+}
+
+qint64 ChecksummedDevice::readData(char *data, qint64 max_size)
+{
+	qint64 bytesRead=0;
+	while(bytesRead<max_size)
+	{
+		if(mBlockPos==mBlock.size())
+		{
+			if(mEndReached || mFailed || !readBlock() || mEndReached)
+			{
+				break;
+			}
+		}
+		qint64 chunkSize=qMin(max_size-bytesRead, qint64(mBlock.size()-mBlockPos));
+		memcpy(data+bytesRead, mBlock.constData()+mBlockPos, chunkSize);
+		mBlockPos+=chunkSize;
+		bytesRead+=chunkSize;
+	}
+	if(bytesRead==0 && mFailed)
+	{
+		return -1;
+	}
+	return bytesRead;
+}
+
+// Writing: seals the last block and appends the end marker. Reading: checks
+// that everything up to the end marker has been consumed and nothing follows.
+bool ChecksummedDevice::finish()
+{
+	if(mFailed)
+	{
+		return false;
+	}
+	if(openMode() & QIODevice::WriteOnly)
+	{
+		if(!mEndReached)
+		{
+			if(!mBlock.isEmpty() && !writeBlock(mBlock.constData(), mBlock.size(), crc32c(mBlock.constData(), mBlock.size())))
+			{
+				return false;
+			}
+			mBlock.clear();
+			mEndReached=true;
+			return writeBlock(nullptr, 0, mBlocksNum);
+		}
+		return true;
+	}
+	while(!mEndReached)
+	{
+		if(mBlockPos<mBlock.size() || (readBlock() && !mEndReached))
+		{
+			return fail(QString("unexpected data in block %1").arg(mBlocksNum-1));
+		}
+		if(mFailed)
+		{
+			return false;
+		}
+	}
+	if(!mDevice->atEnd())
+	{
+		return fail(QString("unexpected data after the end marker at offset %1").arg(mDevice->pos()));
+	}
+	return true;
+}
+
+bool ChecksummedDevice::scanBlocks(const uchar *data, qint64 size, QList<ChecksummedBlock> &blocks, QString &error)
+{
+	qint64 offset=0;
+	blocks.clear();
+	while(true)
+	{
+		if(size-offset<BLOCK_HEADER_SIZE)
+		{
+			error=QString("truncated before block %1 at offset %2").arg(blocks.size()).arg(offset);
+			return false;
+		}
+		quint32 length=qFromLittleEndian<quint32>(data+offset);
+		quint32 crc=qFromLittleEndian<quint32>(data+offset+4);
+		if(length==0)
+		{
+			if(crc!=(quint32)blocks.size())
+			{
+				error=QString("end marker at offset %1 expects %2 blocks, %3 found").arg(offset).arg(crc).arg(blocks.size());
+				return false;
+			}
+			if(offset+BLOCK_HEADER_SIZE!=size)
+			{
+				error=QString("unexpected data after the end marker at offset %1").arg(offset+BLOCK_HEADER_SIZE);
+				return false;
+			}
+			return true;
+		}
+		if(length>BLOCK_SIZE)
+		{
+			error=QString("bad length of block %1 at offset %2").arg(blocks.size()).arg(offset);
+			return false;
+		}
+		if(length>size-offset-BLOCK_HEADER_SIZE)
+		{
+			error=QString("truncated in block %1 at offset %2").arg(blocks.size()).arg(offset);
+			return false;
+		}
+		blocks.append({offset+BLOCK_HEADER_SIZE, length, crc});
+		offset+=BLOCK_HEADER_SIZE+length;
+	}
+}
+
+bool ChecksummedDevice::verifyBlock(const uchar *data, const ChecksummedBlock &block)
+{
+	return crc32c((const char *)data+block.offset, block.length)==block.crc;
+}
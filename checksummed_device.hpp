@@ -0,0 +1,47 @@
+#ifndef CHECKSUMMED_DEVICE_HPP
+#define CHECKSUMMED_DEVICE_HPP
+
+#include <QIODevice>
+#include <QByteArray>
+#include <QList>
+
+struct ChecksummedBlock
+{
+	qint64 offset;
+	quint32 length;
+	quint32 crc;
+};
+
+// Splits what is written through it into blocks of up to BLOCK_SIZE bytes,
+// each preceded by its length and CRC32C, and ends the data with an empty
+// block carrying the number of blocks. Reading verifies every block and fails
+// with the number and file offset of the first damaged or missing one.
+class ChecksummedDevice : public QIODevice
+{
+	static constexpr qint64 BLOCK_HEADER_SIZE=8;
+	QIODevice *mDevice;
+	QByteArray mBlock;
+	qsizetype mBlockPos;
+	quint32 mBlocksNum;
+	bool mEndReached;
+	bool mFailed;
+	bool fail(const QString &error);
+	bool writeBlock(const char *data, quint32 length, quint32 crc);
+	bool readBlock();
+protected:
+	qint64 readData(char *data, qint64 max_size) override;
+	qint64 writeData(const char *data, qint64 size) override;
+public:
+	static constexpr quint32 BLOCK_SIZE=256*1024;
+	ChecksummedDevice(QIODevice *device);
+	~ChecksummedDevice();
+	bool open(QIODevice::OpenMode mode) override;
+	void close() override;
+	bool isSequential() const override;
+	bool finish();
+	quint32 blocksNum() const;
+	static bool scanBlocks(const uchar *data, qint64 size, QList<ChecksummedBlock> &blocks, QString &error);
+	static bool verifyBlock(const uchar *data, const ChecksummedBlock &block);
+};
+
+#endif // CHECKSUMMED_DEVICE_HPP
@@ -2,10 +2,36 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QDebug>
 #include "configuration_keeper.hpp"
+#include "stemmer.hpp"
 
 ConfigurationKeeper::ConfigurationKeeper(QObject *parent) : QObject(parent)
 {
+	mUrlFilterOutdated=true;
+	mUrlCanonicalizerOutdated=true;
+	mRecrawlShare=0.0;
+	mRecrawlMinPriority=0.5;
+	mRecrawlDefaultInterval=7*24*3600;
+	mNearDuplicateDistance=3;
+	mIngestWorkers=2;
+	mIngestQueueCapacity=16;
+	mIndexBatchPages=8;
+	mStemmingLanguageFlags=STEMMER_LANGUAGE_NONE;
+	mStopWordLanguageFlags=STEMMER_LANGUAGE_NONE;
+	mBitmapPostingsMinDf=256;
+	mPageCacheBlocks=32;
+	mMemoryBudgetMb=0;
+	mCheckpointInterval=0;
+	mCheckpointPages=0;
+	mCompactionDeletedRatio=0.2;
+	mPeerPort=0;
+	mPeerQueryDeadline=1000;
+	mRobotsEnabled=true;
+	mRobotsUserAgent="Seeklet";
+	mRobotsCacheTTL=24*3600;
+	mSitemapsEnabled=true;
+	mSitemapsPerSession=100;
 	uint64_t WIP; // TODO: default settings
 }
 
@@ -127,8 +153,283 @@ int ConfigurationKeeper::pagesPerSession() const
 	return mPagesPerSessionMax;
 }
 
+void ConfigurationKeeper::setRecrawlShare(double recrawl_share)
+{
+	mRecrawlShare=qBound(0.0, recrawl_share, 1.0);
+}
+
+double ConfigurationKeeper::recrawlShare() const
+{
+	return mRecrawlShare;
+}
+
+void ConfigurationKeeper::setRecrawlMinPriority(double recrawl_min_priority)
+{
+	mRecrawlMinPriority=qBound(0.0, recrawl_min_priority, 1.0);
+}
+
+double ConfigurationKeeper::recrawlMinPriority() const
+{
+	return mRecrawlMinPriority;
+}
+
+void ConfigurationKeeper::setRecrawlDefaultInterval(int recrawl_default_interval)
+{
+	if(recrawl_default_interval<1)
+	{
+		recrawl_default_interval=1;
+	}
+	mRecrawlDefaultInterval=recrawl_default_interval;
+}
+
+int ConfigurationKeeper::recrawlDefaultInterval() const
+{
+	return mRecrawlDefaultInterval;
+}
+
+void ConfigurationKeeper::setNearDuplicateDistance(int near_duplicate_distance)
+{
+	if(near_duplicate_distance<0)
+	{
+		near_duplicate_distance=-1;
+	}
+	mNearDuplicateDistance=near_duplicate_distance;
+}
+
+int ConfigurationKeeper::nearDuplicateDistance() const
+{
+	return mNearDuplicateDistance;
+}
+
+void ConfigurationKeeper::setIngestWorkers(int ingest_workers)
+{
+	if(ingest_workers<1)
+	{
+		ingest_workers=1;
+	}
+	mIngestWorkers=ingest_workers;
+}
+
+int ConfigurationKeeper::ingestWorkers() const
+{
+	return mIngestWorkers;
+}
+
+void ConfigurationKeeper::setIngestQueueCapacity(int ingest_queue_capacity)
+{
+	if(ingest_queue_capacity<1)
+	{
+		ingest_queue_capacity=1;
+	}
+	mIngestQueueCapacity=ingest_queue_capacity;
+}
+
+int ConfigurationKeeper::ingestQueueCapacity() const
+{
+	return mIngestQueueCapacity;
+}
+
+void ConfigurationKeeper::setIndexBatchPages(int index_batch_pages)
+{
+	if(index_batch_pages<1)
+	{
+		index_batch_pages=1;
+	}
+	mIndexBatchPages=index_batch_pages;
+}
+
+int ConfigurationKeeper::indexBatchPages() const
+{
+	return mIndexBatchPages;
+}
+
+void ConfigurationKeeper::setBitmapPostingsMinDf(int bitmap_postings_min_df)
+{
+	if(bitmap_postings_min_df<1)
+	{
+		bitmap_postings_min_df=1;
+	}
+	mBitmapPostingsMinDf=bitmap_postings_min_df;
+}
+
+int ConfigurationKeeper::bitmapPostingsMinDf() const
+{
+	return mBitmapPostingsMinDf;
+}
+
+void ConfigurationKeeper::setPageCacheBlocks(int page_cache_blocks)
+{
+	if(page_cache_blocks<1)
+	{
+		page_cache_blocks=1;
+	}
+	mPageCacheBlocks=page_cache_blocks;
+}
+
+int ConfigurationKeeper::pageCacheBlocks() const
+{
+	return mPageCacheBlocks;
+}
+
+void ConfigurationKeeper::setMemoryBudgetMb(int memory_budget_mb)
+{
+	if(memory_budget_mb<0)
+	{
+		memory_budget_mb=0;
+	}
+	mMemoryBudgetMb=memory_budget_mb;
+}
+
+int ConfigurationKeeper::memoryBudgetMb() const
+{
+	return mMemoryBudgetMb;
+}
+
+void ConfigurationKeeper::setCheckpointInterval(int checkpoint_interval)
+{
+	if(checkpoint_interval<0)
+	{
+		checkpoint_interval=0;
+	}
+	mCheckpointInterval=checkpoint_interval;
+}
+
+int ConfigurationKeeper::checkpointInterval() const
+{
+	return mCheckpointInterval;
+}
+
+void ConfigurationKeeper::setCheckpointPages(int checkpoint_pages)
+{
+	if(checkpoint_pages<0)
+	{
+		checkpoint_pages=0;
+	}
+	mCheckpointPages=checkpoint_pages;
+}
+
+int ConfigurationKeeper::checkpointPages() const
+{
+	return mCheckpointPages;
+}
+
+void ConfigurationKeeper::setCompactionDeletedRatio(double compaction_deleted_ratio)
+{
+	mCompactionDeletedRatio=qBound(0.0, compaction_deleted_ratio, 1.0);
+}
+
+double ConfigurationKeeper::compactionDeletedRatio() const
+{
+	return mCompactionDeletedRatio;
+}
+
+void ConfigurationKeeper::setPeerPort(int peer_port)
+{
+	mPeerPort=qBound(0, peer_port, 65535);
+}
+
+int ConfigurationKeeper::peerPort() const
+{
+	return mPeerPort;
+}
+
+void ConfigurationKeeper::setPeerQueryDeadline(int peer_query_deadline)
+{
+	if(peer_query_deadline<1)
+	{
+		peer_query_deadline=1;
+	}
+	mPeerQueryDeadline=peer_query_deadline;
+}
+
+int ConfigurationKeeper::peerQueryDeadline() const
+{
+	return mPeerQueryDeadline;
+}
+
+void ConfigurationKeeper::addPeer(const QString &peer)
+{
+	if(peer.isEmpty())
+	{
+		return;
+	}
+	if(!mPeers.contains(peer))
+	{
+		mPeers.append(peer);
+	}
+}
+
+void ConfigurationKeeper::removePeer(const QString &peer)
+{
+	mPeers.removeAll(peer);
+}
+
+const QStringList &ConfigurationKeeper::peers() const
+{
+	return mPeers;
+}
+
+void ConfigurationKeeper::setRobotsEnabled(bool robots_enabled)
+{
+	mRobotsEnabled=robots_enabled;
+}
+
+bool ConfigurationKeeper::robotsEnabled() const
+{
+	return mRobotsEnabled;
+}
+
+void ConfigurationKeeper::setRobotsUserAgent(const QString &robots_user_agent)
+{
+	mRobotsUserAgent=robots_user_agent;
+}
+
+const QString &ConfigurationKeeper::robotsUserAgent() const
+{
+	return mRobotsUserAgent;
+}
+
+void ConfigurationKeeper::setRobotsCacheTTL(int robots_cache_ttl)
+{
+	if(robots_cache_ttl<60)
+	{
+		robots_cache_ttl=60;
+	}
+	mRobotsCacheTTL=robots_cache_ttl;
+}
+
+int ConfigurationKeeper::robotsCacheTTL() const
+{
+	return mRobotsCacheTTL;
+}
+
+void ConfigurationKeeper::setSitemapsEnabled(bool sitemaps_enabled)
+{
+	mSitemapsEnabled=sitemaps_enabled;
+}
+
+bool ConfigurationKeeper::sitemapsEnabled() const
+{
+	return mSitemapsEnabled;
+}
+
+void ConfigurationKeeper::setSitemapsPerSession(int sitemaps_per_session)
+{
+	if(sitemaps_per_session<0)
+	{
+		sitemaps_per_session=0;
+	}
+	mSitemapsPerSession=sitemaps_per_session;
+}
+
+int ConfigurationKeeper::sitemapsPerSession() const
+{
+	return mSitemapsPerSession;
+}
+
 void ConfigurationKeeper::addAllowedUrlScheme(const QString &allowed_url_scheme)
 {
+	mUrlFilterOutdated=true;
 	if(allowed_url_scheme.isEmpty())
 	{
 		return;
@@ -141,6 +442,7 @@ void ConfigurationKeeper::addAllowedUrlScheme(const QString &allowed_url_scheme)
 
 void ConfigurationKeeper::removeAllowedUrlScheme(const QString &allowed_url_scheme)
 {
+	mUrlFilterOutdated=true;
 	mAllowedURLSchemes.removeAll(allowed_url_scheme);
 }
 
@@ -173,6 +475,7 @@ const QList<QUrl> &ConfigurationKeeper::startUrls() const
 
 void ConfigurationKeeper::addBlacklistedHost(const QString &blacklisted_host)
 {
+	mUrlFilterOutdated=true;
 	if(blacklisted_host.isEmpty())
 	{
 		return;
@@ -185,6 +488,7 @@ void ConfigurationKeeper::addBlacklistedHost(const QString &blacklisted_host)
 
 void ConfigurationKeeper::removeBlacklistedHost(const QString &blacklisted_host)
 {
+	mUrlFilterOutdated=true;
 	mBlacklistedHosts.remove(blacklisted_host);
 }
 
@@ -195,6 +499,7 @@ const QSet<QString> &ConfigurationKeeper::blacklistedHosts() const
 
 void ConfigurationKeeper::addCrawlingZone(const QUrl &crawling_zone)
 {
+	mUrlFilterOutdated=true;
 	if(crawling_zone.host().isEmpty())
 	{
 		return;
@@ -207,6 +512,7 @@ void ConfigurationKeeper::addCrawlingZone(const QUrl &crawling_zone)
 
 void ConfigurationKeeper::removeCrawlingZone(const QUrl &crawling_zone)
 {
+	mUrlFilterOutdated=true;
 	if(crawling_zone.host().isEmpty())
 	{
 		return;
@@ -223,6 +529,209 @@ const QHash<QString, QStringList> &ConfigurationKeeper::crawlingZones() const
 	return mCrawlingZones;
 }
 
+const UrlFilter &ConfigurationKeeper::urlFilter() const
+{
+	if(mUrlFilterOutdated)
+	{
+		mUrlFilter.compile(mAllowedURLSchemes, mBlacklistedHosts, mCrawlingZones);
+		mUrlFilterOutdated=false;
+	}
+	return mUrlFilter;
+}
+
+void ConfigurationKeeper::addCanonicalStripParameter(const QString &parameter)
+{
+	if(parameter.isEmpty())
+	{
+		return;
+	}
+	if(!mCanonicalStripParameters.contains(parameter))
+	{
+		mCanonicalStripParameters.append(parameter);
+		mUrlCanonicalizerOutdated=true;
+	}
+}
+
+void ConfigurationKeeper::removeCanonicalStripParameter(const QString &parameter)
+{
+	mCanonicalStripParameters.removeAll(parameter);
+	mUrlCanonicalizerOutdated=true;
+}
+
+const QStringList &ConfigurationKeeper::canonicalStripParameters() const
+{
+	return mCanonicalStripParameters;
+}
+
+void ConfigurationKeeper::setCanonicalParameterAllowlist(const QString &host, const QStringList &parameters)
+{
+	if(host.isEmpty())
+	{
+		return;
+	}
+	mCanonicalParameterAllowlists.insert(host, parameters);
+	mUrlCanonicalizerOutdated=true;
+}
+
+void ConfigurationKeeper::removeCanonicalParameterAllowlist(const QString &host)
+{
+	mCanonicalParameterAllowlists.remove(host);
+	mUrlCanonicalizerOutdated=true;
+}
+
+const QHash<QString, QStringList> &ConfigurationKeeper::canonicalParameterAllowlists() const
+{
+	return mCanonicalParameterAllowlists;
+}
+
+void ConfigurationKeeper::addCanonicalIndexFile(const QString &index_file)
+{
+	if(index_file.isEmpty())
+	{
+		return;
+	}
+	if(!mCanonicalIndexFiles.contains(index_file))
+	{
+		mCanonicalIndexFiles.append(index_file);
+		mUrlCanonicalizerOutdated=true;
+	}
+}
+
+void ConfigurationKeeper::removeCanonicalIndexFile(const QString &index_file)
+{
+	mCanonicalIndexFiles.removeAll(index_file);
+	mUrlCanonicalizerOutdated=true;
+}
+
+const QStringList &ConfigurationKeeper::canonicalIndexFiles() const
+{
+	return mCanonicalIndexFiles;
+}
+
+const UrlCanonicalizer &ConfigurationKeeper::urlCanonicalizer() const
+{
+	if(mUrlCanonicalizerOutdated)
+	{
+		mUrlCanonicalizer.compile(mCanonicalStripParameters, mCanonicalParameterAllowlists, mCanonicalIndexFiles);
+		mUrlCanonicalizerOutdated=false;
+	}
+	return mUrlCanonicalizer;
+}
+
+void ConfigurationKeeper::addBlockedResourceType(const QString &blocked_resource_type)
+{
+	if(blocked_resource_type.isEmpty())
+	{
+		return;
+	}
+	if(!mBlockedResourceTypes.contains(blocked_resource_type))
+	{
+		mBlockedResourceTypes.append(blocked_resource_type);
+	}
+}
+
+void ConfigurationKeeper::removeBlockedResourceType(const QString &blocked_resource_type)
+{
+	mBlockedResourceTypes.removeAll(blocked_resource_type);
+}
+
+const QStringList &ConfigurationKeeper::blockedResourceTypes() const
+{
+	return mBlockedResourceTypes;
+}
+
+void ConfigurationKeeper::addBlockedRequestHost(const QString &blocked_request_host)
+{
+	if(blocked_request_host.isEmpty())
+	{
+		return;
+	}
+	if(!mBlockedRequestHosts.contains(blocked_request_host))
+	{
+		mBlockedRequestHosts.append(blocked_request_host);
+	}
+}
+
+void ConfigurationKeeper::removeBlockedRequestHost(const QString &blocked_request_host)
+{
+	mBlockedRequestHosts.removeAll(blocked_request_host);
+}
+
+const QStringList &ConfigurationKeeper::blockedRequestHosts() const
+{
+	return mBlockedRequestHosts;
+}
+
+void ConfigurationKeeper::addStemmingLanguage(const QString &stemming_language)
+{
+	QString language=stemming_language.toLower();
+	int languageFlag=stemmer_language_from_name(language.toStdString());
+	if(languageFlag==STEMMER_LANGUAGE_NONE)
+	{
+		qWarning() << "Unsupported stemming language:" << stemming_language;
+		return;
+	}
+	if(!mStemmingLanguages.contains(language))
+	{
+		mStemmingLanguages.append(language);
+		mStemmingLanguageFlags|=languageFlag;
+	}
+}
+
+void ConfigurationKeeper::removeStemmingLanguage(const QString &stemming_language)
+{
+	QString language=stemming_language.toLower();
+	if(mStemmingLanguages.removeAll(language)>0)
+	{
+		mStemmingLanguageFlags&=~stemmer_language_from_name(language.toStdString());
+	}
+}
+
+const QStringList &ConfigurationKeeper::stemmingLanguages() const
+{
+	return mStemmingLanguages;
+}
+
+int ConfigurationKeeper::stemmingLanguageFlags() const
+{
+	return mStemmingLanguageFlags;
+}
+
+void ConfigurationKeeper::addStopWordLanguage(const QString &stop_word_language)
+{
+	QString language=stop_word_language.toLower();
+	int languageFlag=stemmer_language_from_name(language.toStdString());
+	if(languageFlag==STEMMER_LANGUAGE_NONE)
+	{
+		qWarning() << "Unsupported stop-word language:" << stop_word_language;
+		return;
+	}
+	if(!mStopWordLanguages.contains(language))
+	{
+		mStopWordLanguages.append(language);
+		mStopWordLanguageFlags|=languageFlag;
+	}
+}
+
+void ConfigurationKeeper::removeStopWordLanguage(const QString &stop_word_language)
+{
+	QString language=stop_word_language.toLower();
+	if(mStopWordLanguages.removeAll(language)>0)
+	{
+		mStopWordLanguageFlags&=~stemmer_language_from_name(language.toStdString());
+	}
+}
+
+const QStringList &ConfigurationKeeper::stopWordLanguages() const
+{
+	return mStopWordLanguages;
+}
+
+int ConfigurationKeeper::stopWordLanguageFlags() const
+{
+	return mStopWordLanguageFlags;
+}
+
 void ConfigurationKeeper::loadSettingsFromJsonFile(const QString &path_to_file)
 {
 	if(path_to_file.isEmpty())
@@ -293,11 +802,92 @@ void ConfigurationKeeper::loadSettingsFromJsonFile(const QString &path_to_file)
 	{
 		this->setPagesPerSession(configJsonObject.value("pages_per_session").toDouble());
 	}
+	if(configJsonObject.value("robots_enabled").isBool())
+	{
+		this->setRobotsEnabled(configJsonObject.value("robots_enabled").toBool());
+	}
+	if(configJsonObject.value("robots_user_agent").isString())
+	{
+		this->setRobotsUserAgent(configJsonObject.value("robots_user_agent").toString());
+	}
+	if(configJsonObject.value("robots_cache_ttl").isDouble())
+	{
+		this->setRobotsCacheTTL(configJsonObject.value("robots_cache_ttl").toDouble());
+	}
+	if(configJsonObject.value("sitemaps_enabled").isBool())
+	{
+		this->setSitemapsEnabled(configJsonObject.value("sitemaps_enabled").toBool());
+	}
+	if(configJsonObject.value("sitemaps_per_session").isDouble())
+	{
+		this->setSitemapsPerSession(configJsonObject.value("sitemaps_per_session").toDouble());
+	}
+	if(configJsonObject.value("near_duplicate_distance").isDouble())
+	{
+		this->setNearDuplicateDistance(configJsonObject.value("near_duplicate_distance").toDouble());
+	}
+	if(configJsonObject.value("ingest_workers").isDouble())
+	{
+		this->setIngestWorkers(configJsonObject.value("ingest_workers").toDouble());
+	}
+	if(configJsonObject.value("ingest_queue_capacity").isDouble())
+	{
+		this->setIngestQueueCapacity(configJsonObject.value("ingest_queue_capacity").toDouble());
+	}
+	if(configJsonObject.value("index_batch_pages").isDouble())
+	{
+		this->setIndexBatchPages(configJsonObject.value("index_batch_pages").toDouble());
+	}
+	if(configJsonObject.value("bitmap_postings_min_df").isDouble())
+	{
+		this->setBitmapPostingsMinDf(configJsonObject.value("bitmap_postings_min_df").toDouble());
+	}
+	if(configJsonObject.value("page_cache_blocks").isDouble())
+	{
+		this->setPageCacheBlocks(configJsonObject.value("page_cache_blocks").toDouble());
+	}
+	if(configJsonObject.value("memory_budget_mb").isDouble())
+	{
+		this->setMemoryBudgetMb(configJsonObject.value("memory_budget_mb").toDouble());
+	}
+	if(configJsonObject.value("checkpoint_interval").isDouble())
+	{
+		this->setCheckpointInterval(configJsonObject.value("checkpoint_interval").toDouble());
+	}
+	if(configJsonObject.value("checkpoint_pages").isDouble())
+	{
+		this->setCheckpointPages(configJsonObject.value("checkpoint_pages").toDouble());
+	}
+	if(configJsonObject.value("compaction_deleted_ratio").isDouble())
+	{
+		this->setCompactionDeletedRatio(configJsonObject.value("compaction_deleted_ratio").toDouble());
+	}
+	if(configJsonObject.value("peer_port").isDouble())
+	{
+		this->setPeerPort(configJsonObject.value("peer_port").toDouble());
+	}
+	if(configJsonObject.value("peer_query_deadline").isDouble())
+	{
+		this->setPeerQueryDeadline(configJsonObject.value("peer_query_deadline").toDouble());
+	}
+	if(configJsonObject.value("recrawl_share").isDouble())
+	{
+		this->setRecrawlShare(configJsonObject.value("recrawl_share").toDouble());
+	}
+	if(configJsonObject.value("recrawl_min_priority").isDouble())
+	{
+		this->setRecrawlMinPriority(configJsonObject.value("recrawl_min_priority").toDouble());
+	}
+	if(configJsonObject.value("recrawl_default_interval").isDouble())
+	{
+		this->setRecrawlDefaultInterval(configJsonObject.value("recrawl_default_interval").toDouble());
+	}
 
 	if(configJsonObject.value("allowed_url_schemes").isArray())
 	{
 		const QJsonArray &allowedUrlSchemes=configJsonObject.value("allowed_url_schemes").toArray();
 		mAllowedURLSchemes.clear();
+		mUrlFilterOutdated=true;
 		for(const QJsonValue &allowedUrlScheme : allowedUrlSchemes)
 		{
 			if(allowedUrlScheme.isString())
@@ -324,6 +914,7 @@ void ConfigurationKeeper::loadSettingsFromJsonFile(const QString &path_to_file)
 	{
 		const QJsonArray &blacklistedHosts=configJsonObject.value("black_list").toArray();
 		mBlacklistedHosts.clear();
+		mUrlFilterOutdated=true;
 		for(const QJsonValue &blacklistedHost : blacklistedHosts)
 		{
 			if(blacklistedHost.isString())
@@ -337,6 +928,7 @@ void ConfigurationKeeper::loadSettingsFromJsonFile(const QString &path_to_file)
 	{
 		const QJsonArray &crawlingZones=configJsonObject.value("crawling_zones").toArray();
 		mCrawlingZones.clear();
+		mUrlFilterOutdated=true;
 		for(const QJsonValue &crawlingZone : crawlingZones)
 		{
 			if(crawlingZone.isString())
@@ -345,6 +937,124 @@ void ConfigurationKeeper::loadSettingsFromJsonFile(const QString &path_to_file)
 			}
 		}
 	}
+
+	if(configJsonObject.value("canonical_strip_parameters").isArray())
+	{
+		const QJsonArray &stripParameters=configJsonObject.value("canonical_strip_parameters").toArray();
+		mCanonicalStripParameters.clear();
+		mUrlCanonicalizerOutdated=true;
+		for(const QJsonValue &stripParameter : stripParameters)
+		{
+			if(stripParameter.isString())
+			{
+				this->addCanonicalStripParameter(stripParameter.toString());
+			}
+		}
+	}
+
+	if(configJsonObject.value("canonical_parameter_allowlists").isObject())
+	{
+		const QJsonObject &parameterAllowlists=configJsonObject.value("canonical_parameter_allowlists").toObject();
+		mCanonicalParameterAllowlists.clear();
+		mUrlCanonicalizerOutdated=true;
+		for(QJsonObject::const_iterator allowlistIt=parameterAllowlists.constBegin(); allowlistIt!=parameterAllowlists.constEnd(); allowlistIt++)
+		{
+			if(allowlistIt.value().isArray())
+			{
+				QStringList parameters;
+				const QJsonArray &allowedParameters=allowlistIt.value().toArray();
+				for(const QJsonValue &allowedParameter : allowedParameters)
+				{
+					if(allowedParameter.isString())
+					{
+						parameters.append(allowedParameter.toString());
+					}
+				}
+				this->setCanonicalParameterAllowlist(allowlistIt.key(), parameters);
+			}
+		}
+	}
+
+	if(configJsonObject.value("canonical_index_files").isArray())
+	{
+		const QJsonArray &indexFiles=configJsonObject.value("canonical_index_files").toArray();
+		mCanonicalIndexFiles.clear();
+		mUrlCanonicalizerOutdated=true;
+		for(const QJsonValue &indexFile : indexFiles)
+		{
+			if(indexFile.isString())
+			{
+				this->addCanonicalIndexFile(indexFile.toString());
+			}
+		}
+	}
+
+	if(configJsonObject.value("blocked_resource_types").isArray())
+	{
+		const QJsonArray &blockedResourceTypes=configJsonObject.value("blocked_resource_types").toArray();
+		mBlockedResourceTypes.clear();
+		for(const QJsonValue &blockedResourceType : blockedResourceTypes)
+		{
+			if(blockedResourceType.isString())
+			{
+				this->addBlockedResourceType(blockedResourceType.toString());
+			}
+		}
+	}
+
+	if(configJsonObject.value("blocked_request_hosts").isArray())
+	{
+		const QJsonArray &blockedRequestHosts=configJsonObject.value("blocked_request_hosts").toArray();
+		mBlockedRequestHosts.clear();
+		for(const QJsonValue &blockedRequestHost : blockedRequestHosts)
+		{
+			if(blockedRequestHost.isString())
+			{
+				this->addBlockedRequestHost(blockedRequestHost.toString());
+			}
+		}
+	}
+
+	if(configJsonObject.value("peers").isArray())
+	{
+		const QJsonArray &peers=configJsonObject.value("peers").toArray();
+		mPeers.clear();
+		for(const QJsonValue &peer : peers)
+		{
+			if(peer.isString())
+			{
+				this->addPeer(peer.toString());
+			}
+		}
+	}
+
+	if(configJsonObject.value("stemming_languages").isArray())
+	{
+		const QJsonArray &stemmingLanguages=configJsonObject.value("stemming_languages").toArray();
+		mStemmingLanguages.clear();
+		mStemmingLanguageFlags=STEMMER_LANGUAGE_NONE;
+		for(const QJsonValue &stemmingLanguage : stemmingLanguages)
+		{
+			if(stemmingLanguage.isString())
+			{
+				this->addStemmingLanguage(stemmingLanguage.toString());
+			}
+		}
+	}
+
+	if(configJsonObject.value("stop_word_languages").isArray())
+	{
+		const QJsonArray &stopWordLanguages=configJsonObject.value("stop_word_languages").toArray();
+		mStopWordLanguages.clear();
+		mStopWordLanguageFlags=STEMMER_LANGUAGE_NONE;
+		for(const QJsonValue &stopWordLanguage : stopWordLanguages)
+		{
+			if(stopWordLanguage.isString())
+			{
+				this->addStopWordLanguage(stopWordLanguage.toString());
+			}
+		}
+	}
 }
 
 void ConfigurationKeeper::saveSettingsToJsonFile(const QString &path_to_file) const
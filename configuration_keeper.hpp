@@ -6,6 +6,8 @@
 #include <QStringList>
 #include <QHash>
 #include <QSet>
+#include "url_filter.hpp"
+#include "url_canonicalizer.hpp"
 
 class ConfigurationKeeper : public QObject
 {
@@ -18,10 +20,44 @@ class ConfigurationKeeper : public QObject
 	int mPageLoadingIntervalMin;
 	int mPageLoadingIntervalMax;
 	int mPagesPerSessionMax;
+	double mRecrawlShare;
+	double mRecrawlMinPriority;
+	int mRecrawlDefaultInterval;
+	int mNearDuplicateDistance;
+	int mIngestWorkers;
+	int mIngestQueueCapacity;
+	int mIndexBatchPages;
+	int mBitmapPostingsMinDf;
+	int mPageCacheBlocks;
+	int mMemoryBudgetMb;
+	int mCheckpointInterval;
+	int mCheckpointPages;
+	double mCompactionDeletedRatio;
+	int mPeerPort;
+	int mPeerQueryDeadline;
+	QStringList mPeers;
+	bool mRobotsEnabled;
+	QString mRobotsUserAgent;
+	int mRobotsCacheTTL;
+	bool mSitemapsEnabled;
+	int mSitemapsPerSession;
 	QStringList mAllowedURLSchemes;
 	QList<QUrl> mStartUrls;
 	QSet<QString> mBlacklistedHosts;
 	QHash<QString, QStringList> mCrawlingZones;
+	mutable UrlFilter mUrlFilter;
+	mutable bool mUrlFilterOutdated;
+	QStringList mCanonicalStripParameters;
+	QHash<QString, QStringList> mCanonicalParameterAllowlists;
+	QStringList mCanonicalIndexFiles;
+	mutable UrlCanonicalizer mUrlCanonicalizer;
+	mutable bool mUrlCanonicalizerOutdated;
+	QStringList mBlockedResourceTypes;
+	QStringList mBlockedRequestHosts;
+	QStringList mStemmingLanguages;
+	int mStemmingLanguageFlags;
+	QStringList mStopWordLanguages;
+	int mStopWordLanguageFlags;
 public:
 	ConfigurationKeeper(QObject *parent = nullptr);
 	~ConfigurationKeeper();
@@ -52,6 +88,65 @@ public:
 	void setPagesPerSession(int pages_per_session);
 	int pagesPerSession() const;
 
+	void setRecrawlShare(double recrawl_share);
+	double recrawlShare() const;
+
+	void setRecrawlMinPriority(double recrawl_min_priority);
+	double recrawlMinPriority() const;
+
+	void setRecrawlDefaultInterval(int recrawl_default_interval);
+	int recrawlDefaultInterval() const;
+
+	void setNearDuplicateDistance(int near_duplicate_distance);
+	int nearDuplicateDistance() const;
+
+	void setIngestWorkers(int ingest_workers);
+	int ingestWorkers() const;
+
+	void setIngestQueueCapacity(int ingest_queue_capacity);
+	int ingestQueueCapacity() const;
+
+	void setIndexBatchPages(int index_batch_pages);
+	int indexBatchPages() const;
+
+	void setBitmapPostingsMinDf(int bitmap_postings_min_df);
+	int bitmapPostingsMinDf() const;
+	void setPageCacheBlocks(int page_cache_blocks);
+	int pageCacheBlocks() const;
+	void setMemoryBudgetMb(int memory_budget_mb);
+	int memoryBudgetMb() const;
+	void setCheckpointInterval(int checkpoint_interval);
+	int checkpointInterval() const;
+	void setCheckpointPages(int checkpoint_pages);
+	int checkpointPages() const;
+	void setCompactionDeletedRatio(double compaction_deleted_ratio);
+	double compactionDeletedRatio() const;
+
+	void setPeerPort(int peer_port);
+	int peerPort() const;
+
+	void setPeerQueryDeadline(int peer_query_deadline);
+	int peerQueryDeadline() const;
+
+	void addPeer(const QString &peer);
+	void removePeer(const QString &peer);
+	const QStringList &peers() const;
+
+	void setRobotsEnabled(bool robots_enabled);
+	bool robotsEnabled() const;
+
+	void setRobotsUserAgent(const QString &robots_user_agent);
+	const QString &robotsUserAgent() const;
+
+	void setRobotsCacheTTL(int robots_cache_ttl);
+	int robotsCacheTTL() const;
+
+	void setSitemapsEnabled(bool sitemaps_enabled);
+	bool sitemapsEnabled() const;
+
+	void setSitemapsPerSession(int sitemaps_per_session);
+	int sitemapsPerSession() const;
+
 	void addAllowedUrlScheme(const QString &allowed_url_scheme);
 	void removeAllowedUrlScheme(const QString &allowed_url_scheme);
 	const QStringList &allowedUrlSchemes() const;
@@ -68,6 +163,40 @@ public:
 	void removeCrawlingZone(const QUrl &crawling_zone);
 	const QHash<QString, QStringList> &crawlingZones()const;
 
+	const UrlFilter &urlFilter() const;
+
+	void addCanonicalStripParameter(const QString &parameter);
+	void removeCanonicalStripParameter(const QString &parameter);
+	const QStringList &canonicalStripParameters() const;
+
+	void setCanonicalParameterAllowlist(const QString &host, const QStringList &parameters);
+	void removeCanonicalParameterAllowlist(const QString &host);
+	const QHash<QString, QStringList> &canonicalParameterAllowlists() const;
+
+	void addCanonicalIndexFile(const QString &index_file);
+	void removeCanonicalIndexFile(const QString &index_file);
+	const QStringList &canonicalIndexFiles() const;
+
+	const UrlCanonicalizer &urlCanonicalizer() const;
+
+	void addBlockedResourceType(const QString &blocked_resource_type);
+	void removeBlockedResourceType(const QString &blocked_resource_type);
+	const QStringList &blockedResourceTypes() const;
+
+	void addBlockedRequestHost(const QString &blocked_request_host);
+	void removeBlockedRequestHost(const QString &blocked_request_host);
+	const QStringList &blockedRequestHosts() const;
+
+	void addStemmingLanguage(const QString &stemming_language);
+	void removeStemmingLanguage(const QString &stemming_language);
+	const QStringList &stemmingLanguages() const;
+	int stemmingLanguageFlags() const;
+
+	void addStopWordLanguage(const QString &stop_word_language);
+	void removeStopWordLanguage(const QString &stop_word_language);
+	const QStringList &stopWordLanguages() const;
+	int stopWordLanguageFlags() const;
+
 	void loadSettingsFromJsonFile(const QString &path_to_file);
 	void saveSettingsToJsonFile(const QString &path_to_file) const;
 };
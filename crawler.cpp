@@ -1,5 +1,4 @@
 #include <QFile>
-#include <QRegularExpression>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
@@ -8,37 +7,31 @@
 #include "crawler.hpp"
 #include "util.hpp"
 
-QMap<QString, quint64> ExtractAndCountWords(const QString &text)
-{
-	const QString lowerText=text.toLower();
-	static const QRegularExpression wordsRegex("[^a-zа-яё]+");
-	static const QRegularExpression digitsRegex("^[0-9]+$");
-	QMap<QString, quint64> wordMap;
-	const QStringList words = lowerText.split(wordsRegex, Qt::SkipEmptyParts);
-	for (const QString &word : words)
-	{
-		if (word.length()>2 && word.length()<33)
-		{
-			if (!digitsRegex.match(word).hasMatch())
-			{
-				wordMap[word] += 1;
-			}
-		}
-	}
-	return wordMap;
-}
+static constexpr int CRAWL_DELAY_PICK_ATTEMPTS=8;
 
 Crawler::Crawler(QObject *parent) : QObject(parent)
 {
 	uint32_t rngSeed=QDateTime::currentSecsSinceEpoch()+reinterpret_cast<uintptr_t>(this);
+	mPagesRemaining=0;
+	mRequestsBlockedTotal=0;
+	mFetchesAvoidedByCanonicalization=0;
 	mURLListActive=new QList<QUrl>;
 	mURLListQueued=new QList<QUrl>;
 	mRNG=new QRandomGenerator(rngSeed);
 	mPageLoadingTimer=new QTimer(this);
 	mPageLoadingTimer->setSingleShot(1);
 	mWebPageProcessor=new WebPageProcessor(this);
+	mRecrawlScheduler=new RecrawlScheduler(this);
+	mRobotsCache=new RobotsCache(this);
+	mIngestPipeline=new IngestPipeline(mRecrawlScheduler, this);
 	connect(mPageLoadingTimer, &QTimer::timeout, this, &Crawler::loadNextPage);
 	connect(mWebPageProcessor, &WebPageProcessor::pageProcessingFinished, this, &Crawler::onPageProcessingFinished);
+	connect(mWebPageProcessor, &WebPageProcessor::pageLoadingFail, this, &Crawler::onPageLoadingFailed);
+	connect(mRecrawlScheduler, &RecrawlScheduler::probeFinished, this, &Crawler::onRecrawlProbeFinished);
+	connect(mRobotsCache, &RobotsCache::urlsReleased, this, &Crawler::addURLsToQueue);
+	connect(mRobotsCache, &RobotsCache::sitemapEntriesFound, this, &Crawler::onSitemapEntriesFound);
+	connect(mIngestPipeline, &IngestPipeline::needToIndexBatch, this, &Crawler::needToIndexBatch, Qt::DirectConnection);
+	connect(mIngestPipeline, &IngestPipeline::finished, this, &Crawler::onIngestPipelineFinished);
 }
 
 Crawler::~Crawler()
@@ -51,83 +44,217 @@ Crawler::~Crawler()
 	delete mURLListActive;
 }
 
+void Crawler::scheduleNextPageLoading()
+{
+	if(gSettings->pageLoadingIntervalMin()<gSettings->pageLoadingIntervalMax())
+	{
+		mPageLoadingTimer->start(mRNG->bounded(gSettings->pageLoadingIntervalMin(), gSettings->pageLoadingIntervalMax()));
+	}
+	else
+	{
+		mPageLoadingTimer->start(gSettings->pageLoadingIntervalMin());
+	}
+}
+
+void Crawler::finish()
+{
+	qInfo() << "Fetches avoided by URL canonicalization:" << mFetchesAvoidedByCanonicalization;
+	qInfo() << "Recrawl probes:" << mRecrawlScheduler->probesNotModified() << "not modified," <<
+		mRecrawlScheduler->probesModified() << "modified.";
+	mIngestPipeline->finish();
+}
+
+void Crawler::onIngestPipelineFinished()
+{
+	qDebug("Crawler::onIngestPipelineFinished");
+	mIngestPipeline->printStatistics();
+	mRecrawlScheduler->save();
+	emit finished();
+}
+
 void Crawler::loadNextPage()
 {
 	qDebug("Crawler::loadNextPage");
+	qDebug()<<"Pages remaining:"<<mPagesRemaining;
+	if(mPagesRemaining>0 && !mIngestPipeline->canAccept())
+	{
+		qDebug() << "Ingest pipeline is full, postponing next page loading";
+		scheduleNextPageLoading();
+		return;
+	}
+	if(mPagesRemaining>0)
+	{
+		mPagesRemaining--;
+	}
+	else
+	{
+		finish();
+		return;
+	}
+	if(mRNG->generateDouble()<gSettings->recrawlShare())
+	{
+		const QList<QUrl> dueURLs=mRecrawlScheduler->takeDueURLs(1, gSettings->recrawlMinPriority());
+		if(!dueURLs.isEmpty())
+		{
+			const QUrl &recrawlURL=dueURLs.first();
+			qDebug() << "Revisiting" << recrawlURL.toString();
+			mRecrawlScheduler->probe(recrawlURL, hash_function_128(recrawlURL.toEncoded(QUrl::RemoveFragment)));
+			return;
+		}
+	}
 	if(mURLListActive->isEmpty())
 	{
 		qSwap(mURLListActive, mURLListQueued);
 		if(mURLListActive->isEmpty())
 		{
-			emit finished();
+			if(mRobotsCache->hasPendingFetches())
+			{
+				qDebug() << "Waiting for robots.txt before continuing";
+				mPagesRemaining++;
+				scheduleNextPageLoading();
+				return;
+			}
+			finish();
 			return;
 		}
 	}
-	qDebug()<<"Pages remaining:"<<mPagesRemaining;
-	if(mPagesRemaining>0)
+	QUrl nextURL;
+	for(int attempt=0; attempt<CRAWL_DELAY_PICK_ATTEMPTS && !mURLListActive->isEmpty(); attempt++)
 	{
-		mPagesRemaining--;
+		QUrl candidateURL = mURLListActive->takeAt(mRNG->bounded(0, mURLListActive->count()));
+		if(mRobotsCache->crawlDelayRemaining(candidateURL)>0)
+		{
+			mURLListQueued->append(candidateURL);
+			continue;
+		}
+		nextURL=candidateURL;
+		break;
 	}
-	else
+	if(nextURL.isEmpty())
 	{
-		emit finished();
+		qDebug() << "All picked hosts are within their crawl delay";
+		mPagesRemaining++;
+		scheduleNextPageLoading();
 		return;
 	}
-	QUrl nextURL = mURLListActive->takeAt(mRNG->bounded(0, mURLListActive->count()));
+	mPendingURLsHashes.remove(hash_function_128(nextURL.toEncoded()));
 	qDebug() << nextURL.toString();
 	qDebug() << mURLListActive->count()+mURLListQueued->count() << "URLs pending on the list";
-	mWebPageProcessor->loadPage(nextURL);
+	mRecrawlURLHash.clear();
+	loadPage(nextURL);
+}
+
+void Crawler::loadPage(const QUrl &url)
+{
+	mRobotsCache->recordFetch(url);
+	mWebPageProcessor->loadPage(url);
+}
+
+void Crawler::onRecrawlProbeFinished(QUrl url, bool modified)
+{
+	if(modified)
+	{
+		mRecrawlURLHash=hash_function_128(url.toEncoded(QUrl::RemoveFragment));
+		loadPage(url);
+	}
+	else
+	{
+		qDebug() << "Page not modified since last visit:" << url.toString();
+		scheduleNextPageLoading();
+	}
+}
+
+void Crawler::onSitemapEntriesFound(QList<QUrl> urls, QList<qint64> last_modified)
+{
+	qDebug() << "Sitemap entries found:" << urls.size();
+	for(qsizetype i=0; i<urls.size(); i++)
+	{
+		QUrl url=gSettings->urlCanonicalizer().canonicalize(urls.at(i));
+		QByteArray urlHash=hash_function_128(url.toEncoded());
+		if(mRecrawlScheduler->contains(urlHash))
+		{
+			mRecrawlScheduler->setLastModifiedHint(urlHash, url, last_modified.value(i, 0));
+		}
+		else
+		{
+			addURLToQueue(url);
+		}
+	}
 }
 
 void Crawler::onPageProcessingFinished()
 {
 	qDebug("Crawler::onPageProcessingFinished");
 
-	const QString &pageContentText = mWebPageProcessor->getPageContentAsTEXT();
-	const QString &pageContentHtml = mWebPageProcessor->getPageContentAsHTML();
 	const QList<QUrl> &pageLinksList = mWebPageProcessor->getPageLinks();
-	PageMetadata pageMetadata;
+	FetchedPage fetchedPage;
 
-	pageMetadata.timeStamp = QDateTime::currentDateTime();
-	pageMetadata.title = mWebPageProcessor->getPageTitle();
-	pageMetadata.url = mWebPageProcessor->getPageURLEncoded(QUrl::RemoveFragment);
-	pageMetadata.contentHash = hash_function_128(pageContentHtml.toUtf8());
-	pageMetadata.urlHash = hash_function_128(pageMetadata.url);
-
-	qDebug() << pageMetadata.title << "\n" << pageMetadata.url;
-
-	QMap<QString, quint64> pageWords = ExtractAndCountWords(pageContentText);
-	QMap<QString, quint64>::ConstIterator pageWordsIt;
-	for(pageWordsIt=pageWords.constBegin(); pageWordsIt!=pageWords.constEnd(); pageWordsIt++)
+	fetchedPage.timeStamp = QDateTime::currentDateTime();
+	fetchedPage.title = mWebPageProcessor->getPageTitle();
+	fetchedPage.text = mWebPageProcessor->getPageContentAsTEXT();
+	QUrl pageURL=gSettings->urlCanonicalizer().canonicalize(mWebPageProcessor->getPageURL());
+	const QUrl &pageCanonicalURL=mWebPageProcessor->getPageCanonicalURL();
+	if(pageCanonicalURL.isValid() && pageCanonicalURL.host()==pageURL.host())
 	{
-		const QString &pageWord=pageWordsIt.key();
-		quint64 wordTf=pageWordsIt.value();
-		if(wordTf>0 && !pageWord.isEmpty())
+		QUrl canonicalURL=gSettings->urlCanonicalizer().canonicalize(pageCanonicalURL);
+		if(canonicalURL!=pageURL)
 		{
-			quint64 wordHash=hash_function_64(pageWord.toUtf8());
-			pageMetadata.wordsAsHashes.insert(wordHash, wordTf);
-			pageMetadata.wordsTotal+=wordTf;
-			emit needToAddWord(pageWord);
+			qDebug() << "Page declares canonical URL" << canonicalURL.toString();
+			mVisitedURLsHashes.insert(hash_function_128(pageURL.toEncoded()));
+			pageURL=canonicalURL;
 		}
 	}
+	fetchedPage.url = pageURL.toEncoded();
+	fetchedPage.urlHash = hash_function_128(fetchedPage.url);
+	fetchedPage.indexingAllowed = mWebPageProcessor->isPageIndexingAllowed();
+
+	qDebug() << fetchedPage.title << "\n" << fetchedPage.url;
+
+	mRequestsBlockedTotal+=mWebPageProcessor->getRequestsBlocked();
+	qDebug() << "Requests blocked:" << mWebPageProcessor->getRequestsBlocked() <<
+		"allowed:" << mWebPageProcessor->getRequestsAllowed() << "session total blocked:" << mRequestsBlockedTotal;
 
-	if(pageMetadata.wordsTotal>0)
+	if(!fetchedPage.indexingAllowed)
 	{
-		emit needToAddPage(pageMetadata);
+		qDebug() << "Page is not indexed due to meta robots:" << mWebPageProcessor->getPageRobots();
 	}
 
-	mVisitedURLsHashes.insert(pageMetadata.urlHash);
-
-	addURLsToQueue(pageLinksList);
+	mVisitedURLsHashes.insert(fetchedPage.urlHash);
+	// A revisit is released by recordFetch() unless the page is dropped or
+	// recorded under its canonical URL instead.
+	if(!mRecrawlURLHash.isEmpty() && mRecrawlURLHash!=fetchedPage.urlHash)
+	{
+		mRecrawlScheduler->recordFetchFailed(mRecrawlURLHash);
+	}
+	QByteArray pageURLHash=fetchedPage.urlHash;
+	if(!mIngestPipeline->submit(std::move(fetchedPage)))
+	{
+		qWarning() << "Ingest pipeline is full, page dropped:" << pageURL.toString();
+		mRecrawlScheduler->recordFetchFailed(pageURLHash);
+	}
+	mRecrawlURLHash.clear();
 
-	if(gSettings->pageLoadingIntervalMin()<gSettings->pageLoadingIntervalMax())
+	if(mWebPageProcessor->isPageFollowingAllowed())
 	{
-		mPageLoadingTimer->start(mRNG->bounded(gSettings->pageLoadingIntervalMin(), gSettings->pageLoadingIntervalMax()));
+		addURLsToQueue(pageLinksList);
 	}
 	else
 	{
-		mPageLoadingTimer->start(gSettings->pageLoadingIntervalMin());
+		qDebug() << "Page links are not followed due to meta robots:" << mWebPageProcessor->getPageRobots();
+	}
+
+	scheduleNextPageLoading();
+}
+
+void Crawler::onPageLoadingFailed()
+{
+	qDebug() << "Page loading failed:" << mWebPageProcessor->getPageURL().toString();
+	if(!mRecrawlURLHash.isEmpty())
+	{
+		mRecrawlScheduler->recordFetchFailed(mRecrawlURLHash);
+		mRecrawlURLHash.clear();
 	}
+	scheduleNextPageLoading();
 }
 
 void Crawler::addURLsToQueue(const QList<QUrl> &urls)
@@ -142,59 +269,45 @@ void Crawler::addURLsToQueue(const QList<QUrl> &urls)
 void Crawler::addURLToQueue(const QUrl &url)
 {
 	qDebug("Crawler::addURLToQueue");
-	QUrl urlAdjusted=url.adjusted(QUrl::RemoveFragment);
-	QByteArray urlHash = hash_function_128(urlAdjusted.toEncoded());
-	QString URLString=urlAdjusted.toString();
-	qDebug() << URLString;
-	bool skipThisURL=false;
-	if(gSettings->blacklistedHosts().contains(urlAdjusted.host()))
-	{
-		skipThisURL=true;
-		qDebug() << "Skipping blacklisted host";
-	}
-	else if(mVisitedURLsHashes.contains(urlHash))
+	QUrl urlAdjusted=gSettings->urlCanonicalizer().canonicalize(url);
+	qDebug() << urlAdjusted;
+	switch(gSettings->urlFilter().admit(urlAdjusted))
 	{
-		skipThisURL=true;
-		qDebug() << "Skipping visited page";
+		case UrlFilter::RejectedScheme:
+			qDebug() << "Skipping URL due to inacceptable scheme:" << urlAdjusted.scheme();
+			return;
+		case UrlFilter::RejectedHost:
+			qDebug() << "Skipping blacklisted host";
+			return;
+		case UrlFilter::RejectedZone:
+			qDebug() << "Skipping page outside crawling zone";
+			return;
+		case UrlFilter::Admitted:
+			break;
 	}
-	bool urlAllowedByZonePrefix=1;
-	if(gSettings->crawlingZones().contains(urlAdjusted.host()))
+	QByteArray urlHash = hash_function_128(urlAdjusted.toEncoded());
+	if(mVisitedURLsHashes.contains(urlHash) || mPendingURLsHashes.contains(urlHash))
 	{
-		urlAllowedByZonePrefix=0;
-		const QStringList &zonePrefixList=gSettings->crawlingZones()[urlAdjusted.host()];
-		for(const QString &zonePrefix : zonePrefixList)
+		if(urlAdjusted!=url.adjusted(QUrl::RemoveFragment))
 		{
-			if(!zonePrefix.isEmpty())
-			{
-				if(URLString.startsWith(zonePrefix))
-				{
-					urlAllowedByZonePrefix=1;
-					break;
-				}
-			}
+			mFetchesAvoidedByCanonicalization++;
 		}
+		qDebug() << "Skipping visited or duplicate URL";
+		return;
 	}
-	if(!urlAllowedByZonePrefix)
+	RobotsCache::Verdict robotsVerdict=mRobotsCache->check(urlAdjusted);
+	if(robotsVerdict==RobotsCache::Disallowed)
 	{
-		skipThisURL=true;
-		qDebug() << "Skipping page outside crawling zone";
+		qDebug() << "Skipping URL disallowed by robots.txt";
 	}
-	if(!gSettings->allowedUrlSchemes().isEmpty())
+	else if(robotsVerdict==RobotsCache::Pending)
 	{
-		if(!gSettings->allowedUrlSchemes().contains(urlAdjusted.scheme()))
-		{
-			skipThisURL=true;
-			qDebug() << "Skipping URL due to inacceptable scheme:" << urlAdjusted.scheme();
-		}
+		qDebug() << "Waiting for robots.txt";
 	}
-	if(mURLListQueued->contains(urlAdjusted) || mURLListActive->contains(urlAdjusted))
-	{
-		skipThisURL=true;
-		qDebug() << "Skipping duplicate URL";
-	}
-	if(skipThisURL!=true)
+	else
 	{
 		mURLListQueued->append(urlAdjusted);
+		mPendingURLsHashes.insert(urlHash);
 		qDebug() << "Adding URL to the processing list";
 	}
 }
@@ -203,18 +316,19 @@ void Crawler::start()
 {
 	qDebug("Crawler::start");
 	mPagesRemaining=gSettings->pagesPerSession();
+	mIngestPipeline->start();
+	mRecrawlScheduler->load();
+	const QList<QByteArray> knownURLHashes=mRecrawlScheduler->knownURLHashes();
+	for(const QByteArray &urlHash : knownURLHashes)
+	{
+		mVisitedURLsHashes.insert(urlHash);
+	}
+	// Start URLs the scheduler already tracks are left to its recrawl queue.
 	addURLsToQueue(gSettings->startUrls());
 	if(!mPageLoadingTimer->isActive())
 	{
 		mWebPageProcessor->loadCookiesFromFirefoxProfile(gSettings->fireFoxProfileDirectory());
-		if(gSettings->pageLoadingIntervalMin()<gSettings->pageLoadingIntervalMax())
-		{
-			mPageLoadingTimer->start(mRNG->bounded(gSettings->pageLoadingIntervalMin(), gSettings->pageLoadingIntervalMax()));
-		}
-		else
-		{
-			mPageLoadingTimer->start(gSettings->pageLoadingIntervalMin());
-		}
+		scheduleNextPageLoading();
 		emit started();
 	}
 }
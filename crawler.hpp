@@ -4,19 +4,36 @@
 #include <QRandomGenerator>
 #include "web_page_processor.hpp"
 #include "indexer.hpp"
+#include "recrawl_scheduler.hpp"
+#include "robots_cache.hpp"
+#include "ingest_pipeline.hpp"
 
 class Crawler : public QObject
 {
 	Q_OBJECT
 	uint64_t mPagesRemaining;
+	quint64 mRequestsBlockedTotal;
+	quint64 mFetchesAvoidedByCanonicalization;
 	QRandomGenerator *mRNG;
 	QTimer *mPageLoadingTimer;
 	WebPageProcessor *mWebPageProcessor;
+	RecrawlScheduler *mRecrawlScheduler;
+	RobotsCache *mRobotsCache;
+	IngestPipeline *mIngestPipeline;
 	QList<QUrl> *mURLListActive, *mURLListQueued;
 	QSet<QByteArray> mVisitedURLsHashes;
+	QSet<QByteArray> mPendingURLsHashes;
+	QByteArray mRecrawlURLHash;
+	void scheduleNextPageLoading();
+	void finish();
+	void loadPage(const QUrl &url);
 private slots:
 	void loadNextPage();
 	void onPageProcessingFinished();
+	void onPageLoadingFailed();
+	void onRecrawlProbeFinished(QUrl url, bool modified);
+	void onSitemapEntriesFound(QList<QUrl> urls, QList<qint64> last_modified);
+	void onIngestPipelineFinished();
 public:
 	Crawler(QObject *parent=nullptr);
 	~Crawler();
@@ -28,8 +45,7 @@ public slots:
 signals:
 	void started();
 	void finished();
-	void needToAddPage(PageMetadata page_metadata);
-	void needToAddWord(QString word);
+	void needToIndexBatch(IndexBatchPointer batch);
 };
 
 #endif // CRAWLER_HPP
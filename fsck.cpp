@@ -0,0 +1,265 @@
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QThreadPool>
+#include <QDebug>
+#include "main.hpp"
+#include "indexer.hpp"
+#include "checksummed_device.hpp"
+
+ConfigurationKeeper *gSettings;
+
+// Exit codes follow fsck(8).
+static constexpr int FSCK_OK=0;
+static constexpr int FSCK_REPAIRED=1;
+static constexpr int FSCK_DAMAGED=4;
+static constexpr int FSCK_USAGE=16;
+
+static constexpr qsizetype VERIFY_BLOCKS_PER_TASK=64;
+
+// Checks every block of an index file against its CRC32C. The file is mapped
+// once and its blocks are spread over a thread pool.
+static bool verify_blocks(const QString &file_path)
+{
+	QFile file(file_path);
+	if(!file.open(QIODevice::ReadOnly))
+	{
+		qWarning() << "Failed to open" << file_path << "for reading";
+		return false;
+	}
+	const uchar *data=file.size()>0 ? file.map(0, file.size()) : nullptr;
+	if(file.size()>0 && nullptr==data)
+	{
+		qWarning() << "Failed to map" << file_path << file.errorString();
+		return false;
+	}
+	QList<ChecksummedBlock> blocks;
+	QString error;
+	bool complete=ChecksummedDevice::scanBlocks(data, file.size(), blocks, error);
+	QList<quint8> damagedBlocks(blocks.size(), 0);
+	quint8 *damagedBlocksData=damagedBlocks.data();
+	QThreadPool pool;
+	for(qsizetype first=0; first<blocks.size(); first+=VERIFY_BLOCKS_PER_TASK)
+	{
+		qsizetype last=qMin(first+VERIFY_BLOCKS_PER_TASK, blocks.size());
+		pool.start([data, &blocks, damagedBlocksData, first, last]()
+			{
+				for(qsizetype block=first; block<last; block++)
+				{
+					damagedBlocksData[block]=!ChecksummedDevice::verifyBlock(data, blocks.at(block));
+				}
+			});
+	}
+	pool.waitForDone();
+	qsizetype damagedBlocksNum=0;
+	for(qsizetype block=0; block<blocks.size(); block++)
+	{
+		if(damagedBlocks.at(block))
+		{
+			qWarning() << file_path << "checksum mismatch in block" << block << "with data at offset" << blocks.at(block).offset;
+			damagedBlocksNum++;
+		}
+	}
+	if(!complete)
+	{
+		qWarning() << file_path << error;
+	}
+	qInfo() << file_path << blocks.size() << "blocks," << damagedBlocksNum << "damaged," << (complete ? "complete" : "incomplete");
+	return complete && damagedBlocksNum==0;
+}
+
+template<typename Function> static bool read_index_file(const QString &file_path, Function read)
+{
+	QFile file(file_path);
+	if(!file.open(QIODevice::ReadOnly))
+	{
+		qWarning() << "Failed to open" << file_path << "for reading";
+		return false;
+	}
+	ChecksummedDevice fileBlocks(&file);
+	fileBlocks.open(QIODevice::ReadOnly);
+	QDataStream fileStream(&fileBlocks);
+	fileStream.setVersion(QDataStream::Qt_6_0);
+	quint64 dataStreamVersion;
+	quint32 indexFormatVersion;
+	fileStream >> dataStreamVersion;
+	fileStream >> indexFormatVersion;
+	if(dataStreamVersion!=(quint64)(QDataStream::Qt_6_0) || indexFormatVersion!=INDEX_FORMAT_VERSION)
+	{
+		qWarning() << "Unknown file version. Cannot load data from:" << file_path;
+		return false;
+	}
+	if(!read(fileStream) || fileStream.status()!=QDataStream::Ok || !fileBlocks.finish())
+	{
+		qWarning() << "Failed to read" << file_path << fileBlocks.errorString();
+		return false;
+	}
+	return true;
+}
+
+template<typename Function> static bool write_index_file(const QString &file_path, Function write)
+{
+	QSaveFile file(file_path);
+	if(!file.open(QIODevice::WriteOnly))
+	{
+		qWarning() << "Failed to open" << file_path << "for writing";
+		return false;
+	}
+	ChecksummedDevice fileBlocks(&file);
+	fileBlocks.open(QIODevice::WriteOnly);
+	QDataStream fileStream(&fileBlocks);
+	fileStream.setVersion(QDataStream::Qt_6_0);
+	fileStream << (quint64)QDataStream::Qt_6_0;
+	fileStream << INDEX_FORMAT_VERSION;
+	write(fileStream);
+	if(!fileBlocks.finish() || !file.commit())
+	{
+		qWarning() << "Failed to write" << file_path << fileBlocks.errorString() << file.errorString();
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	QCoreApplication fsckApp(argc, argv);
+	gSettings=new ConfigurationKeeper();
+	gSettings->loadSettingsFromJsonFile("crawler.json");
+
+	QStringList arguments=fsckApp.arguments().mid(1);
+	bool repair=arguments.removeAll("--repair")>0;
+	if(arguments.size()>1 || (arguments.size()==1 && arguments.first().startsWith("-")))
+	{
+		qWarning() << "Usage: seeklet-fsck [--repair] [database_directory]";
+		return FSCK_USAGE;
+	}
+	QDir dbDir(arguments.isEmpty() ? gSettings->databaseDirectory() : arguments.first());
+	QString dltFilePath=dbDir.filePath("index_dlt.dat");
+	QString tocFilePath=dbDir.filePath("index_toc.dat");
+	QString mdFilePath=dbDir.filePath("index_md.dat");
+	QString pagesFilePath=dbDir.filePath("index_pages.dat");
+
+	bool dltValid=verify_blocks(dltFilePath);
+	bool tocValid=verify_blocks(tocFilePath);
+	bool pagesValid=verify_blocks(pagesFilePath);
+	bool mdValid=verify_blocks(mdFilePath);
+
+	TermDictionary dictionary;
+	dltValid=dltValid && read_index_file(dltFilePath, [&dictionary](QDataStream &stream)
+		{
+			return dictionary.readFromStream(stream);
+		});
+	QHash<quint32, QSet<QByteArray>> tableOfContents;
+	tocValid=tocValid && read_index_file(tocFilePath, [&tableOfContents](QDataStream &stream)
+		{
+			stream >> tableOfContents;
+			return stream.status()==QDataStream::Ok;
+		});
+	PageStore pageStore;
+	pagesValid=pagesValid && read_index_file(pagesFilePath, [&pageStore](QDataStream &stream)
+		{
+			return pageStore.readFromStream(stream);
+		});
+	QList<PageMetadata> pages;
+	mdValid=mdValid && read_index_file(mdFilePath, [&pages](QDataStream &stream)
+		{
+			quint64 numOfPages;
+			stream >> numOfPages;
+			for(quint64 page=0; page<numOfPages && stream.status()==QDataStream::Ok; page++)
+			{
+				PageMetadata pageMetadata;
+				pageMetadata.readFromStream(stream);
+				pages.append(pageMetadata);
+			}
+			return stream.status()==QDataStream::Ok;
+		});
+
+	// Metadata records must be unique and point into the page store and the
+	// dictionary.
+	qsizetype badPages=0;
+	QSet<QByteArray> contentHashes, urlHashes;
+	QSet<quint32> docIds;
+	QHash<quint32, QSet<QByteArray>> expectedTableOfContents;
+	for(const PageMetadata &page : std::as_const(pages))
+	{
+		const QByteArray contentHash=page.contentHashBytes();
+		const QByteArray urlHash=page.urlHashBytes();
+		bool valid=!contentHashes.contains(contentHash) && !urlHashes.contains(urlHash) && !docIds.contains(page.docId) &&
+			(!pagesValid || page.docId<pageStore.size());
+		page.forEachTerm([&](quint32 term_id, quint32 tf)
+			{
+				if(tf==0 || (dltValid && term_id>=dictionary.size()))
+				{
+					valid=false;
+				}
+				expectedTableOfContents[term_id].insert(contentHash);
+			});
+		contentHashes.insert(contentHash);
+		urlHashes.insert(urlHash);
+		docIds.insert(page.docId);
+		if(!valid)
+		{
+			badPages++;
+		}
+	}
+	if(badPages>0)
+	{
+		qWarning() << mdFilePath << badPages << "of" << pages.size() << "metadata records are inconsistent";
+		mdValid=false;
+	}
+
+	// Every page must be listed under each of its terms, and nothing else may be.
+	qsizetype missingPostings=0, danglingPostings=0;
+	if(tocValid && mdValid)
+	{
+		QHash<quint32, QSet<QByteArray>>::const_iterator tocIt;
+		for(tocIt=expectedTableOfContents.constBegin(); tocIt!=expectedTableOfContents.constEnd(); tocIt++)
+		{
+			const QSet<QByteArray> postings=tableOfContents.value(tocIt.key());
+			for(const QByteArray &contentHash : tocIt.value())
+			{
+				if(!postings.contains(contentHash))
+				{
+					missingPostings++;
+				}
+			}
+		}
+		for(tocIt=tableOfContents.constBegin(); tocIt!=tableOfContents.constEnd(); tocIt++)
+		{
+			const QSet<QByteArray> postings=expectedTableOfContents.value(tocIt.key());
+			for(const QByteArray &contentHash : tocIt.value())
+			{
+				if(!postings.contains(contentHash))
+				{
+					danglingPostings++;
+				}
+			}
+		}
+		qInfo() << tocFilePath << missingPostings << "missing and" << danglingPostings << "dangling postings";
+	}
+	bool tocConsistent=tocValid && missingPostings==0 && danglingPostings==0;
+
+	int result=FSCK_OK;
+	if(!dltValid || !pagesValid || !mdValid)
+	{
+		result|=FSCK_DAMAGED;
+	}
+	if(!tocConsistent)
+	{
+		if(repair && dltValid && mdValid && write_index_file(tocFilePath, [&expectedTableOfContents](QDataStream &stream)
+			{
+				stream << expectedTableOfContents;
+			}))
+		{
+			qInfo() << "Table of contents has been rebuilt from metadata:" << expectedTableOfContents.size() << "records saved.";
+			result|=FSCK_REPAIRED;
+		}
+		else
+		{
+			result|=FSCK_DAMAGED;
+		}
+	}
+	qInfo() << "Index" << dbDir.path() << (result==FSCK_OK ? "is clean" : (result==FSCK_REPAIRED ? "has been repaired" : "is damaged"));
+	return result;
+}
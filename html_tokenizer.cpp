@@ -0,0 +1,113 @@
+#include <string.h>
+#include "html_tokenizer.hpp"
+
+struct HtmlTagName
+{
+	const char *name;
+	HtmlTagId id;
+};
+
+struct HtmlEntityName
+{
+	const char *name;
+	uint32_t codePoint;
+};
+
+static const HtmlTagName gHtmlTagNames[]=
+{
+	{"a", HTML_TAG_A},
+	{"area", HTML_TAG_AREA},
+	{"base", HTML_TAG_BASE},
+	{"link", HTML_TAG_LINK},
+	{"meta", HTML_TAG_META},
+	{"script", HTML_TAG_SCRIPT},
+	{"style", HTML_TAG_STYLE},
+	{"noscript", HTML_TAG_NOSCRIPT},
+	{"template", HTML_TAG_TEMPLATE},
+	{"title", HTML_TAG_TITLE},
+	{"textarea", HTML_TAG_TEXTAREA},
+	{"address", HTML_TAG_BLOCK},
+	{"article", HTML_TAG_BLOCK},
+	{"aside", HTML_TAG_BLOCK},
+	{"blockquote", HTML_TAG_BLOCK},
+	{"br", HTML_TAG_BLOCK},
+	{"dd", HTML_TAG_BLOCK},
+	{"div", HTML_TAG_BLOCK},
+	{"dl", HTML_TAG_BLOCK},
+	{"dt", HTML_TAG_BLOCK},
+	{"figcaption", HTML_TAG_BLOCK},
+	{"footer", HTML_TAG_BLOCK},
+	{"form", HTML_TAG_BLOCK},
+	{"h1", HTML_TAG_BLOCK},
+	{"h2", HTML_TAG_BLOCK},
+	{"h3", HTML_TAG_BLOCK},
+	{"h4", HTML_TAG_BLOCK},
+	{"h5", HTML_TAG_BLOCK},
+	{"h6", HTML_TAG_BLOCK},
+	{"header", HTML_TAG_BLOCK},
+	{"hr", HTML_TAG_BLOCK},
+	{"li", HTML_TAG_BLOCK},
+	{"main", HTML_TAG_BLOCK},
+	{"nav", HTML_TAG_BLOCK},
+	{"ol", HTML_TAG_BLOCK},
+	{"option", HTML_TAG_BLOCK},
+	{"p", HTML_TAG_BLOCK},
+	{"pre", HTML_TAG_BLOCK},
+	{"section", HTML_TAG_BLOCK},
+	{"table", HTML_TAG_BLOCK},
+	{"td", HTML_TAG_BLOCK},
+	{"th", HTML_TAG_BLOCK},
+	{"tr", HTML_TAG_BLOCK},
+	{"ul", HTML_TAG_BLOCK}
+};
+
+static const HtmlEntityName gHtmlEntityNames[]=
+{
+	{"amp", '&'},
+	{"lt", '<'},
+	{"gt", '>'},
+	{"quot", '"'},
+	{"apos", '\''},
+	{"nbsp", 0x00A0},
+	{"shy", 0x00AD},
+	{"copy", 0x00A9},
+	{"reg", 0x00AE},
+	{"laquo", 0x00AB},
+	{"raquo", 0x00BB},
+	{"ndash", 0x2013},
+	{"mdash", 0x2014},
+	{"lsquo", 0x2018},
+	{"rsquo", 0x2019},
+	{"ldquo", 0x201C},
+	{"rdquo", 0x201D},
+	{"bull", 0x2022},
+	{"hellip", 0x2026},
+	{"euro", 0x20AC},
+	{"trade", 0x2122},
+	{"times", 0x00D7},
+	{"middot", 0x00B7}
+};
+
+HtmlTagId html_tag_id(const char *lowercase_name, size_t len)
+{
+	for(const HtmlTagName &tag : gHtmlTagNames)
+	{
+		if(strlen(tag.name)==len && memcmp(tag.name, lowercase_name, len)==0)
+		{
+			return tag.id;
+		}
+	}
+	return HTML_TAG_OTHER;
+}
+
+uint32_t html_named_entity(const char *name, size_t len)
+{
+	for(const HtmlEntityName &entity : gHtmlEntityNames)
+	{
+		if(strlen(entity.name)==len && memcmp(entity.name, name, len)==0)
+		{
+			return entity.codePoint;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,568 @@
+#ifndef HTML_TOKENIZER_HPP
+#define HTML_TOKENIZER_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+// Streaming, tree-less HTML scanner. Works on UTF-8 (char) or UTF-16 (char16_t)
+// buffers and reports only what the crawler needs through the handler:
+//   void onLink(const CharT *href, size_t len, bool nofollow);
+//   void onBase(const CharT *href, size_t len);
+//   void onCanonical(const CharT *href, size_t len);
+//   void onMetaRobots(const CharT *content, size_t len);
+//   void onText(const CharT *text, size_t len);
+// Pointers are only valid for the duration of the call.
+
+enum HtmlTagId
+{
+	HTML_TAG_OTHER,
+	HTML_TAG_A,
+	HTML_TAG_AREA,
+	HTML_TAG_BASE,
+	HTML_TAG_LINK,
+	HTML_TAG_META,
+	HTML_TAG_SCRIPT,
+	HTML_TAG_STYLE,
+	HTML_TAG_NOSCRIPT,
+	HTML_TAG_TEMPLATE,
+	HTML_TAG_TITLE,
+	HTML_TAG_TEXTAREA,
+	HTML_TAG_BLOCK
+};
+
+HtmlTagId html_tag_id(const char *lowercase_name, size_t len);
+uint32_t html_named_entity(const char *name, size_t len);
+
+template<typename CharT>
+class HtmlTokenizer
+{
+	static constexpr size_t MAX_TAG_NAME_LENGTH=16;
+	static constexpr size_t MAX_ENTITY_NAME_LENGTH=8;
+	enum AttrId
+	{
+		ATTR_OTHER,
+		ATTR_HREF,
+		ATTR_REL,
+		ATTR_NAME,
+		ATTR_CONTENT
+	};
+	const CharT *mData;
+	size_t mLength;
+	size_t mPos;
+	std::basic_string<CharT> mHref;
+	std::basic_string<CharT> mRel;
+	std::basic_string<CharT> mName;
+	std::basic_string<CharT> mContent;
+	std::basic_string<CharT> mText;
+	bool mBaseSeen;
+
+	static inline CharT toLowerAscii(CharT c)
+	{
+		return (c>='A' && c<='Z') ? CharT(c+('a'-'A')) : c;
+	}
+	static inline bool isSpace(CharT c)
+	{
+		return c==' ' || c=='\t' || c=='\n' || c=='\r' || c=='\f';
+	}
+	static inline bool isNameChar(CharT c)
+	{
+		return (c>='a' && c<='z') || (c>='A' && c<='Z') || (c>='0' && c<='9') || c=='-' || c==':' || c=='_';
+	}
+
+	static void appendCodePoint(std::basic_string<CharT> &out, uint32_t cp)
+	{
+		if(cp==0 || cp>0x10FFFF || (cp>=0xD800 && cp<=0xDFFF))
+		{
+			cp=0xFFFD;
+		}
+		if constexpr (sizeof(CharT)==1)
+		{
+			if(cp<0x80)
+			{
+				out.push_back(CharT(cp));
+			}
+			else if(cp<0x800)
+			{
+				out.push_back(CharT(0xC0 | (cp>>6)));
+				out.push_back(CharT(0x80 | (cp & 0x3F)));
+			}
+			else if(cp<0x10000)
+			{
+				out.push_back(CharT(0xE0 | (cp>>12)));
+				out.push_back(CharT(0x80 | ((cp>>6) & 0x3F)));
+				out.push_back(CharT(0x80 | (cp & 0x3F)));
+			}
+			else
+			{
+				out.push_back(CharT(0xF0 | (cp>>18)));
+				out.push_back(CharT(0x80 | ((cp>>12) & 0x3F)));
+				out.push_back(CharT(0x80 | ((cp>>6) & 0x3F)));
+				out.push_back(CharT(0x80 | (cp & 0x3F)));
+			}
+		}
+		else
+		{
+			if(cp<0x10000)
+			{
+				out.push_back(CharT(cp));
+			}
+			else
+			{
+				cp-=0x10000;
+				out.push_back(CharT(0xD800 | (cp>>10)));
+				out.push_back(CharT(0xDC00 | (cp & 0x3FF)));
+			}
+		}
+	}
+
+	// Decodes one character reference starting at '&'. Returns the number of
+	// characters consumed, or 0 if the sequence is not a recognised reference.
+	// In attribute values a named reference without ';' followed by '=' or an
+	// alphanumeric stays literal, as in HTML5, so query strings survive.
+	size_t decodeEntity(const CharT *p, const CharT *end, std::basic_string<CharT> &out, bool in_attribute=false) const
+	{
+		const CharT *q=p+1;
+		uint32_t cp=0;
+		if(q<end && *q=='#')
+		{
+			q++;
+			bool hex=false;
+			if(q<end && (*q=='x' || *q=='X'))
+			{
+				hex=true;
+				q++;
+			}
+			const CharT *digitsStart=q;
+			while(q<end && q-digitsStart<8)
+			{
+				CharT c=*q;
+				if(c>='0' && c<='9')
+				{
+					cp=cp*(hex ? 16 : 10)+(c-'0');
+				}
+				else if(hex && toLowerAscii(c)>='a' && toLowerAscii(c)<='f')
+				{
+					cp=cp*16+(toLowerAscii(c)-'a'+10);
+				}
+				else
+				{
+					break;
+				}
+				q++;
+			}
+			if(q==digitsStart)
+			{
+				return 0;
+			}
+		}
+		else
+		{
+			char name[MAX_ENTITY_NAME_LENGTH];
+			size_t nameLength=0;
+			while(q<end && nameLength<MAX_ENTITY_NAME_LENGTH && ((*q>='a' && *q<='z') || (*q>='A' && *q<='Z')))
+			{
+				name[nameLength++]=char(*q);
+				q++;
+			}
+			cp=html_named_entity(name, nameLength);
+			if(cp==0)
+			{
+				return 0;
+			}
+			if(in_attribute && q<end && *q!=';' && (*q=='=' || (*q>='0' && *q<='9') || (*q>='a' && *q<='z') || (*q>='A' && *q<='Z')))
+			{
+				return 0;
+			}
+		}
+		if(q<end && *q==';')
+		{
+			q++;
+		}
+		appendCodePoint(out, cp);
+		return q-p;
+	}
+
+	void assignDecoded(std::basic_string<CharT> &out, const CharT *begin, const CharT *end) const
+	{
+		out.clear();
+		const CharT *p=begin;
+		while(p<end)
+		{
+			if(*p=='&')
+			{
+				size_t consumed=decodeEntity(p, end, out, true);
+				if(consumed>0)
+				{
+					p+=consumed;
+					continue;
+				}
+			}
+			out.push_back(*p);
+			p++;
+		}
+	}
+
+	static bool containsToken(const std::basic_string<CharT> &list, const char *token)
+	{
+		size_t tokenLength=0;
+		while(token[tokenLength])
+		{
+			tokenLength++;
+		}
+		size_t i=0;
+		while(i<list.size())
+		{
+			while(i<list.size() && isSpace(list[i]))
+			{
+				i++;
+			}
+			size_t start=i;
+			while(i<list.size() && !isSpace(list[i]))
+			{
+				i++;
+			}
+			if(i-start==tokenLength)
+			{
+				size_t j=0;
+				while(j<tokenLength && toLowerAscii(list[start+j])==CharT(token[j]))
+				{
+					j++;
+				}
+				if(j==tokenLength)
+				{
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	static AttrId attrId(const CharT *name, size_t len)
+	{
+		static const char *const names[]={"href", "rel", "name", "content"};
+		static const AttrId ids[]={ATTR_HREF, ATTR_REL, ATTR_NAME, ATTR_CONTENT};
+		for(size_t n=0; n<4; n++)
+		{
+			size_t i=0;
+			while(i<len && names[n][i] && toLowerAscii(name[i])==CharT(names[n][i]))
+			{
+				i++;
+			}
+			if(i==len && names[n][i]==0)
+			{
+				return ids[n];
+			}
+		}
+		return ATTR_OTHER;
+	}
+
+	template<typename Handler>
+	void flushText(Handler &handler)
+	{
+		if(!mText.empty())
+		{
+			handler.onText(mText.data(), mText.size());
+			mText.clear();
+		}
+	}
+
+	void skipPast(const CharT *terminator, size_t terminator_length)
+	{
+		while(mPos+terminator_length<=mLength)
+		{
+			size_t i=0;
+			while(i<terminator_length && toLowerAscii(mData[mPos+i])==terminator[i])
+			{
+				i++;
+			}
+			if(i==terminator_length)
+			{
+				mPos+=terminator_length;
+				return;
+			}
+			mPos++;
+		}
+		mPos=mLength;
+	}
+
+	void skipRawText(HtmlTagId tag)
+	{
+		static const CharT closeScript[]={'<','/','s','c','r','i','p','t'};
+		static const CharT closeStyle[]={'<','/','s','t','y','l','e'};
+		static const CharT closeNoscript[]={'<','/','n','o','s','c','r','i','p','t'};
+		static const CharT closeTemplate[]={'<','/','t','e','m','p','l','a','t','e'};
+		static const CharT closeTitle[]={'<','/','t','i','t','l','e'};
+		static const CharT closeTextarea[]={'<','/','t','e','x','t','a','r','e','a'};
+		switch(tag)
+		{
+			case HTML_TAG_SCRIPT: skipPast(closeScript, sizeof(closeScript)/sizeof(CharT)); break;
+			case HTML_TAG_STYLE: skipPast(closeStyle, sizeof(closeStyle)/sizeof(CharT)); break;
+			case HTML_TAG_NOSCRIPT: skipPast(closeNoscript, sizeof(closeNoscript)/sizeof(CharT)); break;
+			case HTML_TAG_TEMPLATE: skipPast(closeTemplate, sizeof(closeTemplate)/sizeof(CharT)); break;
+			case HTML_TAG_TITLE: skipPast(closeTitle, sizeof(closeTitle)/sizeof(CharT)); break;
+			case HTML_TAG_TEXTAREA: skipPast(closeTextarea, sizeof(closeTextarea)/sizeof(CharT)); break;
+			default: return;
+		}
+		while(mPos<mLength && mData[mPos]!='>')
+		{
+			mPos++;
+		}
+		if(mPos<mLength)
+		{
+			mPos++;
+		}
+	}
+
+	HtmlTagId readTagName(bool &recognised)
+	{
+		char name[MAX_TAG_NAME_LENGTH];
+		size_t nameLength=0;
+		recognised=true;
+		while(mPos<mLength && isNameChar(mData[mPos]))
+		{
+			if(nameLength<MAX_TAG_NAME_LENGTH)
+			{
+				name[nameLength++]=char(toLowerAscii(mData[mPos]));
+			}
+			else
+			{
+				recognised=false;
+			}
+			mPos++;
+		}
+		if(!recognised || nameLength==0)
+		{
+			return HTML_TAG_OTHER;
+		}
+		return html_tag_id(name, nameLength);
+	}
+
+	template<typename Handler>
+	void parseTag(Handler &handler)
+	{
+		mPos++;
+		if(mPos>=mLength)
+		{
+			return;
+		}
+		CharT c=mData[mPos];
+		if(c=='!')
+		{
+			if(mPos+2<mLength && mData[mPos+1]=='-' && mData[mPos+2]=='-')
+			{
+				static const CharT commentEnd[]={'-','-','>'};
+				mPos+=3;
+				skipPast(commentEnd, 3);
+			}
+			else
+			{
+				while(mPos<mLength && mData[mPos]!='>')
+				{
+					mPos++;
+				}
+				mPos++;
+			}
+			return;
+		}
+		if(c=='?')
+		{
+			while(mPos<mLength && mData[mPos]!='>')
+			{
+				mPos++;
+			}
+			mPos++;
+			return;
+		}
+		bool closing=false;
+		if(c=='/')
+		{
+			closing=true;
+			mPos++;
+		}
+		else if(!((c>='a' && c<='z') || (c>='A' && c<='Z')))
+		{
+			mText.push_back('<');
+			return;
+		}
+		bool recognised;
+		HtmlTagId tag=readTagName(recognised);
+		if(tag==HTML_TAG_BLOCK)
+		{
+			mText.push_back('\n');
+		}
+		bool wantAttributes=!closing && (tag==HTML_TAG_A || tag==HTML_TAG_AREA || tag==HTML_TAG_BASE || tag==HTML_TAG_LINK || tag==HTML_TAG_META);
+		bool hasHref=false, hasRel=false, hasName=false, hasContent=false;
+		while(mPos<mLength)
+		{
+			while(mPos<mLength && (isSpace(mData[mPos]) || mData[mPos]=='/'))
+			{
+				mPos++;
+			}
+			if(mPos>=mLength || mData[mPos]=='>')
+			{
+				mPos++;
+				break;
+			}
+			size_t nameStart=mPos;
+			while(mPos<mLength && !isSpace(mData[mPos]) && mData[mPos]!='=' && mData[mPos]!='>' && mData[mPos]!='/')
+			{
+				mPos++;
+			}
+			AttrId attr=wantAttributes ? attrId(mData+nameStart, mPos-nameStart) : ATTR_OTHER;
+			while(mPos<mLength && isSpace(mData[mPos]))
+			{
+				mPos++;
+			}
+			if(mPos>=mLength || mData[mPos]!='=')
+			{
+				continue;
+			}
+			mPos++;
+			while(mPos<mLength && isSpace(mData[mPos]))
+			{
+				mPos++;
+			}
+			size_t valueStart, valueEnd;
+			if(mPos<mLength && (mData[mPos]=='"' || mData[mPos]=='\''))
+			{
+				CharT quote=mData[mPos];
+				valueStart=++mPos;
+				while(mPos<mLength && mData[mPos]!=quote)
+				{
+					mPos++;
+				}
+				valueEnd=mPos;
+				if(mPos<mLength)
+				{
+					mPos++;
+				}
+			}
+			else
+			{
+				valueStart=mPos;
+				while(mPos<mLength && !isSpace(mData[mPos]) && mData[mPos]!='>')
+				{
+					mPos++;
+				}
+				valueEnd=mPos;
+			}
+			switch(attr)
+			{
+				case ATTR_HREF:
+					assignDecoded(mHref, mData+valueStart, mData+valueEnd);
+					hasHref=true;
+					break;
+				case ATTR_REL:
+					assignDecoded(mRel, mData+valueStart, mData+valueEnd);
+					hasRel=true;
+					break;
+				case ATTR_NAME:
+					assignDecoded(mName, mData+valueStart, mData+valueEnd);
+					hasName=true;
+					break;
+				case ATTR_CONTENT:
+					assignDecoded(mContent, mData+valueStart, mData+valueEnd);
+					hasContent=true;
+					break;
+				default:
+					break;
+			}
+		}
+		if(closing)
+		{
+			return;
+		}
+		switch(tag)
+		{
+			case HTML_TAG_A:
+			case HTML_TAG_AREA:
+				if(hasHref)
+				{
+					handler.onLink(mHref.data(), mHref.size(), hasRel && containsToken(mRel, "nofollow"));
+				}
+				break;
+			case HTML_TAG_BASE:
+				if(hasHref && !mBaseSeen)
+				{
+					mBaseSeen=true;
+					handler.onBase(mHref.data(), mHref.size());
+				}
+				break;
+			case HTML_TAG_LINK:
+				if(hasHref && hasRel && containsToken(mRel, "canonical"))
+				{
+					handler.onCanonical(mHref.data(), mHref.size());
+				}
+				break;
+			case HTML_TAG_META:
+				if(hasName && hasContent && containsToken(mName, "robots"))
+				{
+					handler.onMetaRobots(mContent.data(), mContent.size());
+				}
+				break;
+			case HTML_TAG_SCRIPT:
+			case HTML_TAG_STYLE:
+			case HTML_TAG_NOSCRIPT:
+			case HTML_TAG_TEMPLATE:
+			case HTML_TAG_TITLE:
+			case HTML_TAG_TEXTAREA:
+				flushText(handler);
+				skipRawText(tag);
+				break;
+			default:
+				break;
+		}
+	}
+public:
+	HtmlTokenizer()
+	{
+		mData=nullptr;
+		mLength=0;
+		mPos=0;
+		mBaseSeen=false;
+	}
+
+	template<typename Handler>
+	void tokenize(const CharT *data, size_t length, Handler &handler)
+	{
+		mData=data;
+		mLength=length;
+		mPos=0;
+		mBaseSeen=false;
+		mText.clear();
+		while(mPos<mLength)
+		{
+			CharT c=mData[mPos];
+			if(c=='<')
+			{
+				parseTag(handler);
+			}
+			else if(c=='&')
+			{
+				size_t consumed=decodeEntity(mData+mPos, mData+mLength, mText);
+				if(consumed>0)
+				{
+					mPos+=consumed;
+				}
+				else
+				{
+					mText.push_back(c);
+					mPos++;
+				}
+			}
+			else
+			{
+				size_t runStart=mPos;
+				while(mPos<mLength && mData[mPos]!='<' && mData[mPos]!='&')
+				{
+					mPos++;
+				}
+				mText.append(mData+runStart, mPos-runStart);
+			}
+		}
+		flushText(handler);
+	}
+};
+
+#endif // HTML_TOKENIZER_HPP
@@ -0,0 +1,95 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QDebug>
+#include "html_tokenizer.hpp"
+#include "util.hpp"
+
+// Counts what the tokenizer reports, so that nothing is optimised away.
+template<typename CharT>
+struct BenchmarkCounter
+{
+	qint64 links=0;
+	qint64 textLength=0;
+	void onLink(const CharT *, size_t, bool)
+	{
+		links++;
+	}
+	void onBase(const CharT *, size_t)
+	{
+	}
+	void onCanonical(const CharT *, size_t)
+	{
+	}
+	void onMetaRobots(const CharT *, size_t)
+	{
+	}
+	void onText(const CharT *, size_t len)
+	{
+		textLength+=len;
+	}
+};
+
+static int usage()
+{
+	qWarning() << "Usage: seeklet-bench-tokenizer [--passes N] saved_page.html...";
+	return 2;
+}
+
+// Tokenizes saved pages as UTF-8 and as UTF-16, the form the crawler gets them
+// in from the page, and reports throughput for both.
+int main(int argc, char **argv)
+{
+	QCoreApplication benchApp(argc, argv);
+	QStringList arguments=benchApp.arguments().mid(1);
+	int passes=20;
+	if(!take_number_option(arguments, "--passes", passes) || passes<1 || arguments.isEmpty())
+	{
+		return usage();
+	}
+	QList<QByteArray> utf8Pages;
+	QList<QString> utf16Pages;
+	qint64 utf8Bytes=0;
+	for(const QString &path : std::as_const(arguments))
+	{
+		QFile pageFile(path);
+		if(!pageFile.open(QIODevice::ReadOnly))
+		{
+			qWarning() << "Failed to open" << path << pageFile.errorString();
+			return 1;
+		}
+		utf8Pages.append(pageFile.readAll());
+		utf16Pages.append(QString::fromUtf8(utf8Pages.last()));
+		utf8Bytes+=utf8Pages.last().size();
+	}
+	QElapsedTimer benchmarkTimer;
+	BenchmarkCounter<char> utf8Counter;
+	benchmarkTimer.start();
+	for(int pass=0; pass<passes; pass++)
+	{
+		for(const QByteArray &page : std::as_const(utf8Pages))
+		{
+			HtmlTokenizer<char> tokenizer;
+			tokenizer.tokenize(page.constData(), page.size(), utf8Counter);
+		}
+	}
+	qint64 utf8Elapsed=qMax(benchmarkTimer.nsecsElapsed(), qint64(1));
+	BenchmarkCounter<char16_t> utf16Counter;
+	benchmarkTimer.restart();
+	for(int pass=0; pass<passes; pass++)
+	{
+		for(const QString &page : std::as_const(utf16Pages))
+		{
+			HtmlTokenizer<char16_t> tokenizer;
+			tokenizer.tokenize(reinterpret_cast<const char16_t *>(page.constData()), page.size(), utf16Counter);
+		}
+	}
+	qint64 utf16Elapsed=qMax(benchmarkTimer.nsecsElapsed(), qint64(1));
+	qint64 pagesNum=qint64(utf8Pages.size())*passes;
+	qInfo() << "Tokenized" << utf8Pages.size() << "pages," << utf8Bytes << "bytes," << passes << "times," <<
+		utf8Counter.links/passes << "links and" << utf8Counter.textLength/passes << "text bytes per pass";
+	qInfo() << "UTF-8:" << utf8Bytes*passes*1000.0/utf8Elapsed << "MB/s," << utf8Elapsed/1000/pagesNum << "us per page";
+	qInfo() << "UTF-16:" << utf8Bytes*passes*1000.0/utf16Elapsed << "MB/s of UTF-8 input," << utf16Elapsed/1000/pagesNum <<
+		"us per page";
+	return 0;
+}
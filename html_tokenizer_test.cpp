@@ -0,0 +1,112 @@
+#include <QTest>
+#include "html_tokenizer.hpp"
+
+// Records everything the tokenizer reports for one UTF-16 document.
+struct TokenizerRecorder
+{
+	QStringList links;
+	QList<bool> nofollow;
+	QStringList bases;
+	QStringList canonicals;
+	QStringList robots;
+	QString text;
+	void onLink(const char16_t *href, size_t len, bool link_nofollow)
+	{
+		links.append(QString(reinterpret_cast<const QChar *>(href), len));
+		nofollow.append(link_nofollow);
+	}
+	void onBase(const char16_t *href, size_t len)
+	{
+		bases.append(QString(reinterpret_cast<const QChar *>(href), len));
+	}
+	void onCanonical(const char16_t *href, size_t len)
+	{
+		canonicals.append(QString(reinterpret_cast<const QChar *>(href), len));
+	}
+	void onMetaRobots(const char16_t *content, size_t len)
+	{
+		robots.append(QString(reinterpret_cast<const QChar *>(content), len));
+	}
+	void onText(const char16_t *chunk, size_t len)
+	{
+		text.append(reinterpret_cast<const QChar *>(chunk), len);
+	}
+};
+
+class HtmlTokenizerTest : public QObject
+{
+	Q_OBJECT
+	static TokenizerRecorder tokenize(const QString &html)
+	{
+		TokenizerRecorder recorder;
+		HtmlTokenizer<char16_t> tokenizer;
+		tokenizer.tokenize(reinterpret_cast<const char16_t *>(html.constData()), html.size(), recorder);
+		return recorder;
+	}
+private slots:
+	void links()
+	{
+		TokenizerRecorder recorder=tokenize(
+			"<a href=\"/a\">A</a> <A HREF='/b' REL=\"external NoFollow\">B</A> "
+			"<area href=/c rel=nofollow> <a rel=\"nofollowing\" href=\"/d\">D</a> <a name=\"anchor\">E</a>");
+		QCOMPARE(recorder.links, QStringList({"/a", "/b", "/c", "/d"}));
+		QCOMPARE(recorder.nofollow, QList<bool>({false, true, true, false}));
+	}
+
+	void base()
+	{
+		TokenizerRecorder recorder=tokenize(
+			"<head><base href=\"https://example.com/dir/\"><base href=\"https://other.invalid/\"></head>"
+			"<a href=\"page\">x</a>");
+		QCOMPARE(recorder.bases, QStringList({"https://example.com/dir/"}));
+		QCOMPARE(recorder.links, QStringList({"page"}));
+	}
+
+	void canonical()
+	{
+		TokenizerRecorder recorder=tokenize(
+			"<link rel=\"stylesheet\" href=\"/s.css\">"
+			"<link rel=\"Canonical\" href=\"https://example.com/page\">");
+		QCOMPARE(recorder.canonicals, QStringList({"https://example.com/page"}));
+		QVERIFY(recorder.links.isEmpty());
+	}
+
+	void metaRobots()
+	{
+		TokenizerRecorder recorder=tokenize(
+			"<meta name=\"description\" content=\"not robots\">"
+			"<meta name=\"ROBOTS\" content=\"noindex, nofollow\">"
+			"<meta content=\"none\">");
+		QCOMPARE(recorder.robots, QStringList({"noindex, nofollow"}));
+	}
+
+	void skippedBodies()
+	{
+		TokenizerRecorder recorder=tokenize(
+			"<p>before</p>"
+			"<script>var a=\"<a href='/script'>\";</script>"
+			"<STYLE>a { color: red }</style>"
+			"<!-- <a href=\"/comment\"> -->"
+			"<title>Title text</title>"
+			"<p>after</p>");
+		QCOMPARE(recorder.text.simplified(), QString("before after"));
+		QVERIFY(recorder.links.isEmpty());
+	}
+
+	void textEntities()
+	{
+		TokenizerRecorder recorder=tokenize(
+			"<p>Fish &amp; chips &lt;3 &copy; 2024 &#169;&#xA9; &unknown; &amp</p>");
+		QCOMPARE(recorder.text.simplified(), QString::fromUtf8("Fish & chips <3 © 2024 ©© &unknown; &"));
+	}
+
+	void attributeEntities()
+	{
+		// A named reference without ';' before '=' stays literal in attributes.
+		TokenizerRecorder recorder=tokenize("<a href=\"/s?a=1&amp;b=2&copy=3&lt;x&#x41;\">x</a>");
+		QCOMPARE(recorder.links, QStringList({"/s?a=1&b=2&copy=3<xA"}));
+	}
+};
+
+QTEST_GUILESS_MAIN(HtmlTokenizerTest)
+#include "html_tokenizer_test.moc"
@@ -0,0 +1,431 @@
+#include <QtEndian>
+#include "index_shard.hpp"
+#include "util.hpp"
+
+static constexpr char SHARD_MAGIC[8]={'S', 'K', 'L', 'S', 'H', 'A', 'R', 'D'};
+static constexpr qsizetype SHARD_BUFFER_SIZE=64*1024;
+static constexpr qsizetype SHARD_HASH_SIZE=16;
+static constexpr quint64 SHARD_STRING_MAX=16*1024*1024;
+static constexpr quint8 SHARD_PAGE_PARTIAL=0x01;
+
+ShardWriter::ShardWriter(const QString &file_path) : mFile(file_path), mBlocks(&mFile)
+{
+	mTermsNum=0;
+	mPagesNum=0;
+	mTermsWritten=0;
+	mPagesWritten=0;
+	mPostingsWritten=0;
+}
+
+bool ShardWriter::fail(const QString &error)
+{
+	mError=error;
+	return false;
+}
+
+bool ShardWriter::flush(qsizetype buffer_min)
+{
+	if(mBuffer.size()<buffer_min)
+	{
+		return true;
+	}
+	if(mBlocks.write(mBuffer)!=mBuffer.size())
+	{
+		return fail(QString("failed to write %1: %2").arg(mFile.fileName(), mBlocks.errorString()));
+	}
+	mBuffer.clear();
+	return true;
+}
+
+bool ShardWriter::open(quint32 terms_num, quint32 pages_num)
+{
+	if(!mFile.open(QIODevice::WriteOnly))
+	{
+		return fail(QString("failed to open %1 for writing: %2").arg(mFile.fileName(), mFile.errorString()));
+	}
+	mBlocks.open(QIODevice::WriteOnly);
+	mTermsNum=terms_num;
+	mPagesNum=pages_num;
+	char version[4];
+	qToLittleEndian<quint32>(SHARD_FORMAT_VERSION, version);
+	mBuffer.append(SHARD_MAGIC, sizeof(SHARD_MAGIC));
+	mBuffer.append(version, sizeof(version));
+	varint_append(mBuffer, terms_num);
+	varint_append(mBuffer, pages_num);
+	return true;
+}
+
+bool ShardWriter::writeTerm(const QByteArray &term, const QByteArray &surface)
+{
+	if(mTermsWritten==mTermsNum || (mTermsWritten>0 && term<=mPreviousTerm))
+	{
+		return fail(QString("term %1 is out of order or not announced").arg(mTermsWritten));
+	}
+	qsizetype prefix=0;
+	qsizetype prefixMax=qMin(term.size(), mPreviousTerm.size());
+	while(prefix<prefixMax && term.at(prefix)==mPreviousTerm.at(prefix))
+	{
+		prefix++;
+	}
+	varint_append(mBuffer, prefix);
+	varint_append(mBuffer, term.size()-prefix);
+	mBuffer.append(term.constData()+prefix, term.size()-prefix);
+	varint_append(mBuffer, surface.size());
+	mBuffer.append(surface);
+	mPreviousTerm=term;
+	mTermsWritten++;
+	return flush(SHARD_BUFFER_SIZE);
+}
+
+bool ShardWriter::writePage(const ShardPage &page)
+{
+	if(mTermsWritten<mTermsNum || mPagesWritten==mPagesNum)
+	{
+		return fail(QString("page %1 is out of order or not announced").arg(mPagesWritten));
+	}
+	if(page.urlHash.size()!=SHARD_HASH_SIZE || page.contentHash.size()!=SHARD_HASH_SIZE)
+	{
+		return fail(QString("bad hashes of page %1").arg(mPagesWritten));
+	}
+	const QByteArray title=page.title.toUtf8();
+	mBuffer.append(page.urlHash);
+	mBuffer.append(page.contentHash);
+	varint_append(mBuffer, quint64(page.timeStamp));
+	varint_append(mBuffer, title.size());
+	mBuffer.append(title);
+	varint_append(mBuffer, page.url.size());
+	mBuffer.append(page.url);
+	varint_append(mBuffer, page.wordsTotal);
+	mBuffer.append(char(page.partial ? SHARD_PAGE_PARTIAL : 0));
+	varint_append(mBuffer, page.terms.size());
+	for(qsizetype term=0; term<page.terms.size(); term++)
+	{
+		const QPair<quint32, quint32> &termFrequency=page.terms.at(term);
+		if(termFrequency.first>=mTermsNum || termFrequency.second==0 || (term>0 && termFrequency.first<=page.terms.at(term-1).first))
+		{
+			return fail(QString("bad term vector of page %1").arg(mPagesWritten));
+		}
+		varint_append(mBuffer, term>0 ? termFrequency.first-page.terms.at(term-1).first : termFrequency.first);
+		varint_append(mBuffer, termFrequency.second);
+	}
+	mPagesWritten++;
+	return flush(SHARD_BUFFER_SIZE);
+}
+
+bool ShardWriter::writePostings(const QList<quint32> &page_ordinals)
+{
+	if(mPagesWritten<mPagesNum || mPostingsWritten==mTermsNum)
+	{
+		return fail(QString("postings of term %1 are out of order or not announced").arg(mPostingsWritten));
+	}
+	varint_append(mBuffer, page_ordinals.size());
+	for(qsizetype posting=0; posting<page_ordinals.size(); posting++)
+	{
+		quint32 ordinal=page_ordinals.at(posting);
+		if(ordinal>=mPagesNum || (posting>0 && ordinal<=page_ordinals.at(posting-1)))
+		{
+			return fail(QString("bad postings of term %1").arg(mPostingsWritten));
+		}
+		varint_append(mBuffer, posting>0 ? ordinal-page_ordinals.at(posting-1) : ordinal);
+	}
+	mPostingsWritten++;
+	return flush(SHARD_BUFFER_SIZE);
+}
+
+bool ShardWriter::commit()
+{
+	if(!mError.isEmpty())
+	{
+		return false;
+	}
+	if(mTermsWritten<mTermsNum || mPagesWritten<mPagesNum || mPostingsWritten<mTermsNum)
+	{
+		return fail(QString("%1 is incomplete").arg(mFile.fileName()));
+	}
+	if(!flush(0))
+	{
+		return false;
+	}
+	if(!mBlocks.finish() || !mFile.commit())
+	{
+		return fail(QString("failed to write %1: %2 %3").arg(mFile.fileName(), mBlocks.errorString(), mFile.errorString()));
+	}
+	return true;
+}
+
+QString ShardWriter::errorString() const
+{
+	return mError;
+}
+
+ShardReader::ShardReader(const QString &file_path) : mFile(file_path), mBlocks(&mFile)
+{
+	mBufferPos=0;
+	mTermsNum=0;
+	mPagesNum=0;
+	mTermsRead=0;
+	mPagesRead=0;
+	mPostingsRead=0;
+}
+
+bool ShardReader::fail(const QString &error)
+{
+	mError=error;
+	return false;
+}
+
+bool ShardReader::fill(qsizetype bytes)
+{
+	if(mBuffer.size()-mBufferPos>=bytes)
+	{
+		return true;
+	}
+	mBuffer.remove(0, mBufferPos);
+	mBufferPos=0;
+	while(mBuffer.size()<bytes)
+	{
+		QByteArray chunk=mBlocks.read(qMax(bytes-mBuffer.size(), SHARD_BUFFER_SIZE));
+		if(chunk.isEmpty())
+		{
+			return fail(QString("%1 is truncated %2").arg(mFile.fileName(), mBlocks.errorString()));
+		}
+		mBuffer.append(chunk);
+	}
+	return true;
+}
+
+bool ShardReader::readVarint(quint64 &value)
+{
+	value=0;
+	for(int shift=0; shift<64; shift+=7)
+	{
+		if(!fill(1))
+		{
+			return false;
+		}
+		quint8 byte=quint8(mBuffer.at(mBufferPos++));
+		value|=quint64(byte & 0x7F) << shift;
+		if(!(byte & 0x80))
+		{
+			return true;
+		}
+	}
+	return fail(QString("bad varint in %1").arg(mFile.fileName()));
+}
+
+bool ShardReader::readBytes(qsizetype length, QByteArray &bytes)
+{
+	if(length<0 || quint64(length)>SHARD_STRING_MAX)
+	{
+		return fail(QString("bad string length in %1").arg(mFile.fileName()));
+	}
+	if(!fill(length))
+	{
+		return false;
+	}
+	bytes=mBuffer.mid(mBufferPos, length);
+	mBufferPos+=length;
+	return true;
+}
+
+// Every block is checked before anything is read, so a damaged shard is
+// rejected as a whole rather than imported halfway.
+bool ShardReader::open()
+{
+	if(!mFile.open(QIODevice::ReadOnly))
+	{
+		return fail(QString("failed to open %1 for reading: %2").arg(mFile.fileName(), mFile.errorString()));
+	}
+	uchar *data=mFile.size()>0 ? mFile.map(0, mFile.size()) : nullptr;
+	if(mFile.size()>0 && nullptr==data)
+	{
+		return fail(QString("failed to map %1: %2").arg(mFile.fileName(), mFile.errorString()));
+	}
+	QList<ChecksummedBlock> blocks;
+	QString error;
+	bool valid=ChecksummedDevice::scanBlocks(data, mFile.size(), blocks, error);
+	for(qsizetype block=0; valid && block<blocks.size(); block++)
+	{
+		if(!ChecksummedDevice::verifyBlock(data, blocks.at(block)))
+		{
+			error=QString("checksum mismatch in block %1 with data at offset %2").arg(block).arg(blocks.at(block).offset);
+			valid=false;
+		}
+	}
+	if(nullptr!=data)
+	{
+		mFile.unmap(data);
+	}
+	if(!valid)
+	{
+		return fail(QString("%1: %2").arg(mFile.fileName(), error));
+	}
+	mBlocks.open(QIODevice::ReadOnly);
+	QByteArray magic, version;
+	quint64 termsNum, pagesNum;
+	if(!readBytes(sizeof(SHARD_MAGIC), magic) || !readBytes(sizeof(quint32), version))
+	{
+		return false;
+	}
+	if(magic!=QByteArray(SHARD_MAGIC, sizeof(SHARD_MAGIC)))
+	{
+		return fail(QString("%1 is not an index shard").arg(mFile.fileName()));
+	}
+	if(qFromLittleEndian<quint32>(version.constData())!=SHARD_FORMAT_VERSION)
+	{
+		return fail(QString("%1 has unsupported format version %2").arg(mFile.fileName()).arg(qFromLittleEndian<quint32>(version.constData())));
+	}
+	if(!readVarint(termsNum) || !readVarint(pagesNum))
+	{
+		return false;
+	}
+	if(termsNum>UINT32_MAX || pagesNum>UINT32_MAX)
+	{
+		return fail(QString("bad term or page count in %1").arg(mFile.fileName()));
+	}
+	mTermsNum=termsNum;
+	mPagesNum=pagesNum;
+	return true;
+}
+
+quint32 ShardReader::termsNum() const
+{
+	return mTermsNum;
+}
+
+quint32 ShardReader::pagesNum() const
+{
+	return mPagesNum;
+}
+
+bool ShardReader::readTerm(QByteArray &term, QByteArray &surface)
+{
+	if(mTermsRead==mTermsNum)
+	{
+		return fail(QString("no more terms in %1").arg(mFile.fileName()));
+	}
+	quint64 prefix, suffixLength, surfaceLength;
+	QByteArray suffix;
+	if(!readVarint(prefix) || !readVarint(suffixLength))
+	{
+		return false;
+	}
+	if(prefix>quint64(mPreviousTerm.size()) || suffixLength>SHARD_STRING_MAX)
+	{
+		return fail(QString("bad term %1 in %2").arg(mTermsRead).arg(mFile.fileName()));
+	}
+	if(!readBytes(suffixLength, suffix) || !readVarint(surfaceLength) || surfaceLength>SHARD_STRING_MAX ||
+		!readBytes(surfaceLength, surface))
+	{
+		return mError.isEmpty() ? fail(QString("bad term %1 in %2").arg(mTermsRead).arg(mFile.fileName())) : false;
+	}
+	term=mPreviousTerm.left(prefix)+suffix;
+	if(mTermsRead>0 && term<=mPreviousTerm)
+	{
+		return fail(QString("terms are out of order at %1 in %2").arg(mTermsRead).arg(mFile.fileName()));
+	}
+	mPreviousTerm=term;
+	mTermsRead++;
+	return true;
+}
+
+bool ShardReader::readPage(ShardPage &page)
+{
+	if(mTermsRead<mTermsNum || mPagesRead==mPagesNum)
+	{
+		return fail(QString("unexpected page %1 in %2").arg(mPagesRead).arg(mFile.fileName()));
+	}
+	quint64 timeStamp, titleLength, urlLength, wordsTotal, termsNum;
+	QByteArray title, flags;
+	if(!readBytes(SHARD_HASH_SIZE, page.urlHash) || !readBytes(SHARD_HASH_SIZE, page.contentHash) || !readVarint(timeStamp) ||
+		!readVarint(titleLength) || titleLength>SHARD_STRING_MAX || !readBytes(titleLength, title) ||
+		!readVarint(urlLength) || urlLength>SHARD_STRING_MAX || !readBytes(urlLength, page.url) ||
+		!readVarint(wordsTotal) || !readBytes(1, flags) || !readVarint(termsNum))
+	{
+		return mError.isEmpty() ? fail(QString("bad page %1 in %2").arg(mPagesRead).arg(mFile.fileName())) : false;
+	}
+	if(termsNum>mTermsNum || wordsTotal>UINT32_MAX || (quint8(flags.at(0)) & ~SHARD_PAGE_PARTIAL)!=0)
+	{
+		return fail(QString("bad term vector of page %1 in %2").arg(mPagesRead).arg(mFile.fileName()));
+	}
+	page.title=QString::fromUtf8(title);
+	page.timeStamp=qint64(timeStamp);
+	page.wordsTotal=quint32(wordsTotal);
+	page.partial=(quint8(flags.at(0)) & SHARD_PAGE_PARTIAL)!=0;
+	page.terms.clear();
+	page.terms.reserve(termsNum);
+	quint64 termId=0, termIdDelta, tf, wordsInTerms=0;
+	for(quint64 term=0; term<termsNum; term++)
+	{
+		if(!readVarint(termIdDelta) || !readVarint(tf))
+		{
+			return false;
+		}
+		termId=(term>0 ? termId+termIdDelta : termIdDelta);
+		if((term>0 && termIdDelta==0) || termIdDelta>=mTermsNum || termId>=mTermsNum || tf==0 || tf>UINT32_MAX)
+		{
+			return fail(QString("bad term vector of page %1 in %2").arg(mPagesRead).arg(mFile.fileName()));
+		}
+		page.terms.append(qMakePair(quint32(termId), quint32(tf)));
+		wordsInTerms+=tf;
+	}
+	if(wordsInTerms>page.wordsTotal)
+	{
+		return fail(QString("bad word count of page %1 in %2").arg(mPagesRead).arg(mFile.fileName()));
+	}
+	mPagesRead++;
+	return true;
+}
+
+bool ShardReader::readPostings(QList<quint32> &page_ordinals)
+{
+	if(mPagesRead<mPagesNum || mPostingsRead==mTermsNum)
+	{
+		return fail(QString("unexpected postings of term %1 in %2").arg(mPostingsRead).arg(mFile.fileName()));
+	}
+	quint64 postingsNum;
+	if(!readVarint(postingsNum))
+	{
+		return false;
+	}
+	if(postingsNum>mPagesNum)
+	{
+		return fail(QString("bad postings of term %1 in %2").arg(mPostingsRead).arg(mFile.fileName()));
+	}
+	page_ordinals.clear();
+	page_ordinals.reserve(postingsNum);
+	quint64 ordinal=0, ordinalDelta;
+	for(quint64 posting=0; posting<postingsNum; posting++)
+	{
+		if(!readVarint(ordinalDelta))
+		{
+			return false;
+		}
+		ordinal=(posting>0 ? ordinal+ordinalDelta : ordinalDelta);
+		if((posting>0 && ordinalDelta==0) || ordinalDelta>=mPagesNum || ordinal>=mPagesNum)
+		{
+			return fail(QString("bad postings of term %1 in %2").arg(mPostingsRead).arg(mFile.fileName()));
+		}
+		page_ordinals.append(ordinal);
+	}
+	mPostingsRead++;
+	return true;
+}
+
+bool ShardReader::finish()
+{
+	if(mTermsRead<mTermsNum || mPagesRead<mPagesNum || mPostingsRead<mTermsNum)
+	{
+		return fail(QString("%1 has not been read to the end").arg(mFile.fileName()));
+	}
+	if(mBufferPos<mBuffer.size() || !mBlocks.finish())
+	{
+		return fail(QString("unexpected data at the end of %1 %2").arg(mFile.fileName(), mBlocks.errorString()));
+	}
+	return true;
+}
+
+QString ShardReader::errorString() const
+{
+	return mError;
+}
@@ -0,0 +1,88 @@
+#ifndef INDEX_SHARD_HPP
+#define INDEX_SHARD_HPP
+
+#include <QFile>
+#include <QSaveFile>
+#include <QByteArray>
+#include <QString>
+#include <QList>
+#include <QPair>
+#include "checksummed_device.hpp"
+
+static constexpr quint32 SHARD_FORMAT_VERSION=2;
+
+struct ShardPage
+{
+	QByteArray urlHash;
+	QByteArray contentHash;
+	QString title;
+	QByteArray url;
+	qint64 timeStamp;
+	quint32 wordsTotal;
+	bool partial;
+	QList<QPair<quint32, quint32>> terms;
+};
+
+// Self-contained slice of an index for exchange between peers. Integers are
+// little-endian or LEB128 varints, so nothing depends on Qt serialization,
+// and the whole shard goes through a ChecksummedDevice. After the magic,
+// format version and term and page counts come the term dictionary, sorted
+// and front-coded; the pages with their term vectors over shard-local term
+// IDs; and for every term the delta-coded ordinals of the pages that have it.
+// A page exported from a term range is flagged partial: its vector is only
+// the slice in range, while its word count is that of the whole page.
+// Both sides work sequentially through a small buffer.
+class ShardWriter
+{
+	QSaveFile mFile;
+	ChecksummedDevice mBlocks;
+	QByteArray mBuffer;
+	QByteArray mPreviousTerm;
+	quint32 mTermsNum;
+	quint32 mPagesNum;
+	quint32 mTermsWritten;
+	quint32 mPagesWritten;
+	quint32 mPostingsWritten;
+	QString mError;
+	bool fail(const QString &error);
+	bool flush(qsizetype buffer_min);
+public:
+	ShardWriter(const QString &file_path);
+	bool open(quint32 terms_num, quint32 pages_num);
+	bool writeTerm(const QByteArray &term, const QByteArray &surface);
+	bool writePage(const ShardPage &page);
+	bool writePostings(const QList<quint32> &page_ordinals);
+	bool commit();
+	QString errorString() const;
+};
+
+class ShardReader
+{
+	QFile mFile;
+	ChecksummedDevice mBlocks;
+	QByteArray mBuffer;
+	qsizetype mBufferPos;
+	QByteArray mPreviousTerm;
+	quint32 mTermsNum;
+	quint32 mPagesNum;
+	quint32 mTermsRead;
+	quint32 mPagesRead;
+	quint32 mPostingsRead;
+	QString mError;
+	bool fail(const QString &error);
+	bool fill(qsizetype bytes);
+	bool readVarint(quint64 &value);
+	bool readBytes(qsizetype length, QByteArray &bytes);
+public:
+	ShardReader(const QString &file_path);
+	bool open();
+	quint32 termsNum() const;
+	quint32 pagesNum() const;
+	bool readTerm(QByteArray &term, QByteArray &surface);
+	bool readPage(ShardPage &page);
+	bool readPostings(QList<quint32> &page_ordinals);
+	bool finish();
+	QString errorString() const;
+};
+
+#endif // INDEX_SHARD_HPP
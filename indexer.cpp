@@ -1,36 +1,32 @@
+#include <cstring>
+#include <algorithm>
+#include <limits>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QSaveFile>
+#include <QThreadPool>
+#include <QtAlgorithms>
+#include <QUrl>
 #include "main.hpp"
 #include "indexer.hpp"
 #include "util.hpp"
+#include "checksummed_device.hpp"
+#include "index_shard.hpp"
+#include "stemmer.hpp"
+#include "stop_words.hpp"
 
-PageMetadata::PageMetadata()
-{
-	wordsTotal=0;
-}
-
-void PageMetadata::writeToStream(QDataStream &stream) const
-{
-	stream << this->title;
-	stream << this->url;
-	stream << this->urlHash;
-	stream << this->contentHash;
-	stream << this->timeStamp;
-	stream << this->wordsAsHashes;
-	stream << this->wordsTotal;
-}
-
-void PageMetadata::readFromStream(QDataStream &stream)
-{
-	stream >> this->title;
-	stream >> this->url;
-	stream >> this->urlHash;
-	stream >> this->contentHash;
-	stream >> this->timeStamp;
-	stream >> this->wordsAsHashes;
-	stream >> this->wordsTotal;
-}
+// Estimated heap cost of one list posting (a QSet<QByteArray> node), of one
+// posting list, and of the per-page lookup table entries next to PageMetadata.
+static constexpr qsizetype LIST_POSTING_BYTES=32;
+static constexpr qsizetype LIST_POSTINGS_BYTES=96;
+static constexpr qsizetype PAGE_INDEX_BYTES=384;
+static constexpr quint32 INVALID_DOC_ID=0xFFFFFFFF;
+static constexpr quint32 COMPACTION_TOMBSTONES_MIN=1024;
+static constexpr quint32 STATISTICS_TERMS_PER_TASK=16384;
+static constexpr qsizetype STATISTICS_PAGES_PER_TASK=16384;
+static constexpr qsizetype STATISTICS_BLOCKS_PER_TASK=64;
 
-bool PageMetadata::isValid() const
+bool PageHeader::isValid() const
 {
 	bool result=true;
 	if(urlHash.isEmpty() || urlHash.size()!=16)
@@ -41,60 +37,200 @@ bool PageMetadata::isValid() const
 	{
 		result=false;
 	}
-	if(wordsTotal==0)
+	if(url.isEmpty())
 	{
 		result=false;
 	}
-	if(wordsAsHashes.isEmpty())
+	if(!timeStamp.isValid())
 	{
 		result=false;
 	}
-	if(url.isEmpty())
+	return result;
+}
+
+PageMetadata::PageMetadata()
+{
+	memset(urlHash, 0, sizeof(urlHash));
+	memset(contentHash, 0, sizeof(contentHash));
+	simHash=0;
+	docId=0;
+	wordsTotal=0;
+	termsNum=0;
+}
+
+QByteArray PageMetadata::urlHashBytes() const
+{
+	return QByteArray((const char *)urlHash, sizeof(urlHash));
+}
+
+QByteArray PageMetadata::contentHashBytes() const
+{
+	return QByteArray((const char *)contentHash, sizeof(contentHash));
+}
+
+void PageMetadata::setTerms(QList<QPair<quint32, quint32>> term_frequencies)
+{
+	std::sort(term_frequencies.begin(), term_frequencies.end());
+	terms.clear();
+	termsNum=0;
+	quint32 previousTermId=0;
+	for(qsizetype i=0; i<term_frequencies.size(); i++)
 	{
-		result=false;
+		quint32 termId=term_frequencies.at(i).first;
+		quint64 tf=term_frequencies.at(i).second;
+		while(i+1<term_frequencies.size() && term_frequencies.at(i+1).first==termId)
+		{
+			tf+=term_frequencies.at(++i).second;
+		}
+		varint_append(terms, termId-previousTermId);
+		varint_append(terms, tf);
+		previousTermId=termId;
+		termsNum++;
 	}
-	if(!timeStamp.isValid())
+	terms.squeeze();
+}
+
+QList<QPair<quint32, quint32>> PageMetadata::termFrequencies() const
+{
+	QList<QPair<quint32, quint32>> result;
+	result.reserve(termsNum);
+	forEachTerm([&result](quint32 term_id, quint32 tf)
+		{
+			result.append(qMakePair(term_id, tf));
+		});
+	return result;
+}
+
+quint32 PageMetadata::termFrequency(quint32 term_id) const
+{
+	const char *data=terms.constData();
+	const char *end=data+terms.size();
+	quint64 termId=0, termIdDelta, tf;
+	while(varint_read(data, end, termIdDelta) && varint_read(data, end, tf))
 	{
-		result=false;
+		termId+=termIdDelta;
+		if(termId>=term_id)
+		{
+			return termId==term_id ? tf : 0;
+		}
 	}
-	return result;
+	return 0;
+}
+
+void PageMetadata::updateSimHash()
+{
+	simHash=simhash_64(termFrequencies());
+}
+
+qsizetype PageMetadata::sizeInBytes() const
+{
+	return sizeof(PageMetadata)+terms.capacity();
+}
+
+void PageMetadata::writeToStream(QDataStream &stream) const
+{
+	stream.writeRawData((const char *)this->urlHash, sizeof(this->urlHash));
+	stream.writeRawData((const char *)this->contentHash, sizeof(this->contentHash));
+	stream << this->docId;
+	stream << this->wordsTotal;
+	stream << this->termsNum;
+	stream << this->terms;
+}
+
+void PageMetadata::readFromStream(QDataStream &stream)
+{
+	stream.readRawData((char *)this->urlHash, sizeof(this->urlHash));
+	stream.readRawData((char *)this->contentHash, sizeof(this->contentHash));
+	stream >> this->docId;
+	stream >> this->wordsTotal;
+	stream >> this->termsNum;
+	stream >> this->terms;
+	this->updateSimHash();
+}
+
+// What the same page took with QString/QByteArray fields and a per-page
+// QHash<quint64, quint64> of term frequencies; logged next to the current
+// layout for comparison.
+static qsizetype legacy_page_metadata_size(qsizetype terms_num, qsizetype strings_len)
+{
+	const qsizetype arrayHeader=16, hashData=40, spanEntries=128, spanHeader=16, hashNode=16;
+	qsizetype size=4*sizeof(QByteArray)+sizeof(QDateTime)+sizeof(QHash<quint64, quint64>)+2*sizeof(quint64);
+	size+=2*arrayHeader+strings_len+2*(arrayHeader+16);
+	qsizetype buckets=spanEntries;
+	while(buckets<terms_num*2)
+	{
+		buckets*=2;
+	}
+	size+=hashData+(buckets/spanEntries)*(spanEntries+spanHeader)+terms_num*hashNode;
+	return size;
 }
 
 Indexer::Indexer(QObject *parent) : QObject(parent)
 {
+	mNearDuplicatesDropped=0;
+	mPageStore.setCacheBlocks(gSettings->pageCacheBlocks());
+	mListPostingsNum=0;
+	mPageMetadataBytes=0;
+	mMemoryBudgetExceeded=false;
+	mTombstonesNum=0;
+	mCheckpointThread=nullptr;
+	mCheckpointPending=false;
+	mSaveRequested=false;
+	mPagesSinceCheckpoint=0;
+	mCheckpointClock.start();
+	mQueueClock.start();
 	setDatabaseDirectory(gSettings->databaseDirectory());
+	const QStringList stopWords=stop_words(gSettings->stopWordLanguageFlags());
+	for(const QString &stopWord : stopWords)
+	{
+		mStopWords.insert(termKey(stopWord));
+	}
 }
 
 Indexer::~Indexer()
 {
+	if(nullptr!=mCheckpointThread)
+	{
+		mCheckpointThread->wait();
+		delete mCheckpointThread;
+	}
 	this->clear();
 }
 
 void Indexer::printPageMetadata(const PageMetadata &page_md)
 {
+	PageRecord pageRecord=mPageStore.record(page_md.docId);
 	qDebug() << "==[ page metadata ]==";
-	qDebug() << "title:" << page_md.title;
-	qDebug() << "url:" << page_md.url;
-	qDebug() << "timeStamp:" << page_md.timeStamp.toString();
-	qDebug() << "contentHash:" << page_md.contentHash.toHex();
-	qDebug() << "urlHash:" << page_md.urlHash.toHex();
+	qDebug() << "title:" << pageRecord.title;
+	qDebug() << "url:" << pageRecord.url;
+	qDebug() << "timeStamp:" << QDateTime::fromMSecsSinceEpoch(pageRecord.timeStamp).toString();
+	qDebug() << "contentHash:" << page_md.contentHashBytes().toHex();
+	qDebug() << "urlHash:" << page_md.urlHashBytes().toHex();
 	qDebug() << "words:";
-	QHash<quint64, quint64>::const_iterator pageTfIt;
-	for(pageTfIt=page_md.wordsAsHashes.constBegin(); pageTfIt != page_md.wordsAsHashes.constEnd(); pageTfIt++)
-	{
-		quint64 wordHash=pageTfIt.key();
-		quint64 wordTf=pageTfIt.value();
-		const QString &word=mDictionaryLookupTable.value(wordHash);
-		qDebug() << word << wordTf;
-	}
+	page_md.forEachTerm([this](quint32 term_id, quint32 tf)
+		{
+			qDebug() << mDictionary.surface(term_id) << tf;
+		});
 }
 
 void Indexer::clear()
 {
 	qDeleteAll(mIndexByContentHash);
 	mIndexByContentHash.clear();
+	mNearDuplicates.clear();
 	mIndexByUrlHash.clear();
+	mDictionary.clear();
 	mTableOfContents.clear();
+	mBitmapPostings.clear();
+	mStopWordTermIds.clear();
+	mDocIds.clear();
+	mDocContentHashes.clear();
+	mLiveDocs.clear();
+	mTombstonesNum=0;
+	mPageStore.clear();
+	mSegments.clear();
+	mListPostingsNum=0;
+	mPageMetadataBytes=0;
 }
 
 void Indexer::setDatabaseDirectory(const QString &database_directory)
@@ -113,18 +249,171 @@ void Indexer::setDatabaseDirectory(const QString &database_directory)
 	}
 }
 
+// Pages of the other index are taken in its doc ID order and appended here,
+// so remapped doc IDs keep that order and every posting list of the other
+// index turns into an ascending run of new doc IDs. Each run is then added to
+// its term at once, which keeps the cost linear in the number of postings.
 void Indexer::merge(const Indexer &other)
 {
-	QHash<QByteArray, PageMetadata *>::const_iterator cHashIt;
-	this->mDictionaryLookupTable.insert(other.mDictionaryLookupTable);
-	for(cHashIt=other.mIndexByContentHash.constBegin(); cHashIt != other.mIndexByContentHash.constEnd(); cHashIt++)
+	QElapsedTimer mergeTimer;
+	mergeTimer.start();
+	QList<quint32> termIds(other.mDictionary.size());
+	for(qsizetype otherTermId=0; otherTermId<other.mDictionary.size(); otherTermId++)
+	{
+		const QByteArray term=other.mDictionary.term(otherTermId);
+		const QByteArray surface=other.mDictionary.surface(otherTermId).toUtf8();
+		termIds[otherTermId]=addTerm(term.constData(), term.size(), other.mDictionary.hash(otherTermId),
+			surface.constData(), surface.size());
+	}
+	QList<quint32> docIds(other.mDocContentHashes.size(), INVALID_DOC_ID);
+	quint32 pagesMerged=0, pagesSkipped=0;
+	other.mLiveDocs.forEach([this, &other, &termIds, &docIds, &pagesMerged, &pagesSkipped](quint32 other_doc_id)
+		{
+			const QByteArray contentHash=other.mDocContentHashes.value(other_doc_id);
+			const PageMetadata *otherPage=other.mIndexByContentHash.value(contentHash, nullptr);
+			if(nullptr==otherPage)
+			{
+				return;
+			}
+			if(mIndexByContentHash.contains(contentHash))
+			{
+				pagesSkipped++;
+				return;
+			}
+			const QByteArray urlHash=otherPage->urlHashBytes();
+			PageMetadata *previousVersion=mIndexByUrlHash.value(urlHash, nullptr);
+			PageRecord pageRecord=other.mPageStore.record(other_doc_id);
+			// Only a newer version of a known URL replaces the local one.
+			if(nullptr!=previousVersion && pageRecord.timeStamp<=mPageStore.record(previousVersion->docId).timeStamp)
+			{
+				pagesSkipped++;
+				return;
+			}
+			QList<QPair<quint32, quint32>> termFrequencies=otherPage->termFrequencies();
+			for(QPair<quint32, quint32> &termFrequency : termFrequencies)
+			{
+				termFrequency.first=termIds.at(termFrequency.first);
+			}
+			PageMetadata *pageMetaDataCopy=new PageMetadata;
+			memcpy(pageMetaDataCopy->urlHash, otherPage->urlHash, 16);
+			memcpy(pageMetaDataCopy->contentHash, otherPage->contentHash, 16);
+			pageMetaDataCopy->wordsTotal=otherPage->wordsTotal;
+			pageMetaDataCopy->setTerms(std::move(termFrequencies));
+			pageMetaDataCopy->updateSimHash();
+			QByteArray previousContentHash=previousVersion ? previousVersion->contentHashBytes() : QByteArray();
+			if(!mNearDuplicates.findNearDuplicate(pageMetaDataCopy->simHash, gSettings->nearDuplicateDistance(), previousContentHash).isEmpty())
+			{
+				mNearDuplicatesDropped++;
+				pagesSkipped++;
+				delete pageMetaDataCopy;
+				return;
+			}
+			if(nullptr!=previousVersion)
+			{
+				removePage(previousVersion);
+			}
+			PageHeader pageHeader;
+			pageHeader.title=pageRecord.title;
+			pageHeader.url=pageRecord.url;
+			pageHeader.urlHash=urlHash;
+			pageHeader.contentHash=contentHash;
+			pageHeader.timeStamp=QDateTime::fromMSecsSinceEpoch(pageRecord.timeStamp);
+			quint32 docId=assignDocId(pageHeader);
+			pageMetaDataCopy->docId=docId;
+			docIds[other_doc_id]=docId;
+			mIndexByUrlHash.insert(urlHash, pageMetaDataCopy);
+			mIndexByContentHash.insert(contentHash, pageMetaDataCopy);
+			mNearDuplicates.insert(pageMetaDataCopy->simHash, contentHash);
+			mPageMetadataBytes+=pageMetaDataCopy->sizeInBytes()+PAGE_INDEX_BYTES;
+			pagesMerged++;
+		});
+	QList<quint32> termDocIds;
+	qint64 postingsMerged=0;
+	for(qsizetype otherTermId=0; otherTermId<other.mDictionary.size(); otherTermId++)
 	{
-		const PageMetadata *pageMetaDataPtr=cHashIt.value();
-		if(nullptr!=pageMetaDataPtr)
+		termDocIds.clear();
+		QHash<quint32, RoaringBitmap>::const_iterator bitmapIt=other.mBitmapPostings.constFind(otherTermId);
+		if(bitmapIt!=other.mBitmapPostings.constEnd())
+		{
+			bitmapIt->forEach([&docIds, &termDocIds](quint32 other_doc_id)
+				{
+					quint32 docId=docIds.value(other_doc_id, INVALID_DOC_ID);
+					if(docId!=INVALID_DOC_ID)
+					{
+						termDocIds.append(docId);
+					}
+				});
+		}
+		else
 		{
-			addPage(*pageMetaDataPtr);
+			const QSet<QByteArray> postings=other.listPostings(otherTermId);
+			for(const QByteArray &contentHash : postings)
+			{
+				QHash<QByteArray, quint32>::const_iterator docIdIt=other.mDocIds.constFind(contentHash);
+				quint32 docId=(docIdIt!=other.mDocIds.constEnd() ? docIds.value(docIdIt.value(), INVALID_DOC_ID) : INVALID_DOC_ID);
+				if(docId!=INVALID_DOC_ID)
+				{
+					termDocIds.append(docId);
+				}
+			}
+			std::sort(termDocIds.begin(), termDocIds.end());
 		}
+		if(!termDocIds.isEmpty())
+		{
+			addPostings(termIds.at(otherTermId), termDocIds);
+			postingsMerged+=termDocIds.size();
+		}
+	}
+	enforceMemoryBudget();
+	if(compactionDue())
+	{
+		compact();
+	}
+	qInfo() << "Merged" << pagesMerged << "pages and" << postingsMerged << "postings," << pagesSkipped << "pages already known, older than the local version or near-duplicates, in" <<
+		mergeTimer.elapsed() << "ms";
+}
+
+QByteArray Indexer::termKey(const QString &word) const
+{
+	QByteArray wordUtf8=word.toUtf8();
+	int stemmingLanguages=gSettings->stemmingLanguageFlags();
+	if(stemmingLanguages!=STEMMER_LANGUAGE_NONE)
+	{
+		QByteArray stem(wordUtf8.size(), 0);
+		stem.resize(stem_word_utf8((const uint8_t *)wordUtf8.constData(), wordUtf8.size(), stemmingLanguages, (uint8_t *)stem.data()));
+		return stem;
+	}
+	return wordUtf8;
+}
+
+quint32 Indexer::termId(const QString &word) const
+{
+	return mDictionary.find(termKey(word));
+}
+
+bool Indexer::isStopWord(quint32 term_id) const
+{
+	return mStopWordTermIds.contains(term_id);
+}
+
+qsizetype Indexer::documentFrequency(quint32 term_id) const
+{
+	QHash<quint32, RoaringBitmap>::const_iterator bitmapIt=mBitmapPostings.constFind(term_id);
+	if(bitmapIt!=mBitmapPostings.constEnd())
+	{
+		return bitmapIt->cardinality();
 	}
+	qsizetype df=mTableOfContents.value(term_id).size();
+	for(const PostingSegmentPointer &segment : mSegments)
+	{
+		df+=segment->documentFrequency(term_id);
+	}
+	return df;
+}
+
+quint32 Indexer::tombstonesNum() const
+{
+	return mTombstonesNum;
 }
 
 const PageMetadata *Indexer::getPageMetadataByContentHash(const QByteArray &content_hash) const
@@ -139,6 +428,21 @@ const PageMetadata *Indexer::getPageMetadataByUrlHash(const QByteArray &url_hash
 	return page;
 }
 
+QString Indexer::pageTitle(const PageMetadata *page) const
+{
+	return mPageStore.record(page->docId).title;
+}
+
+QByteArray Indexer::pageUrl(const PageMetadata *page) const
+{
+	return mPageStore.record(page->docId).url;
+}
+
+QDateTime Indexer::pageTimeStamp(const PageMetadata *page) const
+{
+	return QDateTime::fromMSecsSinceEpoch(mPageStore.record(page->docId).timeStamp);
+}
+
 QVector<const PageMetadata *> Indexer::searchPagesByWords(QStringList words) const
 {
 	QVector<const PageMetadata *> searchResults;
@@ -146,38 +450,96 @@ QVector<const PageMetadata *> Indexer::searchPagesByWords(QStringList words) con
 	{
 		return searchResults;
 	}
-	uint64_t smallestSetKey;
-	QString smallestSetWord;
-	qsizetype smallestSetSize=LONG_LONG_MAX;
+	QList<quint32> listTerms, bitmapTerms, stopTerms;
 	for(const QString &word : words)
 	{
-		uint64_t wordHash=hash_function_64(word.toUtf8());
-		if(!mTableOfContents.contains(wordHash))
+		QByteArray wordKey=termKey(word);
+		quint32 wordTermId=mDictionary.find(wordKey);
+		if(mBitmapPostings.contains(wordTermId))
+		{
+			if(mStopWordTermIds.contains(wordTermId))
+			{
+				stopTerms.append(wordTermId);
+			}
+			else
+			{
+				bitmapTerms.append(wordTermId);
+			}
+		}
+		else if(hasListPostings(wordTermId))
+		{
+			listTerms.append(wordTermId);
+		}
+		else if(!mStopWords.contains(wordKey))
+		{
+			return searchResults;
+		}
+	}
+	// Stop words only narrow the result when nothing else is asked for.
+	if(listTerms.isEmpty() && bitmapTerms.isEmpty())
+	{
+		bitmapTerms=stopTerms;
+	}
+	std::sort(bitmapTerms.begin(), bitmapTerms.end(), [this](quint32 a, quint32 b)
+		{
+			return documentFrequency(a)<documentFrequency(b);
+		});
+	if(listTerms.isEmpty())
+	{
+		if(bitmapTerms.isEmpty())
 		{
 			return searchResults;
 		}
-		if(mTableOfContents[wordHash].size() < smallestSetSize)
+		RoaringBitmap docsIntersection=mBitmapPostings.value(bitmapTerms.first());
+		for(qsizetype i=1; i<bitmapTerms.size() && !docsIntersection.isEmpty(); i++)
+		{
+			docsIntersection&=*mBitmapPostings.constFind(bitmapTerms.at(i));
+		}
+		if(mTombstonesNum>0)
 		{
-			smallestSetSize=mTableOfContents[wordHash].size();
-			smallestSetKey=wordHash;
-			smallestSetWord=word;
+			docsIntersection&=mLiveDocs;
 		}
+		docsIntersection.forEach([this, &searchResults](quint32 doc_id)
+			{
+				const PageMetadata *searchResult=mIndexByContentHash.value(mDocContentHashes.value(doc_id), nullptr);
+				if(nullptr!=searchResult)
+				{
+					searchResults.append(searchResult);
+				}
+			});
+		return searchResults;
 	}
-	words.removeAll(smallestSetWord);
-	QSet<QByteArray> pageSubsetIntersection=mTableOfContents[smallestSetKey];
-	for(const QString &word : words)
+	std::sort(listTerms.begin(), listTerms.end(), [this](quint32 a, quint32 b)
+		{
+			return documentFrequency(a)<documentFrequency(b);
+		});
+	QSet<QByteArray> pageSubsetIntersection=listPostings(listTerms.first());
+	for(qsizetype i=1; i<listTerms.size(); i++)
 	{
-		uint64_t wordHash=hash_function_64(word.toUtf8());
-		const QSet<QByteArray> &pageSubset=mTableOfContents[wordHash];
-		pageSubsetIntersection.intersect(pageSubset);
+		pageSubsetIntersection.intersect(listPostings(listTerms.at(i)));
 		if(pageSubsetIntersection.isEmpty())
 		{
 			return searchResults;
 		}
 	}
-	for(QByteArray hash : pageSubsetIntersection)
+	for(const QByteArray &hash : pageSubsetIntersection)
 	{
-		const PageMetadata *searchResult=mIndexByContentHash.value(hash, nullptr);
+		QHash<QByteArray, quint32>::const_iterator docIdIt=mDocIds.constFind(hash);
+		if(docIdIt==mDocIds.constEnd())
+		{
+			continue;
+		}
+		quint32 docId=docIdIt.value();
+		bool matches=true;
+		for(quint32 bitmapTerm : std::as_const(bitmapTerms))
+		{
+			if(!mBitmapPostings.constFind(bitmapTerm)->contains(docId))
+			{
+				matches=false;
+				break;
+			}
+		}
+		const PageMetadata *searchResult=matches ? mIndexByContentHash.value(hash, nullptr) : nullptr;
 		if(nullptr!=searchResult)
 		{
 			searchResults.append(searchResult);
@@ -221,23 +583,23 @@ double Indexer::calculateTfIdfScore(const PageMetadata *page, const QString &wor
 		return 0.0;
 	}
 	double pageWordsTotal=page->wordsTotal;
-	quint64 wordHash=hash_function_64(word.toUtf8());
-	if(page->wordsAsHashes.value(wordHash, 0)==0)
+	quint32 wordTermId=termId(word);
+	if(mStopWordTermIds.contains(wordTermId))
 	{
 		return 0.0;
 	}
-	double tfNormalized=page->wordsAsHashes.value(wordHash, 0);
-	tfNormalized/=pageWordsTotal;
-	if(!mTableOfContents.contains(wordHash))
+	quint32 wordTf=page->termFrequency(wordTermId);
+	if(wordTf==0)
 	{
 		return 0.0;
 	}
-	const QSet<QByteArray> &pageSubset=mTableOfContents[wordHash];
-	if(pageSubset.isEmpty())
+	double tfNormalized=wordTf;
+	tfNormalized/=pageWordsTotal;
+	double df=documentFrequency(wordTermId);
+	if(df==0.0)
 	{
 		return 0.0;
 	}
-	double df=pageSubset.size();
 	double pagesTotal=mIndexByContentHash.size();
 	double idf=std::log(pagesTotal / df);
 	return (tfNormalized*idf);
@@ -285,150 +647,1373 @@ void Indexer::sortPagesByTfIdfScore(QVector<const PageMetadata *> &pages, const
 	pages=pagesNewOrder;
 }
 
-void Indexer::addPage(const PageMetadata &page_metadata)
+void Indexer::addPage(const PageHeader &page_header, QList<QPair<quint32, quint32>> term_frequencies)
+{
+	insertPage(page_header, std::move(term_frequencies), 0, false);
+}
+
+// A partial page holds only a slice of its term vector, as exported from a
+// term range, with words_total counting the whole page. More slices of the
+// same content are merged into it, and it only takes part in near-duplicate
+// detection once its vector is complete.
+void Indexer::insertPage(const PageHeader &page_header, QList<QPair<quint32, quint32>> term_frequencies, quint64 words_total, bool partial)
 {
-	if(!page_metadata.isValid())
+	if(!page_header.isValid() || term_frequencies.isEmpty())
 	{
 		return;
 	}
-	if(mIndexByUrlHash.contains(page_metadata.urlHash))
+	PageMetadata *previousVersion=mIndexByUrlHash.value(page_header.urlHash, nullptr);
+	if(nullptr!=previousVersion && memcmp(previousVersion->contentHash, page_header.contentHash.constData(), 16)==0)
 	{
+		if(partial)
+		{
+			mergePageTerms(previousVersion, term_frequencies);
+		}
 		return;
 	}
-	if(mIndexByContentHash.contains(page_metadata.contentHash))
+	PageMetadata *sameContent=mIndexByContentHash.value(page_header.contentHash, nullptr);
+	if(nullptr!=sameContent)
 	{
+		if(partial)
+		{
+			mergePageTerms(sameContent, term_frequencies);
+		}
 		return;
 	}
-	PageMetadata *pageMetaDataCopy=new PageMetadata(page_metadata);
-	QHash<quint64, quint64>::const_iterator pageTfIt;
-	for(pageTfIt=pageMetaDataCopy->wordsAsHashes.constBegin(); pageTfIt != pageMetaDataCopy->wordsAsHashes.constEnd(); pageTfIt++)
+	quint64 wordsTotal=0;
+	for(const QPair<quint32, quint32> &termFrequency : std::as_const(term_frequencies))
 	{
-		quint64 wordHash=pageTfIt.key();
-		quint64 wordTf=pageTfIt.value();
-		if(mDictionaryLookupTable.contains(wordHash) && wordTf>0)
+		if(termFrequency.first>=(quint32)mDictionary.size() || termFrequency.second==0)
 		{
-			continue;
-		}
-		else
-		{
-			delete pageMetaDataCopy;
 			return;
 		}
+		wordsTotal+=termFrequency.second;
+	}
+	const bool complete=(wordsTotal>=words_total);
+	PageMetadata *pageMetaDataCopy=new PageMetadata;
+	memcpy(pageMetaDataCopy->urlHash, page_header.urlHash.constData(), 16);
+	memcpy(pageMetaDataCopy->contentHash, page_header.contentHash.constData(), 16);
+	pageMetaDataCopy->wordsTotal=qMin(qMax(wordsTotal, words_total), (quint64)UINT32_MAX);
+	pageMetaDataCopy->setTerms(std::move(term_frequencies));
+	pageMetaDataCopy->updateSimHash();
+	QByteArray previousContentHash=previousVersion ? previousVersion->contentHashBytes() : QByteArray();
+	QByteArray nearDuplicateHash=complete ? mNearDuplicates.findNearDuplicate(pageMetaDataCopy->simHash,
+		gSettings->nearDuplicateDistance(), previousContentHash) : QByteArray();
+	if(!nearDuplicateHash.isEmpty())
+	{
+		mNearDuplicatesDropped++;
+		qDebug() << "Dropping near-duplicate page" << page_header.url << "of" << pageUrl(mIndexByContentHash.value(nearDuplicateHash));
+		delete pageMetaDataCopy;
+		return;
+	}
+	if(nullptr!=previousVersion)
+	{
+		removePage(previousVersion);
 	}
-	for(pageTfIt=pageMetaDataCopy->wordsAsHashes.constBegin(); pageTfIt != pageMetaDataCopy->wordsAsHashes.constEnd(); pageTfIt++)
+	quint32 docId=assignDocId(page_header);
+	pageMetaDataCopy->docId=docId;
+	pageMetaDataCopy->forEachTerm([this, &page_header, docId](quint32 term_id, quint32)
+		{
+			addPosting(term_id, page_header.contentHash, docId);
+		});
+	mIndexByUrlHash.insert(page_header.urlHash, pageMetaDataCopy);
+	mIndexByContentHash.insert(page_header.contentHash, pageMetaDataCopy);
+	if(complete)
 	{
-		quint64 wordHash=pageTfIt.key();
-		mTableOfContents[wordHash].insert(pageMetaDataCopy->contentHash);
+		mNearDuplicates.insert(pageMetaDataCopy->simHash, page_header.contentHash);
 	}
-	mIndexByUrlHash.insert(pageMetaDataCopy->urlHash, pageMetaDataCopy);
-	mIndexByContentHash.insert(pageMetaDataCopy->contentHash, pageMetaDataCopy);
+	mPageMetadataBytes+=pageMetaDataCopy->sizeInBytes()+PAGE_INDEX_BYTES;
 }
 
-void Indexer::addWord(const QString &word)
+// Adds the terms of a slice that the page does not have yet.
+void Indexer::mergePageTerms(PageMetadata *page, const QList<QPair<quint32, quint32>> &term_frequencies)
 {
-	if(!word.isEmpty())
+	QList<QPair<quint32, quint32>> termFrequencies=page->termFrequencies();
+	const QByteArray contentHash=page->contentHashBytes();
+	QSet<quint32> termIds;
+	termIds.reserve(termFrequencies.size());
+	for(const QPair<quint32, quint32> &termFrequency : std::as_const(termFrequencies))
+	{
+		termIds.insert(termFrequency.first);
+	}
+	quint64 wordsInTerms=0;
+	bool extended=false;
+	for(const QPair<quint32, quint32> &termFrequency : term_frequencies)
+	{
+		if(termFrequency.first>=(quint32)mDictionary.size() || termFrequency.second==0 || termIds.contains(termFrequency.first))
+		{
+			continue;
+		}
+		termIds.insert(termFrequency.first);
+		termFrequencies.append(termFrequency);
+		addPosting(termFrequency.first, contentHash, page->docId);
+		extended=true;
+	}
+	if(!extended)
+	{
+		return;
+	}
+	for(const QPair<quint32, quint32> &termFrequency : std::as_const(termFrequencies))
+	{
+		wordsInTerms+=termFrequency.second;
+	}
+	mNearDuplicates.remove(page->simHash, contentHash);
+	mPageMetadataBytes-=page->sizeInBytes();
+	page->setTerms(std::move(termFrequencies));
+	page->updateSimHash();
+	mPageMetadataBytes+=page->sizeInBytes();
+	if(wordsInTerms>=page->wordsTotal)
 	{
-		quint64 wordHash=hash_function_64(word.toUtf8());
-		mDictionaryLookupTable.insert(wordHash, word);
+		mNearDuplicates.insert(page->simHash, contentHash);
 	}
 }
 
-void Indexer::save()
+// Only tombstones the doc ID: its postings stay until compaction and are
+// skipped by queries through mLiveDocs and mDocIds.
+void Indexer::removePage(PageMetadata *page)
 {
-	qDebug("Indexer::save");
-	if(mDatabaseDirectory.isEmpty())
+	const QByteArray contentHash=page->contentHashBytes();
+	quint32 docId=page->docId;
+	if(mLiveDocs.remove(docId))
 	{
-		return;
+		mTombstonesNum++;
 	}
-	QDir dbDir(mDatabaseDirectory);
-
-	quint64 dataStreamVersion=QDataStream::Qt_6_0;
-	QString dltFilePath=dbDir.filePath("index_dlt.dat");
-	QString tocFilePath=dbDir.filePath("index_toc.dat");
-	QString mdFilePath=dbDir.filePath("index_md.dat");
+	if(mDocIds.remove(contentHash))
+	{
+		mDocContentHashes[docId].clear();
+	}
+	mIndexByUrlHash.remove(page->urlHashBytes());
+	mIndexByContentHash.remove(contentHash);
+	mNearDuplicates.remove(page->simHash, contentHash);
+	mPageMetadataBytes-=page->sizeInBytes()+PAGE_INDEX_BYTES;
+	delete page;
+}
 
-	QFile dltFile(dltFilePath);
-	if(dltFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+bool Indexer::deletePage(const QByteArray &url_hash)
+{
+	PageMetadata *page=mIndexByUrlHash.value(url_hash, nullptr);
+	if(nullptr==page)
 	{
-		QDataStream dltFileStream(&dltFile);
-		dltFileStream.setVersion(QDataStream::Qt_6_0);
-		dltFileStream << dataStreamVersion;
-		dltFileStream << mDictionaryLookupTable;
-		dltFile.close();
-		qInfo() << "Dictionary lookup table has been saved successfully:" << mDictionaryLookupTable.size() << "records saved.";
+		return false;
 	}
-	else
+	removePage(page);
+	return true;
+}
+
+quint32 Indexer::assignDocId(const PageHeader &page_header)
+{
+	quint32 docId=mPageStore.append(page_header.title, page_header.url, page_header.timeStamp.toMSecsSinceEpoch());
+	mDocContentHashes.resize(mPageStore.size());
+	mDocContentHashes[docId]=page_header.contentHash;
+	mDocIds.insert(page_header.contentHash, docId);
+	mLiveDocs.add(docId);
+	return docId;
+}
+
+quint32 Indexer::addTerm(const char *term, quint32 len, quint64 hash, const char *surface, quint32 surface_len)
+{
+	qsizetype termsNum=mDictionary.size();
+	quint32 termId=mDictionary.insert(term, len, hash, surface, surface_len);
+	if(mDictionary.size()>termsNum && mStopWords.contains(QByteArray::fromRawData(term, len)))
 	{
-		qWarning() << "Failed to open" << dltFilePath << "for writing";
+		mStopWordTermIds.insert(termId);
 	}
+	return termId;
+}
 
-	QFile tocFile(tocFilePath);
-	if(tocFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+void Indexer::addPosting(quint32 term_id, const QByteArray &content_hash, quint32 doc_id)
+{
+	QHash<quint32, RoaringBitmap>::iterator bitmapIt=mBitmapPostings.find(term_id);
+	if(bitmapIt!=mBitmapPostings.end())
 	{
-		QDataStream tocFileStream(&tocFile);
-		tocFileStream.setVersion(QDataStream::Qt_6_0);
-		tocFileStream << dataStreamVersion;
-		tocFileStream << mTableOfContents;
-		tocFile.close();
-		qInfo() << "Table of contents has been saved successfully:" << mTableOfContents.size() << "records saved.";
+		bitmapIt->add(doc_id);
+		return;
 	}
-	else
+	QSet<QByteArray> &postings=mTableOfContents[term_id];
+	qsizetype postingsNum=postings.size();
+	postings.insert(content_hash);
+	mListPostingsNum+=postings.size()-postingsNum;
+	if(mStopWordTermIds.contains(term_id) || documentFrequency(term_id)>=gSettings->bitmapPostingsMinDf())
 	{
-		qWarning() << "Failed to open" << tocFilePath << "for writing";
+		promoteToBitmap(term_id);
 	}
+}
 
-	QFile mdFile(mdFilePath);
-	if(mdFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+// Adds postings of pages that have just been given doc_ids, in ascending order,
+// deciding between list and bitmap postings once for the whole run.
+void Indexer::addPostings(quint32 term_id, const QList<quint32> &doc_ids)
+{
+	QHash<quint32, RoaringBitmap>::iterator bitmapIt=mBitmapPostings.find(term_id);
+	if(bitmapIt==mBitmapPostings.end() && (mStopWordTermIds.contains(term_id) ||
+		documentFrequency(term_id)+doc_ids.size()>=gSettings->bitmapPostingsMinDf()))
 	{
-		QDataStream mdFileStream(&mdFile);
-		mdFileStream.setVersion(QDataStream::Qt_6_0);
-		mdFileStream << dataStreamVersion;
-		quint64 numOfPages=mIndexByContentHash.size();
-		mdFileStream << numOfPages;
-		QHash<QByteArray, PageMetadata *>::const_iterator cHashIt;
-		for(cHashIt=mIndexByContentHash.constBegin(); cHashIt!=mIndexByContentHash.constEnd(); cHashIt++)
+		promoteToBitmap(term_id);
+		bitmapIt=mBitmapPostings.find(term_id);
+	}
+	if(bitmapIt!=mBitmapPostings.end())
+	{
+		for(quint32 docId : doc_ids)
 		{
-			const PageMetadata *pageMDPtr=cHashIt.value();
-			if(nullptr!=pageMDPtr)
-			{
-				pageMDPtr->writeToStream(mdFileStream);
-			}
+			bitmapIt->add(docId);
 		}
-		mdFile.close();
-		qInfo() << "Metadata has been saved successfully:" << mIndexByContentHash.size() << "records saved.";
+		return;
 	}
-	else
+	QSet<QByteArray> &postings=mTableOfContents[term_id];
+	qsizetype postingsNum=postings.size();
+	postings.reserve(postingsNum+doc_ids.size());
+	for(quint32 docId : doc_ids)
 	{
-		qWarning() << "Failed to open" << mdFilePath << "for writing";
+		postings.insert(mDocContentHashes.at(docId));
 	}
+	mListPostingsNum+=postings.size()-postingsNum;
 }
 
-void Indexer::load()
+void Indexer::promoteToBitmap(quint32 term_id)
 {
-	qDebug("Indexer::load");
-	if(mDatabaseDirectory.isEmpty())
+	const QSet<QByteArray> postings=listPostings(term_id);
+	mListPostingsNum-=mTableOfContents.take(term_id).size();
+	RoaringBitmap &bitmap=mBitmapPostings[term_id];
+	for(const QByteArray &contentHash : postings)
 	{
-		return;
+		QHash<QByteArray, quint32>::const_iterator docIdIt=mDocIds.constFind(contentHash);
+		if(docIdIt!=mDocIds.constEnd())
+		{
+			bitmap.add(docIdIt.value());
+		}
 	}
-	QDir dbDir(mDatabaseDirectory);
+}
 
-	quint64 dataStreamVersion, numOfPages;
-	QString dltFilePath=dbDir.filePath("index_dlt.dat");
+void Indexer::rebuildBitmapPostings()
+{
+	QList<quint32> frequentTerms;
+	QHash<quint32, QSet<QByteArray>>::const_iterator tocIt;
+	for(tocIt=mTableOfContents.constBegin(); tocIt!=mTableOfContents.constEnd(); tocIt++)
+	{
+		if(mStopWordTermIds.contains(tocIt.key()) || tocIt->size()>=gSettings->bitmapPostingsMinDf())
+		{
+			frequentTerms.append(tocIt.key());
+		}
+	}
+	for(quint32 termId : std::as_const(frequentTerms))
+	{
+		promoteToBitmap(termId);
+	}
+}
+
+void Indexer::rebuildStopWordTermIds()
+{
+	mStopWordTermIds.clear();
+	for(const QByteArray &stopWord : std::as_const(mStopWords))
+	{
+		quint32 termId=mDictionary.find(stopWord);
+		if(termId!=TermDictionary::INVALID_TERM_ID)
+		{
+			mStopWordTermIds.insert(termId);
+		}
+	}
+}
+
+bool Indexer::hasListPostings(quint32 term_id) const
+{
+	if(mTableOfContents.contains(term_id))
+	{
+		return true;
+	}
+	for(const PostingSegmentPointer &segment : mSegments)
+	{
+		if(segment->contains(term_id))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+QSet<QByteArray> Indexer::listPostings(quint32 term_id) const
+{
+	QSet<QByteArray> postings=mTableOfContents.value(term_id);
+	for(const PostingSegmentPointer &segment : mSegments)
+	{
+		if(segment->contains(term_id))
+		{
+			postings.unite(segment->postings(term_id));
+		}
+	}
+	return postings;
+}
+
+void Indexer::spillPostings()
+{
+	if(mDatabaseDirectory.isEmpty() || mTableOfContents.isEmpty())
+	{
+		return;
+	}
+	PostingSegmentPointer segment=PostingSegment::write(QDir(mDatabaseDirectory).filePath("postings_XXXXXX.seg"), mTableOfContents);
+	if(segment.isNull())
+	{
+		return;
+	}
+	qInfo() << "Spilled" << segment->postingsNum() << "postings of" << mTableOfContents.size() << "terms to disk.";
+	mSegments.append(segment);
+	mTableOfContents.clear();
+	mListPostingsNum=0;
+	if(mSegments.size()>SEGMENTS_MAX)
+	{
+		mergeSegments();
+	}
+}
+
+void Indexer::mergeSegments()
+{
+	PostingSegmentPointer merged=PostingSegment::merge(QDir(mDatabaseDirectory).filePath("postings_XXXXXX.seg"), mSegments,
+		[this](quint32 term_id, const QByteArray &content_hash)
+		{
+			return !mBitmapPostings.contains(term_id) && mDocIds.contains(content_hash);
+		});
+	if(merged.isNull())
+	{
+		return;
+	}
+	qInfo() << "Merged" << mSegments.size() << "posting segments:" << merged->postingsNum() << "live postings.";
+	mSegments.clear();
+	mSegments.append(merged);
+}
+
+IndexerMemoryUsage Indexer::memoryUsage() const
+{
+	IndexerMemoryUsage usage;
+	usage.dictionaryBytes=mDictionary.sizeInBytes();
+	usage.postingsBytes=mListPostingsNum*LIST_POSTING_BYTES+mTableOfContents.size()*LIST_POSTINGS_BYTES;
+	usage.bitmapPostingsBytes=mLiveDocs.sizeInBytes();
+	for(const RoaringBitmap &bitmap : mBitmapPostings)
+	{
+		usage.bitmapPostingsBytes+=bitmap.sizeInBytes();
+	}
+	usage.segmentsBytes=0;
+	for(const PostingSegmentPointer &segment : mSegments)
+	{
+		usage.segmentsBytes+=segment->sizeInBytes();
+	}
+	usage.metadataBytes=mPageMetadataBytes;
+	usage.pageCacheBytes=mPageStore.cacheSizeInBytes();
+	usage.pageStoreBytes=mPageStore.sizeInBytes()-usage.pageCacheBytes;
+	usage.totalBytes=usage.dictionaryBytes+usage.postingsBytes+usage.bitmapPostingsBytes+usage.segmentsBytes+
+		usage.metadataBytes+usage.pageStoreBytes+usage.pageCacheBytes;
+	usage.budgetBytes=qsizetype(gSettings->memoryBudgetMb())*1024*1024;
+	return usage;
+}
+
+void Indexer::printMemoryUsage() const
+{
+	IndexerMemoryUsage usage=memoryUsage();
+	qInfo() << "Indexer memory:" << usage.totalBytes/1024 << "KiB of" << (usage.budgetBytes ? usage.budgetBytes/1024 : -1) << "KiB budget";
+	qInfo() << "  dictionary:" << usage.dictionaryBytes/1024 << "KiB, postings:" << usage.postingsBytes/1024 << "KiB, bitmap postings:" <<
+		usage.bitmapPostingsBytes/1024 << "KiB, spilled segments:" << mSegments.size() << "(" << usage.segmentsBytes/1024 << "KiB)";
+	qInfo() << "  metadata:" << usage.metadataBytes/1024 << "KiB, page store:" << usage.pageStoreBytes/1024 << "KiB, page cache:" <<
+		usage.pageCacheBytes/1024 << "KiB";
+}
+
+double IndexStatistics::termsPerPage() const
+{
+	return pagesNum ? double(termsTotal)/pagesNum : 0.0;
+}
+
+double IndexStatistics::wordsPerPage() const
+{
+	return pagesNum ? double(wordsTotal)/pagesNum : 0.0;
+}
+
+double IndexStatistics::compressionRatio() const
+{
+	qint64 compressedBytes=termVectorsBytes+bitmapPostingsBytes+pageStoreBytes;
+	return compressedBytes ? double(termVectorsRawBytes+bitmapPostingsRawBytes+pageStoreRawBytes)/compressedBytes : 0.0;
+}
+
+static void add_to_histogram(QList<qsizetype> &histogram, quint64 value)
+{
+	int bucket=value>1 ? 63-qCountLeadingZeroBits(value) : 0;
+	if(histogram.size()<=bucket)
+	{
+		histogram.resize(bucket+1);
+	}
+	histogram[bucket]++;
+}
+
+static void merge_histogram(QList<qsizetype> &histogram, const QList<qsizetype> &other)
+{
+	if(histogram.size()<other.size())
+	{
+		histogram.resize(other.size());
+	}
+	for(qsizetype bucket=0; bucket<other.size(); bucket++)
+	{
+		histogram[bucket]+=other.at(bucket);
+	}
+}
+
+template<typename Item, typename Compare> static void keep_first(QList<Item> &items, int top_n, Compare compare)
+{
+	qsizetype itemsNum=qMin(items.size(), qsizetype(qMax(top_n, 0)));
+	std::partial_sort(items.begin(), items.begin()+itemsNum, items.end(), compare);
+	items.resize(itemsNum);
+}
+
+static bool is_longer_posting(const IndexStatisticsTerm &a, const IndexStatisticsTerm &b)
+{
+	return a.documentFrequency>b.documentFrequency || (a.documentFrequency==b.documentFrequency && a.termId<b.termId);
+}
+
+static bool is_larger_host(const IndexStatisticsHost &a, const IndexStatisticsHost &b)
+{
+	return a.pagesNum>b.pagesNum || (a.pagesNum==b.pagesNum && a.host<b.host);
+}
+
+// Term ranges, page metadata and page store blocks are scanned by a thread
+// pool, each task into its own partial result; the partials are merged once
+// the pool is done. The index must not change meanwhile, so this runs on the
+// indexer thread.
+IndexStatistics Indexer::statistics(int top_n) const
+{
+	const QList<const PageMetadata *> pages(mIndexByContentHash.constBegin(), mIndexByContentHash.constEnd());
+	const quint32 termsNum=mDictionary.size();
+	const qsizetype blocksNum=mPageStore.blocksNum()+1;
+	const qsizetype termTasksNum=(termsNum+STATISTICS_TERMS_PER_TASK-1)/STATISTICS_TERMS_PER_TASK;
+	const qsizetype pageTasksNum=(pages.size()+STATISTICS_PAGES_PER_TASK-1)/STATISTICS_PAGES_PER_TASK;
+	const qsizetype blockTasksNum=(blocksNum+STATISTICS_BLOCKS_PER_TASK-1)/STATISTICS_BLOCKS_PER_TASK;
+	QList<IndexStatistics> partials(termTasksNum+pageTasksNum+blockTasksNum, IndexStatistics{});
+	QList<QHash<QString, qsizetype>> hostPartials(blockTasksNum);
+	IndexStatistics *partialsData=partials.data();
+	QHash<QString, qsizetype> *hostPartialsData=hostPartials.data();
+	QThreadPool pool;
+	for(qsizetype task=0; task<termTasksNum; task++)
+	{
+		pool.start([this, top_n, termsNum, task, partial=partialsData+task]()
+			{
+				quint32 lastTermId=qMin(quint32(task+1)*STATISTICS_TERMS_PER_TASK, termsNum);
+				for(quint32 termId=task*STATISTICS_TERMS_PER_TASK; termId<lastTermId; termId++)
+				{
+					qsizetype df=documentFrequency(termId);
+					if(df==0)
+					{
+						continue;
+					}
+					QHash<quint32, RoaringBitmap>::const_iterator bitmapIt=mBitmapPostings.constFind(termId);
+					bool bitmap=(bitmapIt!=mBitmapPostings.constEnd());
+					partial->postingTermsNum++;
+					partial->postingsNum+=df;
+					add_to_histogram(partial->documentFrequencyHistogram, df);
+					if(bitmap)
+					{
+						partial->bitmapTermsNum++;
+						partial->bitmapPostingsRawBytes+=df*sizeof(quint32);
+						partial->bitmapPostingsBytes+=bitmapIt->sizeInBytes();
+					}
+					partial->longestPostings.append(IndexStatisticsTerm{termId, QString(), df, bitmap});
+					if(partial->longestPostings.size()>=2*qMax(top_n, 1))
+					{
+						keep_first(partial->longestPostings, top_n, is_longer_posting);
+					}
+				}
+				keep_first(partial->longestPostings, top_n, is_longer_posting);
+			});
+	}
+	for(qsizetype task=0; task<pageTasksNum; task++)
+	{
+		pool.start([&pages, task, partial=partialsData+termTasksNum+task]()
+			{
+				qsizetype lastPage=qMin((task+1)*STATISTICS_PAGES_PER_TASK, pages.size());
+				for(qsizetype page=task*STATISTICS_PAGES_PER_TASK; page<lastPage; page++)
+				{
+					const PageMetadata *pageMetadata=pages.at(page);
+					if(nullptr==pageMetadata)
+					{
+						continue;
+					}
+					partial->pagesNum++;
+					partial->termsTotal+=pageMetadata->termsNum;
+					partial->wordsTotal+=pageMetadata->wordsTotal;
+					partial->termVectorsRawBytes+=qint64(pageMetadata->termsNum)*2*sizeof(quint32);
+					partial->termVectorsBytes+=pageMetadata->terms.size();
+				}
+			});
+	}
+	for(qsizetype task=0; task<blockTasksNum; task++)
+	{
+		pool.start([this, blocksNum, task, hosts=hostPartialsData+task]()
+			{
+				qsizetype lastBlock=qMin((task+1)*STATISTICS_BLOCKS_PER_TASK, blocksNum);
+				for(qsizetype block=task*STATISTICS_BLOCKS_PER_TASK; block<lastBlock; block++)
+				{
+					const QList<PageRecord> records=mPageStore.blockRecords(block);
+					for(qsizetype record=0; record<records.size(); record++)
+					{
+						if(mLiveDocs.contains(block*PageStore::BLOCK_RECORDS+record))
+						{
+							(*hosts)[QUrl::fromEncoded(records.at(record).url).host()]++;
+						}
+					}
+				}
+			});
+	}
+	pool.waitForDone();
+
+	IndexStatistics result{};
+	result.termsNum=termsNum;
+	result.segmentsNum=mSegments.size();
+	result.tombstonesNum=mTombstonesNum;
+	for(const IndexStatistics &partial : std::as_const(partials))
+	{
+		result.postingTermsNum+=partial.postingTermsNum;
+		result.bitmapTermsNum+=partial.bitmapTermsNum;
+		result.pagesNum+=partial.pagesNum;
+		result.postingsNum+=partial.postingsNum;
+		result.termsTotal+=partial.termsTotal;
+		result.wordsTotal+=partial.wordsTotal;
+		result.termVectorsRawBytes+=partial.termVectorsRawBytes;
+		result.termVectorsBytes+=partial.termVectorsBytes;
+		result.bitmapPostingsRawBytes+=partial.bitmapPostingsRawBytes;
+		result.bitmapPostingsBytes+=partial.bitmapPostingsBytes;
+		merge_histogram(result.documentFrequencyHistogram, partial.documentFrequencyHistogram);
+		result.longestPostings.append(partial.longestPostings);
+	}
+	keep_first(result.longestPostings, top_n, is_longer_posting);
+	for(IndexStatisticsTerm &term : result.longestPostings)
+	{
+		term.surface=mDictionary.surface(term.termId);
+	}
+	QHash<QString, qsizetype> hosts;
+	for(const QHash<QString, qsizetype> &hostPartial : std::as_const(hostPartials))
+	{
+		for(QHash<QString, qsizetype>::const_iterator hostIt=hostPartial.constBegin(); hostIt!=hostPartial.constEnd(); hostIt++)
+		{
+			hosts[hostIt.key()]+=hostIt.value();
+		}
+	}
+	result.hostsNum=hosts.size();
+	for(QHash<QString, qsizetype>::const_iterator hostIt=hosts.constBegin(); hostIt!=hosts.constEnd(); hostIt++)
+	{
+		add_to_histogram(result.pagesPerHostHistogram, hostIt.value());
+		result.largestHosts.append(IndexStatisticsHost{hostIt.key(), hostIt.value()});
+	}
+	keep_first(result.largestHosts, top_n, is_larger_host);
+	result.pageStoreRawBytes=mPageStore.rawBytes();
+	result.pageStoreBytes=mPageStore.compressedBytes();
+	result.memoryUsage=memoryUsage();
+	return result;
+}
+
+void Indexer::printStatistics(int top_n) const
+{
+	QElapsedTimer statisticsTimer;
+	statisticsTimer.start();
+	IndexStatistics statistics=this->statistics(top_n);
+	qInfo() << "Index statistics gathered in" << statisticsTimer.elapsed() << "ms";
+	qInfo() << "  terms:" << statistics.termsNum << "in dictionary," << statistics.postingTermsNum << "with postings," <<
+		statistics.bitmapTermsNum << "with bitmap postings";
+	qInfo() << "  pages:" << statistics.pagesNum << "live," << statistics.tombstonesNum << "tombstoned, postings:" << statistics.postingsNum <<
+		"in memory and" << statistics.segmentsNum << "spilled segments";
+	qInfo() << "  terms per page:" << statistics.termsPerPage() << ", words per page:" << statistics.wordsPerPage();
+	qInfo() << "  document frequency histogram:";
+	for(qsizetype bucket=0; bucket<statistics.documentFrequencyHistogram.size(); bucket++)
+	{
+		qInfo() << "    " << (quint64(1) << bucket) << "-" << (quint64(2) << bucket)-1 << ":" << statistics.documentFrequencyHistogram.at(bucket);
+	}
+	qInfo() << "  longest posting lists:";
+	for(const IndexStatisticsTerm &term : std::as_const(statistics.longestPostings))
+	{
+		qInfo() << "    " << qUtf8Printable(term.surface) << term.documentFrequency << (term.bitmap ? "(bitmap)" : "(list)");
+	}
+	qInfo() << "  hosts:" << statistics.hostsNum << ", pages per host histogram:";
+	for(qsizetype bucket=0; bucket<statistics.pagesPerHostHistogram.size(); bucket++)
+	{
+		qInfo() << "    " << (quint64(1) << bucket) << "-" << (quint64(2) << bucket)-1 << ":" << statistics.pagesPerHostHistogram.at(bucket);
+	}
+	qInfo() << "  largest hosts:";
+	for(const IndexStatisticsHost &host : std::as_const(statistics.largestHosts))
+	{
+		qInfo() << "    " << qUtf8Printable(host.host) << host.pagesNum;
+	}
+	qInfo() << "  term vectors:" << statistics.termVectorsRawBytes/1024 << "KiB raw," << statistics.termVectorsBytes/1024 << "KiB packed";
+	qInfo() << "  bitmap postings:" << statistics.bitmapPostingsRawBytes/1024 << "KiB raw," << statistics.bitmapPostingsBytes/1024 << "KiB packed";
+	qInfo() << "  page store:" << statistics.pageStoreRawBytes/1024 << "KiB raw," << statistics.pageStoreBytes/1024 << "KiB compressed";
+	qInfo() << "  compression ratio:" << statistics.compressionRatio();
+	printMemoryUsage();
+}
+
+// Pages are picked in doc ID order, so each pass decodes page store blocks
+// in sequence. Only the picked pages, the shard's terms and its postings as
+// page ordinals are held while records are written out.
+bool Indexer::exportShard(const QString &file_path, const ShardFilter &filter) const
+{
+	QElapsedTimer exportTimer;
+	exportTimer.start();
+	const bool filterRecords=!filter.host.isEmpty() || filter.from.isValid() || filter.to.isValid();
+	const bool filterTerms=!filter.termsFrom.isEmpty() || !filter.termsTo.isEmpty();
+	const qint64 from=filter.from.isValid() ? filter.from.toMSecsSinceEpoch() : std::numeric_limits<qint64>::min();
+	const qint64 to=filter.to.isValid() ? filter.to.toMSecsSinceEpoch() : std::numeric_limits<qint64>::max();
+	QList<qint8> termsInRange(filterTerms ? mDictionary.size() : 0, -1);
+	auto isTermInRange=[this, &filter, &termsInRange](quint32 term_id)
+		{
+			qint8 &inRange=termsInRange[term_id];
+			if(inRange<0)
+			{
+				const QByteArray term=mDictionary.term(term_id);
+				inRange=(filter.termsFrom.isEmpty() || term>=filter.termsFrom) && (filter.termsTo.isEmpty() || term<filter.termsTo);
+			}
+			return inRange>0;
+		};
+	QList<const PageMetadata *> pages;
+	QList<quint32> localTermIds(mDictionary.size(), TermDictionary::INVALID_TERM_ID);
+	mLiveDocs.forEach([this, &filter, filterRecords, filterTerms, from, to, &isTermInRange, &pages, &localTermIds](quint32 doc_id)
+		{
+			const PageMetadata *page=mIndexByContentHash.value(mDocContentHashes.value(doc_id), nullptr);
+			if(nullptr==page)
+			{
+				return;
+			}
+			if(filterRecords)
+			{
+				PageRecord pageRecord=mPageStore.record(doc_id);
+				if((!filter.host.isEmpty() && QUrl::fromEncoded(pageRecord.url).host().compare(filter.host, Qt::CaseInsensitive)!=0) ||
+					pageRecord.timeStamp<from || pageRecord.timeStamp>=to)
+				{
+					return;
+				}
+			}
+			bool hasTerms=false;
+			page->forEachTerm([filterTerms, &isTermInRange, &localTermIds, &hasTerms](quint32 term_id, quint32)
+				{
+					if(!filterTerms || isTermInRange(term_id))
+					{
+						localTermIds[term_id]=0;
+						hasTerms=true;
+					}
+				});
+			if(hasTerms)
+			{
+				pages.append(page);
+			}
+		});
+	QList<QPair<QByteArray, quint32>> shardTerms;
+	for(quint32 termId=0; termId<(quint32)localTermIds.size(); termId++)
+	{
+		if(localTermIds.at(termId)!=TermDictionary::INVALID_TERM_ID)
+		{
+			shardTerms.append(qMakePair(mDictionary.term(termId), termId));
+		}
+	}
+	std::sort(shardTerms.begin(), shardTerms.end());
+	ShardWriter shardWriter(file_path);
+	bool written=shardWriter.open(shardTerms.size(), pages.size());
+	for(qsizetype term=0; written && term<shardTerms.size(); term++)
+	{
+		localTermIds[shardTerms.at(term).second]=term;
+		written=shardWriter.writeTerm(shardTerms.at(term).first, mDictionary.surface(shardTerms.at(term).second).toUtf8());
+	}
+	QList<QList<quint32>> postings(shardTerms.size());
+	ShardPage shardPage;
+	for(qsizetype ordinal=0; written && ordinal<pages.size(); ordinal++)
+	{
+		const PageMetadata *page=pages.at(ordinal);
+		PageRecord pageRecord=mPageStore.record(page->docId);
+		shardPage.urlHash=page->urlHashBytes();
+		shardPage.contentHash=page->contentHashBytes();
+		shardPage.title=pageRecord.title;
+		shardPage.url=pageRecord.url;
+		shardPage.timeStamp=pageRecord.timeStamp;
+		shardPage.wordsTotal=page->wordsTotal;
+		shardPage.terms.clear();
+		page->forEachTerm([&localTermIds, &shardPage](quint32 term_id, quint32 tf)
+			{
+				quint32 localTermId=localTermIds.at(term_id);
+				if(localTermId!=TermDictionary::INVALID_TERM_ID)
+				{
+					shardPage.terms.append(qMakePair(localTermId, tf));
+				}
+			});
+		std::sort(shardPage.terms.begin(), shardPage.terms.end());
+		shardPage.partial=((quint32)shardPage.terms.size()<page->termsNum);
+		for(const QPair<quint32, quint32> &termFrequency : std::as_const(shardPage.terms))
+		{
+			postings[termFrequency.first].append(ordinal);
+		}
+		written=shardWriter.writePage(shardPage);
+	}
+	for(qsizetype term=0; written && term<postings.size(); term++)
+	{
+		written=shardWriter.writePostings(postings.at(term));
+	}
+	if(!written || !shardWriter.commit())
+	{
+		qWarning() << "Failed to export shard:" << shardWriter.errorString();
+		return false;
+	}
+	qInfo() << "Exported" << pages.size() << "pages and" << shardTerms.size() << "terms to" << file_path << "in" << exportTimer.elapsed() << "ms";
+	return true;
+}
+
+// Reads a whole shard and checks its postings against the page term vectors
+// without touching the index.
+static bool shard_consistent(const QString &file_path)
+{
+	ShardReader shardReader(file_path);
+	bool valid=shardReader.open();
+	QList<QList<quint32>> expectedPostings(valid ? shardReader.termsNum() : 0);
+	QByteArray term, surface;
+	for(quint32 localTermId=0; valid && localTermId<shardReader.termsNum(); localTermId++)
+	{
+		valid=shardReader.readTerm(term, surface);
+	}
+	ShardPage shardPage;
+	for(quint32 page=0; valid && page<shardReader.pagesNum(); page++)
+	{
+		valid=shardReader.readPage(shardPage);
+		for(qsizetype term=0; valid && term<shardPage.terms.size(); term++)
+		{
+			expectedPostings[shardPage.terms.at(term).first].append(page);
+		}
+	}
+	QList<quint32> pageOrdinals;
+	for(quint32 localTermId=0; valid && localTermId<shardReader.termsNum(); localTermId++)
+	{
+		valid=shardReader.readPostings(pageOrdinals);
+		if(valid && pageOrdinals!=expectedPostings.at(localTermId))
+		{
+			qWarning() << "Postings of term" << localTermId << "in" << file_path << "disagree with the term vectors";
+			valid=false;
+		}
+	}
+	valid=valid && shardReader.finish();
+	if(!valid)
+	{
+		qWarning() << "Failed to import shard:" << (shardReader.errorString().isEmpty() ? QString("inconsistent postings") : shardReader.errorString());
+	}
+	return valid;
+}
+
+// Terms are merged into the dictionary and pages go through insertPage(), so
+// imported pages are deduplicated against and replace older versions the same
+// way crawled ones do, and term-range slices of one page are reassembled. The
+// shard is read twice: once to validate it whole, so a bad shard leaves the
+// index untouched, and once to import it. Only an I/O error between the two
+// passes can leave it imported in part.
+bool Indexer::importShard(const QString &file_path)
+{
+	QElapsedTimer importTimer;
+	importTimer.start();
+	if(!shard_consistent(file_path))
+	{
+		return false;
+	}
+	ShardReader shardReader(file_path);
+	bool valid=shardReader.open();
+	QList<quint32> termIds;
+	QByteArray term, surface;
+	termIds.reserve(valid ? shardReader.termsNum() : 0);
+	for(quint32 localTermId=0; valid && localTermId<shardReader.termsNum(); localTermId++)
+	{
+		valid=shardReader.readTerm(term, surface);
+		if(valid)
+		{
+			termIds.append(addTerm(term.constData(), term.size(), hash_function_64(term), surface.constData(), surface.size()));
+		}
+	}
+	ShardPage shardPage;
+	quint32 pagesImported=0, pagesOutdated=0, pagesExtended=0;
+	for(quint32 page=0; valid && page<shardReader.pagesNum(); page++)
+	{
+		valid=shardReader.readPage(shardPage);
+		if(!valid)
+		{
+			break;
+		}
+		QList<QPair<quint32, quint32>> termFrequencies;
+		termFrequencies.reserve(shardPage.terms.size());
+		for(const QPair<quint32, quint32> &termFrequency : std::as_const(shardPage.terms))
+		{
+			termFrequencies.append(qMakePair(termIds.at(termFrequency.first), termFrequency.second));
+		}
+		const PageMetadata *previousVersion=mIndexByUrlHash.value(shardPage.urlHash, nullptr);
+		if(nullptr!=previousVersion && memcmp(previousVersion->contentHash, shardPage.contentHash.constData(), 16)!=0 &&
+			shardPage.timeStamp<=mPageStore.record(previousVersion->docId).timeStamp)
+		{
+			pagesOutdated++;
+			continue;
+		}
+		PageHeader pageHeader;
+		pageHeader.title=shardPage.title;
+		pageHeader.url=shardPage.url;
+		pageHeader.urlHash=shardPage.urlHash;
+		pageHeader.contentHash=shardPage.contentHash;
+		pageHeader.timeStamp=QDateTime::fromMSecsSinceEpoch(shardPage.timeStamp);
+		bool known=mIndexByContentHash.contains(pageHeader.contentHash);
+		insertPage(pageHeader, std::move(termFrequencies), shardPage.wordsTotal, shardPage.partial);
+		if(!known && mIndexByContentHash.contains(pageHeader.contentHash))
+		{
+			pagesImported++;
+		}
+		else if(known && shardPage.partial)
+		{
+			pagesExtended++;
+		}
+	}
+	enforceMemoryBudget();
+	if(compactionDue())
+	{
+		compact();
+	}
+	if(!valid)
+	{
+		qWarning() << "Failed to import shard:" << shardReader.errorString() << "-" << pagesImported << "pages imported";
+		return false;
+	}
+	qInfo() << "Imported" << pagesImported << "of" << shardReader.pagesNum() << "pages from" << file_path << "in" << importTimer.elapsed() << "ms," <<
+		pagesExtended << "partial pages extended," << pagesOutdated << "pages skipped as older than the local version";
+	return true;
+}
+
+void Indexer::enforceMemoryBudget()
+{
+	IndexerMemoryUsage usage=memoryUsage();
+	if(usage.budgetBytes==0 || usage.totalBytes<=usage.budgetBytes)
+	{
+		mMemoryBudgetExceeded=false;
+		return;
+	}
+	if(usage.pageCacheBytes>0)
+	{
+		mPageStore.evictCache();
+		usage=memoryUsage();
+	}
+	// Small spills would only pile up segments; wait until postings are a
+	// sizeable share of the budget.
+	if(usage.totalBytes>usage.budgetBytes && usage.postingsBytes>=usage.budgetBytes/8)
+	{
+		spillPostings();
+		usage=memoryUsage();
+	}
+	if(usage.totalBytes>usage.budgetBytes && !mMemoryBudgetExceeded)
+	{
+		qWarning() << "Indexer memory budget exceeded:" << usage.totalBytes/1024 << "KiB used of" << usage.budgetBytes/1024 << "KiB";
+		printMemoryUsage();
+	}
+	mMemoryBudgetExceeded=(usage.totalBytes>usage.budgetBytes);
+}
+
+bool Indexer::compactionDue() const
+{
+	double compactionDeletedRatio=gSettings->compactionDeletedRatio();
+	return compactionDeletedRatio>0.0 && mTombstonesNum>=COMPACTION_TOMBSTONES_MIN &&
+		mTombstonesNum>=compactionDeletedRatio*mDocContentHashes.size();
+}
+
+// Drops tombstoned doc IDs from postings, segments and the page store and
+// renumbers the live ones densely. New doc IDs keep the order of the old
+// ones, so every bitmap is rebuilt in a single ascending pass.
+void Indexer::compact()
+{
+	if(mTombstonesNum==0)
+	{
+		return;
+	}
+	QElapsedTimer compactionTimer;
+	compactionTimer.start();
+	QList<quint32> liveDocIds;
+	QList<quint32> newDocIds(mDocContentHashes.size(), INVALID_DOC_ID);
+	QList<QByteArray> docContentHashes;
+	liveDocIds.reserve(mLiveDocs.cardinality());
+	docContentHashes.reserve(mLiveDocs.cardinality());
+	mLiveDocs.forEach([this, &liveDocIds, &newDocIds, &docContentHashes](quint32 doc_id)
+		{
+			newDocIds[doc_id]=liveDocIds.size();
+			liveDocIds.append(doc_id);
+			docContentHashes.append(mDocContentHashes.value(doc_id));
+		});
+	QHash<quint32, RoaringBitmap>::iterator bitmapIt=mBitmapPostings.begin();
+	while(bitmapIt!=mBitmapPostings.end())
+	{
+		RoaringBitmap bitmap;
+		bitmapIt->forEach([&newDocIds, &bitmap](quint32 doc_id)
+			{
+				quint32 newDocId=newDocIds.value(doc_id, INVALID_DOC_ID);
+				if(newDocId!=INVALID_DOC_ID)
+				{
+					bitmap.add(newDocId);
+				}
+			});
+		if(bitmap.isEmpty())
+		{
+			bitmapIt=mBitmapPostings.erase(bitmapIt);
+		}
+		else
+		{
+			*bitmapIt=std::move(bitmap);
+			bitmapIt++;
+		}
+	}
+	QHash<quint32, QSet<QByteArray>>::iterator tocIt=mTableOfContents.begin();
+	while(tocIt!=mTableOfContents.end())
+	{
+		QSet<QByteArray>::iterator postingIt=tocIt->begin();
+		while(postingIt!=tocIt->end())
+		{
+			if(mDocIds.contains(*postingIt))
+			{
+				postingIt++;
+			}
+			else
+			{
+				postingIt=tocIt->erase(postingIt);
+				mListPostingsNum--;
+			}
+		}
+		if(tocIt->isEmpty())
+		{
+			tocIt=mTableOfContents.erase(tocIt);
+		}
+		else
+		{
+			tocIt++;
+		}
+	}
+	if(!mSegments.isEmpty())
+	{
+		mergeSegments();
+	}
+	for(PageMetadata *page : std::as_const(mIndexByContentHash))
+	{
+		if(nullptr!=page)
+		{
+			page->docId=newDocIds.at(page->docId);
+		}
+	}
+	for(QHash<QByteArray, quint32>::iterator docIdIt=mDocIds.begin(); docIdIt!=mDocIds.end(); docIdIt++)
+	{
+		docIdIt.value()=newDocIds.at(docIdIt.value());
+	}
+	mDocContentHashes=std::move(docContentHashes);
+	mLiveDocs.clear();
+	for(quint32 docId=0; docId<(quint32)liveDocIds.size(); docId++)
+	{
+		mLiveDocs.add(docId);
+	}
+	mPageStore.retain(liveDocIds);
+	qInfo() << "Index compacted:" << mTombstonesNum << "tombstones reclaimed," << liveDocIds.size() << "live pages in" <<
+		compactionTimer.elapsed() << "ms";
+	mTombstonesNum=0;
+}
+
+void Indexer::addWord(const QString &word)
+{
+	if(!word.isEmpty())
+	{
+		const QByteArray key=termKey(word);
+		const QByteArray surface=word.toUtf8();
+		addTerm(key.constData(), key.size(), hash_function_64(key), surface.constData(), surface.size());
+	}
+}
+
+void Indexer::addBatch(IndexBatchPointer batch)
+{
+	if(batch.isNull())
+	{
+		return;
+	}
+	QList<quint32> termIds;
+	termIds.reserve(batch->terms.size());
+	const char *termArena=batch->termArena.constData();
+	for(const IndexBatchTermText &termText : batch->terms)
+	{
+		termIds.append(addTerm(termArena+termText.offset, termText.length, termText.hash,
+			termArena+termText.surfaceOffset, termText.surfaceLength));
+	}
+	for(const IndexBatchPage &batchPage : batch->pages)
+	{
+		QList<QPair<quint32, quint32>> termFrequencies;
+		termFrequencies.reserve(batchPage.terms.size());
+		for(const IndexBatchTerm &term : batchPage.terms)
+		{
+			termFrequencies.append(qMakePair(termIds.value(term.term, TermDictionary::INVALID_TERM_ID), term.tf));
+		}
+		addPage(batchPage.header, std::move(termFrequencies));
+	}
+	for(const QByteArray &urlHash : batch->removedUrlHashes)
+	{
+		deletePage(urlHash);
+	}
+}
+
+void Indexer::enqueueBatch(IndexBatchPointer batch)
+{
+	if(batch.isNull())
+	{
+		return;
+	}
+	mIngestQueue.push({batch, mQueueClock.nsecsElapsed()});
+	mBatchesEnqueued++;
+	if(mDrainScheduled.testAndSetOrdered(0, 1))
+	{
+		QMetaObject::invokeMethod(this, &Indexer::onDrainRequested, Qt::QueuedConnection);
+	}
+}
+
+void Indexer::onDrainRequested()
+{
+	mDrainScheduled.storeRelease(0);
+	if(drainIngestQueue(DRAIN_BATCHES_MAX)==DRAIN_BATCHES_MAX)
+	{
+		if(mDrainScheduled.testAndSetOrdered(0, 1))
+		{
+			QMetaObject::invokeMethod(this, &Indexer::onDrainRequested, Qt::QueuedConnection);
+		}
+	}
+	if((gSettings->checkpointPages()>0 && mPagesSinceCheckpoint>=gSettings->checkpointPages()) ||
+		(gSettings->checkpointInterval()>0 && mPagesSinceCheckpoint>0 && mCheckpointClock.elapsed()>=gSettings->checkpointInterval()*1000LL))
+	{
+		checkpoint();
+	}
+}
+
+int Indexer::drainIngestQueue(int batches_max)
+{
+	int batchesDrained=0;
+	QueuedBatch queuedBatch;
+	while((batches_max<0 || batchesDrained<batches_max) && mIngestQueue.pop(queuedBatch))
+	{
+		quint64 latency=mQueueClock.nsecsElapsed()-queuedBatch.enqueuedAt;
+		mQueueLatencyTotalNs+=latency;
+		if(latency>mQueueLatencyMaxNs.loadRelaxed())
+		{
+			mQueueLatencyMaxNs.storeRelaxed(latency);
+		}
+		addBatch(queuedBatch.batch);
+		enforceMemoryBudget();
+		if(compactionDue())
+		{
+			compact();
+		}
+		mBatchesProcessed++;
+		mPagesProcessed+=queuedBatch.batch->pages.size();
+		mPagesSinceCheckpoint+=queuedBatch.batch->pages.size();
+		queuedBatch.batch.reset();
+		batchesDrained++;
+	}
+	return batchesDrained;
+}
+
+IndexerQueueStatistics Indexer::queueStatistics() const
+{
+	IndexerQueueStatistics statistics;
+	double uptime=qMax((qint64)1, mQueueClock.elapsed())/1000.0;
+	statistics.batchesEnqueued=mBatchesEnqueued.loadRelaxed();
+	statistics.batchesProcessed=mBatchesProcessed.loadRelaxed();
+	statistics.pagesProcessed=mPagesProcessed.loadRelaxed();
+	statistics.queueDepth=statistics.batchesEnqueued-qMin(statistics.batchesEnqueued, statistics.batchesProcessed);
+	statistics.latencyMeanMs=statistics.batchesProcessed ? mQueueLatencyTotalNs.loadRelaxed()/1e6/statistics.batchesProcessed : 0.0;
+	statistics.latencyMaxMs=mQueueLatencyMaxNs.loadRelaxed()/1e6;
+	statistics.batchesPerSecond=statistics.batchesProcessed/uptime;
+	statistics.pagesPerSecond=statistics.pagesProcessed/uptime;
+	return statistics;
+}
+
+void Indexer::printQueueStatistics() const
+{
+	IndexerQueueStatistics statistics=queueStatistics();
+	qInfo() << "Indexer queue: enqueued" << statistics.batchesEnqueued << "processed" << statistics.batchesProcessed <<
+		"depth" << statistics.queueDepth;
+	qInfo() << "Indexer queue latency: mean" << statistics.latencyMeanMs << "ms, max" << statistics.latencyMaxMs << "ms";
+	qInfo() << "Indexer throughput:" << statistics.batchesPerSecond << "batches/s," << statistics.pagesPerSecond << "pages/s";
+}
+
+IndexSnapshot Indexer::snapshot() const
+{
+	IndexSnapshot snapshot;
+	snapshot.dictionary=mDictionary;
+	snapshot.tableOfContents=mTableOfContents;
+	snapshot.bitmapPostings=mBitmapPostings;
+	snapshot.segments=mSegments;
+	snapshot.docContentHashes=mDocContentHashes;
+	snapshot.tombstonesNum=mTombstonesNum;
+	snapshot.pageStore=mPageStore.snapshot();
+	snapshot.pages.reserve(mIndexByContentHash.size());
+	for(const PageMetadata *page : mIndexByContentHash)
+	{
+		if(nullptr!=page)
+		{
+			snapshot.pages.append(*page);
+		}
+	}
+	snapshot.nearDuplicatesDropped=mNearDuplicatesDropped;
+	return snapshot;
+}
+
+bool Indexer::writeSnapshot(const IndexSnapshot &snapshot, const QString &database_directory)
+{
+	QDir dbDir(database_directory);
+
+	quint64 dataStreamVersion=QDataStream::Qt_6_0;
+	QString dltFilePath=dbDir.filePath("index_dlt.dat");
 	QString tocFilePath=dbDir.filePath("index_toc.dat");
 	QString mdFilePath=dbDir.filePath("index_md.dat");
+	QString pagesFilePath=dbDir.filePath("index_pages.dat");
+
+	// Files are written next to the old ones and only renamed over them once
+	// all four have been written, so a failed checkpoint keeps the previous one.
+	QSaveFile dltFile(dltFilePath);
+	if(!dltFile.open(QIODevice::WriteOnly))
+	{
+		qWarning() << "Failed to open" << dltFilePath << "for writing";
+		return false;
+	}
+	ChecksummedDevice dltFileBlocks(&dltFile);
+	dltFileBlocks.open(QIODevice::WriteOnly);
+	QDataStream dltFileStream(&dltFileBlocks);
+	dltFileStream.setVersion(QDataStream::Qt_6_0);
+	dltFileStream << dataStreamVersion;
+	dltFileStream << INDEX_FORMAT_VERSION;
+	snapshot.dictionary.writeToStream(dltFileStream);
+
+	QSaveFile tocFile(tocFilePath);
+	if(!tocFile.open(QIODevice::WriteOnly))
+	{
+		qWarning() << "Failed to open" << tocFilePath << "for writing";
+		return false;
+	}
+	ChecksummedDevice tocFileBlocks(&tocFile);
+	tocFileBlocks.open(QIODevice::WriteOnly);
+	QDataStream tocFileStream(&tocFileBlocks);
+	tocFileStream.setVersion(QDataStream::Qt_6_0);
+	tocFileStream << dataStreamVersion;
+	tocFileStream << INDEX_FORMAT_VERSION;
+	QHash<quint32, QSet<QByteArray>> tableOfContents=snapshot.tableOfContents;
+	qsizetype postingsTotal=0, bitmapPostingsTotal=0, bitmapPostingsBytes=0;
+	if(!snapshot.segments.isEmpty() || snapshot.tombstonesNum>0)
+	{
+		QSet<QByteArray> liveContentHashes;
+		liveContentHashes.reserve(snapshot.pages.size());
+		for(const PageMetadata &page : snapshot.pages)
+		{
+			liveContentHashes.insert(page.contentHashBytes());
+		}
+		QHash<quint32, QSet<QByteArray>>::iterator tocIt=tableOfContents.begin();
+		while(tocIt!=tableOfContents.end())
+		{
+			tocIt->intersect(liveContentHashes);
+			if(tocIt->isEmpty())
+			{
+				tocIt=tableOfContents.erase(tocIt);
+			}
+			else
+			{
+				tocIt++;
+			}
+		}
+		for(const PostingSegmentPointer &segment : snapshot.segments)
+		{
+			const QList<quint32> segmentTermIds=segment->terms();
+			for(quint32 termId : segmentTermIds)
+			{
+				if(snapshot.bitmapPostings.contains(termId))
+				{
+					continue;
+				}
+				const QSet<QByteArray> segmentPostings=segment->postings(termId);
+				for(const QByteArray &contentHash : segmentPostings)
+				{
+					if(liveContentHashes.contains(contentHash))
+					{
+						tableOfContents[termId].insert(contentHash);
+					}
+				}
+			}
+		}
+	}
+	for(const QSet<QByteArray> &postings : std::as_const(tableOfContents))
+	{
+		postingsTotal+=postings.size();
+	}
+	QHash<quint32, RoaringBitmap>::const_iterator bitmapIt;
+	for(bitmapIt=snapshot.bitmapPostings.constBegin(); bitmapIt!=snapshot.bitmapPostings.constEnd(); bitmapIt++)
+	{
+		QSet<QByteArray> &postings=tableOfContents[bitmapIt.key()];
+		bitmapIt->forEach([&snapshot, &postings](quint32 doc_id)
+			{
+				const QByteArray contentHash=snapshot.docContentHashes.value(doc_id);
+				if(!contentHash.isEmpty())
+				{
+					postings.insert(contentHash);
+				}
+			});
+		bitmapPostingsTotal+=bitmapIt->cardinality();
+		bitmapPostingsBytes+=bitmapIt->sizeInBytes();
+	}
+	tocFileStream << tableOfContents;
+
+	QSaveFile pagesFile(pagesFilePath);
+	if(!pagesFile.open(QIODevice::WriteOnly))
+	{
+		qWarning() << "Failed to open" << pagesFilePath << "for writing";
+		return false;
+	}
+	ChecksummedDevice pagesFileBlocks(&pagesFile);
+	pagesFileBlocks.open(QIODevice::WriteOnly);
+	QDataStream pagesFileStream(&pagesFileBlocks);
+	pagesFileStream.setVersion(QDataStream::Qt_6_0);
+	pagesFileStream << dataStreamVersion;
+	pagesFileStream << INDEX_FORMAT_VERSION;
+	snapshot.pageStore.writeToStream(pagesFileStream);
+
+	QSaveFile mdFile(mdFilePath);
+	if(!mdFile.open(QIODevice::WriteOnly))
+	{
+		qWarning() << "Failed to open" << mdFilePath << "for writing";
+		return false;
+	}
+	ChecksummedDevice mdFileBlocks(&mdFile);
+	mdFileBlocks.open(QIODevice::WriteOnly);
+	QDataStream mdFileStream(&mdFileBlocks);
+	mdFileStream.setVersion(QDataStream::Qt_6_0);
+	mdFileStream << dataStreamVersion;
+	mdFileStream << INDEX_FORMAT_VERSION;
+	quint64 numOfPages=snapshot.pages.size();
+	mdFileStream << numOfPages;
+	qsizetype pageMetadataBytes=0, legacyPageMetadataBytes=0;
+	qsizetype pageStringsBytes=snapshot.pageStore.size() ? snapshot.pageStore.rawBytes/snapshot.pageStore.size() : 0;
+	for(const PageMetadata &page : snapshot.pages)
+	{
+		page.writeToStream(mdFileStream);
+		pageMetadataBytes+=page.sizeInBytes();
+		legacyPageMetadataBytes+=legacy_page_metadata_size(page.termsNum, pageStringsBytes);
+	}
+
+	if(!dltFileBlocks.finish() || !tocFileBlocks.finish() || !pagesFileBlocks.finish() || !mdFileBlocks.finish() ||
+		!dltFile.commit() || !tocFile.commit() || !pagesFile.commit() || !mdFile.commit())
+	{
+		qWarning() << "Failed to write index checkpoint to" << database_directory;
+		return false;
+	}
+	qInfo() << "Dictionary lookup table has been saved successfully:" << snapshot.dictionary.size() << "records saved.";
+	qInfo() << "Dictionary:" << snapshot.dictionary.sizeInBytes() << "bytes in memory," << snapshot.dictionary.collisions() <<
+		"hash collisions resolved.";
+	qInfo() << "Table of contents has been saved successfully:" << tableOfContents.size() << "records saved.";
+	qInfo() << "Postings total:" << postingsTotal+bitmapPostingsTotal << "stemming:" << gSettings->stemmingLanguages();
+	qInfo() << "Bitmap postings:" << snapshot.bitmapPostings.size() << "terms," << bitmapPostingsTotal << "postings in" <<
+		bitmapPostingsBytes << "bytes.";
+	qInfo() << "Page store has been saved successfully:" << snapshot.pageStore.size() << "records saved.";
+	qInfo() << "Metadata has been saved successfully:" << snapshot.pages.size() << "records saved.";
+	if(!snapshot.pages.isEmpty())
+	{
+		qInfo() << "Page metadata memory:" << pageMetadataBytes/snapshot.pages.size() << "bytes per page, was about" <<
+			legacyPageMetadataBytes/snapshot.pages.size() << "bytes per page with per-page QHash term maps.";
+	}
+	qInfo() << "Near-duplicate pages dropped this session:" << snapshot.nearDuplicatesDropped;
+	return true;
+}
+
+void Indexer::checkpoint()
+{
+	if(nullptr!=mCheckpointThread)
+	{
+		mCheckpointPending=true;
+		return;
+	}
+	mPagesSinceCheckpoint=0;
+	mCheckpointClock.restart();
+	if(mDatabaseDirectory.isEmpty())
+	{
+		onCheckpointFinished();
+		return;
+	}
+	QElapsedTimer snapshotTimer;
+	snapshotTimer.start();
+	IndexSnapshot indexSnapshot=snapshot();
+	qInfo() << "Index snapshot of" << indexSnapshot.pages.size() << "pages taken in" << snapshotTimer.elapsed() << "ms";
+	qInfo() << "Page store:" << mPageStore.blocksNum() << "compressed blocks," << mPageStore.rawBytes() << "bytes of records in" <<
+		mPageStore.sizeInBytes() << "bytes, cache hits" << mPageStore.cacheHits() << "misses" << mPageStore.cacheMisses();
+	printMemoryUsage();
+	QString databaseDirectory=mDatabaseDirectory;
+	mCheckpointThread=QThread::create([indexSnapshot=std::move(indexSnapshot), databaseDirectory]()
+		{
+			QElapsedTimer checkpointTimer;
+			checkpointTimer.start();
+			if(writeSnapshot(indexSnapshot, databaseDirectory))
+			{
+				qInfo() << "Index checkpoint has been written in" << checkpointTimer.elapsed() << "ms";
+			}
+		});
+	mCheckpointThread->setObjectName("checkpoint");
+	connect(mCheckpointThread, &QThread::finished, this, &Indexer::onCheckpointFinished);
+	mCheckpointThread->start(QThread::LowPriority);
+}
+
+void Indexer::onCheckpointFinished()
+{
+	if(nullptr!=mCheckpointThread)
+	{
+		mCheckpointThread->wait();
+		delete mCheckpointThread;
+		mCheckpointThread=nullptr;
+	}
+	if(mCheckpointPending)
+	{
+		mCheckpointPending=false;
+		checkpoint();
+		return;
+	}
+	if(mSaveRequested)
+	{
+		mSaveRequested=false;
+		emit saved();
+	}
+}
+
+void Indexer::save()
+{
+	qDebug("Indexer::save");
+	drainIngestQueue(-1);
+	printQueueStatistics();
+	mSaveRequested=true;
+	checkpoint();
+}
+
+void Indexer::load()
+{
+	qDebug("Indexer::load");
+	if(mDatabaseDirectory.isEmpty())
+	{
+		return;
+	}
+	QDir dbDir(mDatabaseDirectory);
+
+	quint64 dataStreamVersion, numOfPages;
+	quint32 indexFormatVersion;
+	QString dltFilePath=dbDir.filePath("index_dlt.dat");
+	QString tocFilePath=dbDir.filePath("index_toc.dat");
+	QString mdFilePath=dbDir.filePath("index_md.dat");
+	QString pagesFilePath=dbDir.filePath("index_pages.dat");
 
 	this->clear();
 
 	QFile dltFile(dltFilePath);
 	if(dltFile.open(QIODevice::ReadOnly))
 	{
-		QDataStream dltFileStream(&dltFile);
+		ChecksummedDevice dltFileBlocks(&dltFile);
+		dltFileBlocks.open(QIODevice::ReadOnly);
+		QDataStream dltFileStream(&dltFileBlocks);
 		dltFileStream.setVersion(QDataStream::Qt_6_0);
 		dltFileStream >> dataStreamVersion;
-		if(dataStreamVersion==(quint64)(QDataStream::Qt_6_0))
+		dltFileStream >> indexFormatVersion;
+		if(dataStreamVersion==(quint64)(QDataStream::Qt_6_0) && indexFormatVersion==INDEX_FORMAT_VERSION)
 		{
-			dltFileStream >> mDictionaryLookupTable;
-			qInfo() << "Dictionary lookup table has been loaded successfully:" << mDictionaryLookupTable.size() << "new records.";
+			if(mDictionary.readFromStream(dltFileStream) && dltFileBlocks.finish())
+			{
+				qInfo() << "Dictionary lookup table has been loaded successfully:" << mDictionary.size() << "new records.";
+			}
+			else
+			{
+				qWarning() << "Dictionary file corrupted:" << dltFilePath << dltFileBlocks.errorString();
+			}
+			rebuildStopWordTermIds();
 		}
 		else
 		{
@@ -444,13 +2029,28 @@ void Indexer::load()
 	QFile tocFile(tocFilePath);
 	if(tocFile.open(QIODevice::ReadOnly))
 	{
-		QDataStream tocFileStream(&tocFile);
+		ChecksummedDevice tocFileBlocks(&tocFile);
+		tocFileBlocks.open(QIODevice::ReadOnly);
+		QDataStream tocFileStream(&tocFileBlocks);
 		tocFileStream.setVersion(QDataStream::Qt_6_0);
 		tocFileStream >> dataStreamVersion;
-		if(dataStreamVersion==(quint64)(QDataStream::Qt_6_0))
+		tocFileStream >> indexFormatVersion;
+		if(dataStreamVersion==(quint64)(QDataStream::Qt_6_0) && indexFormatVersion==INDEX_FORMAT_VERSION)
 		{
 			tocFileStream >> mTableOfContents;
-			qInfo() << "Table of contents has been loaded successfully:" << mTableOfContents.size() << "new records.";
+			if(tocFileStream.status()==QDataStream::Ok && tocFileBlocks.finish())
+			{
+				qInfo() << "Table of contents has been loaded successfully:" << mTableOfContents.size() << "new records.";
+			}
+			else
+			{
+				qWarning() << "Table of contents file corrupted:" << tocFilePath << tocFileBlocks.errorString();
+				qWarning() << "Postings of" << mTableOfContents.size() << "terms have been recovered, run seeklet-fsck --repair to rebuild the rest.";
+			}
+			for(const QSet<QByteArray> &postings : std::as_const(mTableOfContents))
+			{
+				mListPostingsNum+=postings.size();
+			}
 		}
 		else
 		{
@@ -463,32 +2063,83 @@ void Indexer::load()
 		qWarning() << "Failed to open" << tocFilePath << "for reading";
 	}
 
+	QFile pagesFile(pagesFilePath);
+	if(pagesFile.open(QIODevice::ReadOnly))
+	{
+		ChecksummedDevice pagesFileBlocks(&pagesFile);
+		pagesFileBlocks.open(QIODevice::ReadOnly);
+		QDataStream pagesFileStream(&pagesFileBlocks);
+		pagesFileStream.setVersion(QDataStream::Qt_6_0);
+		pagesFileStream >> dataStreamVersion;
+		pagesFileStream >> indexFormatVersion;
+		if(dataStreamVersion==(quint64)(QDataStream::Qt_6_0) && indexFormatVersion==INDEX_FORMAT_VERSION)
+		{
+			if(mPageStore.readFromStream(pagesFileStream) && pagesFileBlocks.finish())
+			{
+				qInfo() << "Page store has been loaded successfully:" << mPageStore.size() << "new records.";
+			}
+			else
+			{
+				qWarning() << "Page store file corrupted:" << pagesFilePath << pagesFileBlocks.errorString();
+			}
+			mDocContentHashes.resize(mPageStore.size());
+		}
+		else
+		{
+			qWarning() << "Unknown file version. Cannot load data from:" << pagesFilePath;
+		}
+		pagesFile.close();
+	}
+	else
+	{
+		qWarning() << "Failed to open" << pagesFilePath << "for reading";
+	}
+
 	QFile mdFile(mdFilePath);
 	if(mdFile.open(QIODevice::ReadOnly))
 	{
-		QDataStream mdFileStream(&mdFile);
+		ChecksummedDevice mdFileBlocks(&mdFile);
+		mdFileBlocks.open(QIODevice::ReadOnly);
+		QDataStream mdFileStream(&mdFileBlocks);
 		mdFileStream.setVersion(QDataStream::Qt_6_0);
 		mdFileStream >> dataStreamVersion;
-		if(dataStreamVersion==(quint64)(QDataStream::Qt_6_0))
+		mdFileStream >> indexFormatVersion;
+		if(dataStreamVersion==(quint64)(QDataStream::Qt_6_0) && indexFormatVersion==INDEX_FORMAT_VERSION)
 		{
 			mdFileStream >> numOfPages;
 			for(quint64 page=0; page<numOfPages; page++)
 			{
-				PageMetadata newPageMetadata;
-				newPageMetadata.readFromStream(mdFileStream);
-				if(mIndexByUrlHash.contains(newPageMetadata.urlHash))
+				PageMetadata *pageMetadataCopy=new PageMetadata;
+				pageMetadataCopy->readFromStream(mdFileStream);
+				if(mdFileStream.status()!=QDataStream::Ok)
 				{
-					continue;
+					delete pageMetadataCopy;
+					break;
 				}
-				if(mIndexByContentHash.contains(newPageMetadata.contentHash))
+				const QByteArray urlHash=pageMetadataCopy->urlHashBytes();
+				const QByteArray contentHash=pageMetadataCopy->contentHashBytes();
+				quint32 docId=pageMetadataCopy->docId;
+				if(mIndexByUrlHash.contains(urlHash) || mIndexByContentHash.contains(contentHash) ||
+					docId>=(quint32)mDocContentHashes.size() || !mDocContentHashes.at(docId).isEmpty())
 				{
+					delete pageMetadataCopy;
 					continue;
 				}
-				PageMetadata *pageMetadataCopy=new PageMetadata(newPageMetadata);
-				mIndexByUrlHash.insert(pageMetadataCopy->urlHash, pageMetadataCopy);
-				mIndexByContentHash.insert(pageMetadataCopy->contentHash, pageMetadataCopy);
+				mIndexByUrlHash.insert(urlHash, pageMetadataCopy);
+				mIndexByContentHash.insert(contentHash, pageMetadataCopy);
+				mNearDuplicates.insert(pageMetadataCopy->simHash, contentHash);
+				mDocContentHashes[docId]=contentHash;
+				mDocIds.insert(contentHash, docId);
+				mLiveDocs.add(docId);
+				mPageMetadataBytes+=pageMetadataCopy->sizeInBytes()+PAGE_INDEX_BYTES;
 			}
-			if(mIndexByContentHash.size()==(qsizetype)numOfPages)
+			mTombstonesNum=mDocContentHashes.size()-mIndexByContentHash.size();
+			rebuildBitmapPostings();
+			if(mdFileStream.status()!=QDataStream::Ok || !mdFileBlocks.finish())
+			{
+				qWarning() << "Metadata file corrupted:" << mdFilePath << mdFileBlocks.errorString();
+			}
+			else if(mIndexByContentHash.size()==(qsizetype)numOfPages)
 			{
 				qInfo() << "Metadata has been loaded successfully:" << mIndexByContentHash.size() << "new records.";
 			}
@@ -509,6 +2160,11 @@ void Indexer::load()
 	{
 		qWarning() << "Failed to open" << mdFilePath << "for reading";
 	}
+	enforceMemoryBudget();
+	if(compactionDue())
+	{
+		compact();
+	}
 #ifndef NDEBUG
 	QHash<QByteArray, PageMetadata *>::const_iterator cHashIt;
 	for(cHashIt=mIndexByContentHash.constBegin(); cHashIt!=mIndexByContentHash.constEnd(); cHashIt++)
@@ -533,7 +2189,10 @@ void Indexer::searchTest()
 	query.append("hoodie");
 	// query.append("wedding");
 	// query.append("dress");
+	QElapsedTimer queryTimer;
+	queryTimer.start();
 	const QVector<const PageMetadata *> searchResults=this->searchPagesByWords(query);
+	qInfo() << "Query" << query << "returned" << searchResults.size() << "pages in" << queryTimer.nsecsElapsed()/1000 << "us";
 	QFile searchResultFile(QString("search_result.html"));
 	if(searchResultFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
 	{
@@ -542,9 +2201,9 @@ void Indexer::searchTest()
 		{
 			printPageMetadata(*pageMDPtr);
 			searchResultFile.write("<a href=\"");
-			searchResultFile.write(pageMDPtr->url.toStdString().data());
+			searchResultFile.write(pageUrl(pageMDPtr).toStdString().data());
 			searchResultFile.write("\">");
-			searchResultFile.write(pageMDPtr->title.toStdString().data());
+			searchResultFile.write(pageTitle(pageMDPtr).toStdString().data());
 			searchResultFile.write("</a><br>\n");
 			// searchResultFile.write(pageMDPtr->timeStamp.toString().toStdString().data());
 			// searchResultFile.write("\n");
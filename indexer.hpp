@@ -5,30 +5,263 @@
 #include <QStringList>
 #include <QDateTime>
 #include <QDataStream>
+#include <QSharedPointer>
+#include "near_duplicate_index.hpp"
+#include "roaring_bitmap.hpp"
+#include "mpsc_queue.hpp"
+#include "term_dictionary.hpp"
+#include "page_store.hpp"
+#include "posting_segment.hpp"
+#include "util.hpp"
+#include <QElapsedTimer>
+#include <QAtomicInteger>
+#include <QThread>
 
-struct PageMetadata
+static constexpr quint32 INDEX_FORMAT_VERSION=5;
+
+struct PageHeader
 {
 	QString title;
 	QByteArray url;
 	QByteArray urlHash;
 	QByteArray contentHash;
 	QDateTime timeStamp;
-	QHash<quint64, quint64> wordsAsHashes;
-	quint64 wordsTotal;
+	bool isValid() const;
+};
+
+// Stored form of an indexed page. Terms are sorted by term ID and packed as
+// varint (ID delta, tf) pairs; title, URL and timestamp live in the Indexer's
+// page store under docId.
+struct PageMetadata
+{
+	quint8 urlHash[16];
+	quint8 contentHash[16];
+	quint64 simHash;
+	quint32 docId;
+	quint32 wordsTotal;
+	quint32 termsNum;
+	QByteArray terms;
 	PageMetadata();
+	QByteArray urlHashBytes() const;
+	QByteArray contentHashBytes() const;
+	void setTerms(QList<QPair<quint32, quint32>> term_frequencies);
+	QList<QPair<quint32, quint32>> termFrequencies() const;
+	quint32 termFrequency(quint32 term_id) const;
+	template<typename Function> void forEachTerm(Function function) const
+	{
+		const char *data=terms.constData();
+		const char *end=data+terms.size();
+		quint64 termId=0, termIdDelta, tf;
+		while(varint_read(data, end, termIdDelta) && varint_read(data, end, tf))
+		{
+			termId+=termIdDelta;
+			function(quint32(termId), quint32(tf));
+		}
+	}
+	void updateSimHash();
+	qsizetype sizeInBytes() const;
 	void writeToStream(QDataStream &stream) const;
 	void readFromStream(QDataStream &stream);
-	bool isValid() const;
+};
+
+struct IndexBatchTerm
+{
+	quint32 term;
+	quint32 tf;
+};
+
+struct IndexBatchPage
+{
+	PageHeader header;
+	QList<IndexBatchTerm> terms;
+};
+
+struct IndexBatchTermText
+{
+	quint64 hash;
+	quint32 offset;
+	quint32 length;
+	quint32 surfaceOffset;
+	quint32 surfaceLength;
+};
+
+// One hand-off from the ingest pipeline to the Indexer: the pages with their
+// term/tf vectors, where each term indexes the batch's term table and the
+// term bytes live in termArena. Shared read-only between threads.
+struct IndexBatch
+{
+	QByteArray termArena;
+	QList<IndexBatchTermText> terms;
+	QList<IndexBatchPage> pages;
+	QList<QByteArray> removedUrlHashes;
+};
+
+typedef QSharedPointer<const IndexBatch> IndexBatchPointer;
+Q_DECLARE_METATYPE(IndexBatchPointer)
+
+struct IndexerQueueStatistics
+{
+	quint64 batchesEnqueued;
+	quint64 batchesProcessed;
+	quint64 pagesProcessed;
+	quint64 queueDepth;
+	double latencyMeanMs;
+	double latencyMaxMs;
+	double batchesPerSecond;
+	double pagesPerSecond;
+};
+
+struct IndexerMemoryUsage
+{
+	qsizetype dictionaryBytes;
+	qsizetype postingsBytes;
+	qsizetype bitmapPostingsBytes;
+	qsizetype segmentsBytes;
+	qsizetype metadataBytes;
+	qsizetype pageStoreBytes;
+	qsizetype pageCacheBytes;
+	qsizetype totalBytes;
+	qsizetype budgetBytes;
+};
+
+struct IndexStatisticsTerm
+{
+	quint32 termId;
+	QString surface;
+	qsizetype documentFrequency;
+	bool bitmap;
+};
+
+struct IndexStatisticsHost
+{
+	QString host;
+	qsizetype pagesNum;
+};
+
+// Shape of the index from one scan of postings, page metadata and the page
+// store. Histogram bucket i counts values in [2^i, 2^(i+1)). Document
+// frequencies include tombstoned pages until the next compaction.
+struct IndexStatistics
+{
+	qsizetype termsNum;
+	qsizetype postingTermsNum;
+	qsizetype bitmapTermsNum;
+	qsizetype segmentsNum;
+	qsizetype pagesNum;
+	quint32 tombstonesNum;
+	qint64 postingsNum;
+	qint64 termsTotal;
+	qint64 wordsTotal;
+	QList<qsizetype> documentFrequencyHistogram;
+	QList<IndexStatisticsTerm> longestPostings;
+	QList<qsizetype> pagesPerHostHistogram;
+	QList<IndexStatisticsHost> largestHosts;
+	qsizetype hostsNum;
+	qint64 termVectorsRawBytes;
+	qint64 termVectorsBytes;
+	qint64 bitmapPostingsRawBytes;
+	qint64 bitmapPostingsBytes;
+	qint64 pageStoreRawBytes;
+	qint64 pageStoreBytes;
+	IndexerMemoryUsage memoryUsage;
+	double termsPerPage() const;
+	double wordsPerPage() const;
+	double compressionRatio() const;
+};
+
+// Selects what goes into an exported shard. Empty or invalid fields do not
+// restrict anything; host matches exactly, the time range is [from, to) and
+// the term range [termsFrom, termsTo) compares term keys bytewise. Pages keep
+// only their terms in range and are left out if none remain.
+struct ShardFilter
+{
+	QString host;
+	QDateTime from;
+	QDateTime to;
+	QByteArray termsFrom;
+	QByteArray termsTo;
+};
+
+// Everything a checkpoint writes, taken on the indexer thread and written out
+// on a background one. Containers are implicitly shared with the live index,
+// which detaches on its next change; posting segments are immutable.
+struct IndexSnapshot
+{
+	TermDictionary dictionary;
+	QHash<quint32, QSet<QByteArray>> tableOfContents;
+	QHash<quint32, RoaringBitmap> bitmapPostings;
+	QList<PostingSegmentPointer> segments;
+	QList<QByteArray> docContentHashes;
+	quint32 tombstonesNum;
+	QList<PageMetadata> pages;
+	PageStore::Snapshot pageStore;
+	quint64 nearDuplicatesDropped;
 };
 
 class Indexer : public QObject
 {
 	Q_OBJECT
-	QHash<quint64, QString> mDictionaryLookupTable;
-	QHash<quint64, QSet<QByteArray>> mTableOfContents;
+	TermDictionary mDictionary;
+	QHash<quint32, QSet<QByteArray>> mTableOfContents;
+	QHash<quint32, RoaringBitmap> mBitmapPostings;
+	QSet<QByteArray> mStopWords;
+	QSet<quint32> mStopWordTermIds;
+	QHash<QByteArray, quint32> mDocIds;
+	QList<QByteArray> mDocContentHashes;
+	RoaringBitmap mLiveDocs;
+	quint32 mTombstonesNum;
 	QHash<QByteArray, PageMetadata *> mIndexByContentHash;
 	QHash<QByteArray, PageMetadata *> mIndexByUrlHash;
+	PageStore mPageStore;
+	static constexpr int SEGMENTS_MAX=8;
+	QList<PostingSegmentPointer> mSegments;
+	qsizetype mListPostingsNum;
+	qsizetype mPageMetadataBytes;
+	bool mMemoryBudgetExceeded;
+	NearDuplicateIndex mNearDuplicates;
+	quint64 mNearDuplicatesDropped;
+	struct QueuedBatch
+	{
+		IndexBatchPointer batch;
+		qint64 enqueuedAt;
+	};
+	static constexpr int DRAIN_BATCHES_MAX=64;
+	MpscQueue<QueuedBatch> mIngestQueue;
+	QElapsedTimer mQueueClock;
+	QAtomicInt mDrainScheduled;
+	QAtomicInteger<quint64> mBatchesEnqueued;
+	QAtomicInteger<quint64> mBatchesProcessed;
+	QAtomicInteger<quint64> mPagesProcessed;
+	QAtomicInteger<quint64> mQueueLatencyTotalNs;
+	QAtomicInteger<quint64> mQueueLatencyMaxNs;
 	QString mDatabaseDirectory;
+	QThread *mCheckpointThread;
+	bool mCheckpointPending;
+	bool mSaveRequested;
+	qsizetype mPagesSinceCheckpoint;
+	QElapsedTimer mCheckpointClock;
+	void insertPage(const PageHeader &page_header, QList<QPair<quint32, quint32>> term_frequencies, quint64 words_total, bool partial);
+	void mergePageTerms(PageMetadata *page, const QList<QPair<quint32, quint32>> &term_frequencies);
+	void removePage(PageMetadata *page);
+	quint32 assignDocId(const PageHeader &page_header);
+	quint32 addTerm(const char *term, quint32 len, quint64 hash, const char *surface, quint32 surface_len);
+	void addPosting(quint32 term_id, const QByteArray &content_hash, quint32 doc_id);
+	void addPostings(quint32 term_id, const QList<quint32> &doc_ids);
+	void promoteToBitmap(quint32 term_id);
+	void rebuildBitmapPostings();
+	void rebuildStopWordTermIds();
+	bool hasListPostings(quint32 term_id) const;
+	QSet<QByteArray> listPostings(quint32 term_id) const;
+	void spillPostings();
+	void mergeSegments();
+	void enforceMemoryBudget();
+	bool compactionDue() const;
+	int drainIngestQueue(int batches_max);
+	IndexSnapshot snapshot() const;
+	static bool writeSnapshot(const IndexSnapshot &snapshot, const QString &database_directory);
+private slots:
+	void onDrainRequested();
+	void onCheckpointFinished();
 public:
 	Indexer(QObject *parent = nullptr);
 	~Indexer();
@@ -38,8 +271,25 @@ public:
 	void clear();
 	void setDatabaseDirectory(const QString &database_directory);
 	void merge(const Indexer &other);
+	QByteArray termKey(const QString &word) const;
+	quint32 termId(const QString &word) const;
+	bool isStopWord(quint32 term_id) const;
+	qsizetype documentFrequency(quint32 term_id) const;
+	quint32 tombstonesNum() const;
+	void enqueueBatch(IndexBatchPointer batch);
+	IndexerQueueStatistics queueStatistics() const;
+	void printQueueStatistics() const;
+	IndexerMemoryUsage memoryUsage() const;
+	void printMemoryUsage() const;
+	IndexStatistics statistics(int top_n=20) const;
+	void printStatistics(int top_n=20) const;
+	bool exportShard(const QString &file_path, const ShardFilter &filter=ShardFilter()) const;
+	bool importShard(const QString &file_path);
 	const PageMetadata *getPageMetadataByContentHash(const QByteArray &content_hash) const;
 	const PageMetadata *getPageMetadataByUrlHash(const QByteArray &url_hash) const;
+	QString pageTitle(const PageMetadata *page) const;
+	QByteArray pageUrl(const PageMetadata *page) const;
+	QDateTime pageTimeStamp(const PageMetadata *page) const;
 	QVector<const PageMetadata *> searchPagesByWords(QStringList words) const;
 	double calculateTfIdfScore(const QByteArray &content_hash, const QStringList &words) const;
 	double calculateTfIdfScore(const PageMetadata *page, const QStringList &words) const;
@@ -47,13 +297,19 @@ public:
 	double calculateTfIdfScore(const PageMetadata *page, const QString &word) const;
 	void sortPagesByTfIdfScore(QVector<const PageMetadata *> &pages, const QStringList &words) const;
 public slots:
-	void addPage(const PageMetadata &page_metadata);
+	void addPage(const PageHeader &page_header, QList<QPair<quint32, quint32>> term_frequencies);
+	bool deletePage(const QByteArray &url_hash);
+	void compact();
 	void addWord(const QString &word);
+	void addBatch(IndexBatchPointer batch);
+	void checkpoint();
 	void save();
 	void load();
 #ifndef NDEBUG
 	void searchTest();
 #endif
+signals:
+	void saved();
 };
 
 #endif // INDEXER_HPP
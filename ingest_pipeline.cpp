@@ -0,0 +1,208 @@
+#include <QDebug>
+#include "main.hpp"
+#include "ingest_pipeline.hpp"
+#include "util.hpp"
+#include "word_tokenizer.hpp"
+
+IngestPipeline::IngestPipeline(RecrawlScheduler *recrawl_scheduler, QObject *parent) : QObject(parent),
+	mExtractQueue(gSettings->ingestQueueCapacity()),
+	mTokenizeQueue(gSettings->ingestQueueCapacity()),
+	mIndexQueue(gSettings->ingestQueueCapacity())
+{
+	mRecrawlScheduler=recrawl_scheduler;
+	mStarted=false;
+}
+
+IngestPipeline::~IngestPipeline()
+{
+	mExtractQueue.close();
+	mTokenizeQueue.close();
+	mIndexQueue.close();
+	for(QThread *worker : mExtractWorkers+mTokenizeWorkers+mIndexWorkers)
+	{
+		worker->wait();
+		delete worker;
+	}
+}
+
+void IngestPipeline::start()
+{
+	if(mStarted)
+	{
+		return;
+	}
+	mStarted=true;
+	mUptime.start();
+	int tokenizeWorkersNum=gSettings->ingestWorkers();
+	mExtractWorkersActive=1;
+	mTokenizeWorkersActive=tokenizeWorkersNum;
+	mExtractWorkers.append(QThread::create([this]() { runExtractStage(); }));
+	for(int i=0; i<tokenizeWorkersNum; i++)
+	{
+		mTokenizeWorkers.append(QThread::create([this]() { runTokenizeStage(); }));
+	}
+	mIndexWorkers.append(QThread::create([this]() { runIndexStage(); }));
+	for(QThread *worker : mExtractWorkers+mTokenizeWorkers+mIndexWorkers)
+	{
+		worker->start();
+	}
+}
+
+void IngestPipeline::finish()
+{
+	if(!mStarted)
+	{
+		emit finished();
+		return;
+	}
+	mExtractQueue.close();
+}
+
+bool IngestPipeline::submit(FetchedPage page)
+{
+	return mExtractQueue.tryPush(std::move(page));
+}
+
+bool IngestPipeline::canAccept() const
+{
+	return !mExtractQueue.isFull();
+}
+
+void IngestPipeline::runExtractStage()
+{
+	FetchedPage page;
+	while(mExtractQueue.pop(page))
+	{
+		ExtractedPage extractedPage;
+		extractedPage.header.title=page.title;
+		extractedPage.header.url=page.url;
+		extractedPage.header.urlHash=page.urlHash;
+		extractedPage.header.timeStamp=page.timeStamp;
+		extractedPage.header.contentHash=hash_function_128(page.text.toUtf8());
+		mPagesExtracted++;
+		if(!mRecrawlScheduler->recordFetch(page.urlHash, QUrl::fromEncoded(page.url), extractedPage.header.contentHash))
+		{
+			mPagesUnchanged++;
+			qDebug() << "Page content has not changed since last visit:" << page.url;
+			continue;
+		}
+		if(!page.indexingAllowed)
+		{
+			continue;
+		}
+		extractedPage.text=std::move(page.text);
+		mTokenizeQueue.push(std::move(extractedPage));
+	}
+	if(mExtractWorkersActive.fetchAndSubOrdered(1)==1)
+	{
+		mTokenizeQueue.close();
+	}
+}
+
+void IngestPipeline::runTokenizeStage()
+{
+	ExtractedPage page;
+	WordCounter wordCounter;
+	int stemmingLanguages=gSettings->stemmingLanguageFlags();
+	while(mTokenizeQueue.pop(page))
+	{
+		TokenizedPage tokenizedPage;
+		tokenizedPage.page.header=std::move(page.header);
+		wordCounter.clear();
+		count_words(reinterpret_cast<const char16_t *>(page.text.utf16()), page.text.size(), wordCounter, stemmingLanguages);
+		tokenizedPage.page.terms.reserve(wordCounter.size());
+		tokenizedPage.terms.reserve(wordCounter.size());
+		tokenizedPage.termArena=QByteArray((const char *)wordCounter.arena().data(), wordCounter.arena().size());
+		for(const WordCount &pageWord : wordCounter.entries())
+		{
+			tokenizedPage.page.terms.append({(quint32)tokenizedPage.terms.size(), (quint32)pageWord.count});
+			tokenizedPage.terms.append({pageWord.hash, pageWord.offset, pageWord.length, pageWord.surfaceOffset, pageWord.surfaceLength});
+		}
+		mPagesTokenized++;
+		if(!tokenizedPage.page.terms.isEmpty())
+		{
+			mIndexQueue.push(std::move(tokenizedPage));
+		}
+	}
+	if(mTokenizeWorkersActive.fetchAndSubOrdered(1)==1)
+	{
+		mIndexQueue.close();
+	}
+}
+
+void IngestPipeline::runIndexStage()
+{
+	TokenizedPage page;
+	QSharedPointer<IndexBatch> batch;
+	qsizetype batchPagesMax=gSettings->indexBatchPages();
+	while(mIndexQueue.pop(page))
+	{
+		if(batch.isNull())
+		{
+			batch=QSharedPointer<IndexBatch>::create();
+			batch->pages.reserve(batchPagesMax);
+			mBatchAllocations+=2;
+		}
+		quint32 termBase=batch->terms.size();
+		quint32 arenaBase=batch->termArena.size();
+		// Buffer growths are counted as allocations; pages' own term lists
+		// move into the batch without one.
+		qsizetype arenaCapacity=batch->termArena.capacity();
+		qsizetype termsCapacity=batch->terms.capacity();
+		batch->termArena.append(page.termArena);
+		for(IndexBatchTermText termText : std::as_const(page.terms))
+		{
+			termText.offset+=arenaBase;
+			termText.surfaceOffset+=arenaBase;
+			batch->terms.append(termText);
+		}
+		mBatchAllocations+=int(batch->termArena.capacity()!=arenaCapacity)+int(batch->terms.capacity()!=termsCapacity);
+		for(IndexBatchTerm &term : page.page.terms)
+		{
+			term.term+=termBase;
+		}
+		batch->pages.append(std::move(page.page));
+		mPagesIndexed++;
+		if(batch->pages.size()>=batchPagesMax || mIndexQueue.size()==0)
+		{
+			emit needToIndexBatch(batch);
+			mBatchesEmitted++;
+			batch.reset();
+		}
+	}
+	if(!batch.isNull())
+	{
+		emit needToIndexBatch(batch);
+		mBatchesEmitted++;
+	}
+	emit finished();
+}
+
+QList<IngestStageStatistics> IngestPipeline::statistics() const
+{
+	QList<IngestStageStatistics> stageStatistics;
+	double uptime=mUptime.isValid() ? qMax((qint64)1, mUptime.elapsed())/1000.0 : 1.0;
+	quint64 pagesExtracted=mPagesExtracted.loadRelaxed();
+	quint64 pagesTokenized=mPagesTokenized.loadRelaxed();
+	quint64 pagesIndexed=mPagesIndexed.loadRelaxed();
+	stageStatistics.append({"extract", mExtractQueue.size(), mExtractQueue.capacity(), pagesExtracted, pagesExtracted/uptime});
+	stageStatistics.append({"tokenize", mTokenizeQueue.size(), mTokenizeQueue.capacity(), pagesTokenized, pagesTokenized/uptime});
+	stageStatistics.append({"index", mIndexQueue.size(), mIndexQueue.capacity(), pagesIndexed, pagesIndexed/uptime});
+	return stageStatistics;
+}
+
+void IngestPipeline::printStatistics() const
+{
+	const QList<IngestStageStatistics> stageStatistics=statistics();
+	for(const IngestStageStatistics &stage : stageStatistics)
+	{
+		qInfo() << "Ingest stage" << stage.name << "- queue:" << stage.queueDepth << "/" << stage.queueCapacity <<
+			"processed:" << stage.itemsProcessed << "throughput:" << stage.itemsPerSecond << "pages/s";
+	}
+	qInfo() << "Pages skipped as unchanged:" << mPagesUnchanged.loadRelaxed();
+	quint64 batchesEmitted=mBatchesEmitted.loadRelaxed();
+	double uptime=mUptime.isValid() ? qMax((qint64)1, mUptime.elapsed())/1000.0 : 1.0;
+	qInfo() << "Index batches emitted:" << batchesEmitted << "(" << batchesEmitted/uptime << "events/s," <<
+		(batchesEmitted ? double(mPagesIndexed.loadRelaxed())/batchesEmitted : 0.0) << "pages per batch," <<
+		(batchesEmitted ? double(mBatchAllocations.loadRelaxed())/batchesEmitted : 0.0) << "allocations per batch)";
+}
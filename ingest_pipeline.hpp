@@ -0,0 +1,83 @@
+#ifndef INGEST_PIPELINE_HPP
+#define INGEST_PIPELINE_HPP
+
+#include <QObject>
+#include <QDateTime>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include "bounded_queue.hpp"
+#include "indexer.hpp"
+#include "recrawl_scheduler.hpp"
+
+struct FetchedPage
+{
+	QString text;
+	QString title;
+	QByteArray url;
+	QByteArray urlHash;
+	QDateTime timeStamp;
+	bool indexingAllowed;
+};
+
+struct ExtractedPage
+{
+	QString text;
+	PageHeader header;
+};
+
+struct TokenizedPage
+{
+	IndexBatchPage page;
+	QByteArray termArena;
+	QList<IndexBatchTermText> terms;
+};
+
+struct IngestStageStatistics
+{
+	QString name;
+	qsizetype queueDepth;
+	qsizetype queueCapacity;
+	quint64 itemsProcessed;
+	double itemsPerSecond;
+};
+
+class IngestPipeline : public QObject
+{
+	Q_OBJECT
+	RecrawlScheduler *mRecrawlScheduler;
+	BoundedQueue<FetchedPage> mExtractQueue;
+	BoundedQueue<ExtractedPage> mTokenizeQueue;
+	BoundedQueue<TokenizedPage> mIndexQueue;
+	QList<QThread *> mExtractWorkers;
+	QList<QThread *> mTokenizeWorkers;
+	QList<QThread *> mIndexWorkers;
+	QAtomicInt mExtractWorkersActive;
+	QAtomicInt mTokenizeWorkersActive;
+	QAtomicInteger<quint64> mPagesExtracted;
+	QAtomicInteger<quint64> mPagesTokenized;
+	QAtomicInteger<quint64> mPagesIndexed;
+	QAtomicInteger<quint64> mPagesUnchanged;
+	QAtomicInteger<quint64> mBatchesEmitted;
+	QAtomicInteger<quint64> mBatchAllocations;
+	QElapsedTimer mUptime;
+	bool mStarted;
+	void runExtractStage();
+	void runTokenizeStage();
+	void runIndexStage();
+public:
+	IngestPipeline(RecrawlScheduler *recrawl_scheduler, QObject *parent=nullptr);
+	~IngestPipeline();
+	void start();
+	void finish();
+	bool submit(FetchedPage page);
+	bool canAccept() const;
+	QList<IngestStageStatistics> statistics() const;
+	void printStatistics() const;
+signals:
+	void needToIndexBatch(IndexBatchPointer batch);
+	void finished();
+};
+
+#endif // INGEST_PIPELINE_HPP
@@ -1,7 +1,9 @@
 #include <QApplication>
 #include <QTimer>
+#include <QThread>
 #include "main.hpp"
 #include "crawler.hpp"
+#include "peer_query.hpp"
 
 ConfigurationKeeper *gSettings;
 
@@ -14,16 +16,25 @@ int main(int argc, char **argv)
 
 	Crawler *myCrawler=new Crawler;
 	Indexer *myIndexer=new Indexer;
+	QThread *indexerThread=new QThread;
+	indexerThread->setObjectName("indexer");
+	myIndexer->moveToThread(indexerThread);
+	PeerQueryServer *peerServer=new PeerQueryServer(myIndexer);
+	peerServer->moveToThread(indexerThread);
+	indexerThread->start();
 
-	QObject::connect(myCrawler, &Crawler::needToAddPage, myIndexer, &Indexer::addPage);
-	QObject::connect(myCrawler, &Crawler::needToAddWord, myIndexer, &Indexer::addWord);
+	QObject::connect(myCrawler, &Crawler::needToIndexBatch, myIndexer, &Indexer::enqueueBatch, Qt::DirectConnection);
 	QObject::connect(myCrawler, &Crawler::finished, myIndexer, &Indexer::save);
 	// QObject::connect(myCrawler, &Crawler::finished, myIndexer, &Indexer::searchTest);
-	QObject::connect(myCrawler, &Crawler::finished, &fossenApp, &QCoreApplication::quit);
+	QObject::connect(myIndexer, &Indexer::saved, &fossenApp, &QCoreApplication::quit);
 
 	QTimer::singleShot(0, myIndexer, &Indexer::load);
+	QTimer::singleShot(0, peerServer, &PeerQueryServer::start);
 	// QTimer::singleShot(0, myIndexer, &Indexer::searchTest);
 	QTimer::singleShot(0, myCrawler, &Crawler::start);
 
-	return(fossenApp.exec());
+	int result=fossenApp.exec();
+	indexerThread->quit();
+	indexerThread->wait();
+	return(result);
 }
@@ -0,0 +1,93 @@
+#ifndef MPSC_QUEUE_HPP
+#define MPSC_QUEUE_HPP
+
+#include <atomic>
+
+// Unbounded lock-free multi-producer single-consumer queue (Vyukov's
+// intrusive MPSC list with a stub node). push() may be called from any
+// thread; pop() only from the single consumer. pop() may transiently return
+// false while a producer is between its two steps; the consumer is expected
+// to be woken again by that producer.
+template<typename T>
+class MpscQueue
+{
+	struct Node
+	{
+		std::atomic<Node *> next;
+		T value;
+	};
+	alignas(64) std::atomic<Node *> mHead;
+	alignas(64) Node *mTail;
+	Node mStub;
+
+	void pushNode(Node *node)
+	{
+		node->next.store(nullptr, std::memory_order_relaxed);
+		Node *previous=mHead.exchange(node, std::memory_order_acq_rel);
+		previous->next.store(node, std::memory_order_release);
+	}
+public:
+	MpscQueue()
+	{
+		mStub.next.store(nullptr, std::memory_order_relaxed);
+		mHead.store(&mStub, std::memory_order_relaxed);
+		mTail=&mStub;
+	}
+
+	~MpscQueue()
+	{
+		T value;
+		while(pop(value))
+		{
+		}
+	}
+
+	MpscQueue(const MpscQueue &)=delete;
+	MpscQueue &operator=(const MpscQueue &)=delete;
+
+	void push(T value)
+	{
+		Node *node=new Node;
+		node->value=std::move(value);
+		pushNode(node);
+	}
+
+	bool pop(T &value)
+	{
+		Node *tail=mTail;
+		Node *next=tail->next.load(std::memory_order_acquire);
+		if(tail==&mStub)
+		{
+			if(nullptr==next)
+			{
+				return false;
+			}
+			mTail=next;
+			tail=next;
+			next=next->next.load(std::memory_order_acquire);
+		}
+		if(nullptr!=next)
+		{
+			mTail=next;
+			value=std::move(tail->value);
+			delete tail;
+			return true;
+		}
+		if(tail!=mHead.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+		pushNode(&mStub);
+		next=tail->next.load(std::memory_order_acquire);
+		if(nullptr!=next)
+		{
+			mTail=next;
+			value=std::move(tail->value);
+			delete tail;
+			return true;
+		}
+		return false;
+	}
+};
+
+#endif // MPSC_QUEUE_HPP
@@ -0,0 +1,108 @@
+#include <QtAlgorithms>
+#include <cmath>
+#include "near_duplicate_index.hpp"
+
+static inline uint64_t mix_64(uint64_t value)
+{
+	value^=value>>30;
+	value*=0xBF58476D1CE4E5B9;
+	value^=value>>27;
+	value*=0x94D049BB133111EB;
+	value^=value>>31;
+	return value;
+}
+
+uint64_t simhash_64(const QList<QPair<quint32, quint32>> &weighted_features)
+{
+	double accumulator[64]={0.0};
+	for(const QPair<quint32, quint32> &feature : weighted_features)
+	{
+		if(feature.second==0)
+		{
+			continue;
+		}
+		uint64_t featureHash=mix_64(feature.first);
+		double weight=1.0+std::log((double)feature.second);
+		for(int bit=0; bit<64; bit++)
+		{
+			if((featureHash>>bit) & 1)
+			{
+				accumulator[bit]+=weight;
+			}
+			else
+			{
+				accumulator[bit]-=weight;
+			}
+		}
+	}
+	uint64_t result=0;
+	for(int bit=0; bit<64; bit++)
+	{
+		if(accumulator[bit]>0.0)
+		{
+			result|=(uint64_t)1<<bit;
+		}
+	}
+	return result;
+}
+
+quint32 NearDuplicateIndex::tableKey(int block, quint64 sim_hash)
+{
+	quint32 blockValue=(sim_hash>>(block*BLOCK_BITS)) & ((1u<<BLOCK_BITS)-1);
+	return ((quint32)block<<BLOCK_BITS) | blockValue;
+}
+
+void NearDuplicateIndex::insert(quint64 sim_hash, const QByteArray &content_hash)
+{
+	for(int block=0; block<BLOCKS_NUM; block++)
+	{
+		mTables[tableKey(block, sim_hash)].append({sim_hash, content_hash});
+	}
+}
+
+void NearDuplicateIndex::remove(quint64 sim_hash, const QByteArray &content_hash)
+{
+	for(int block=0; block<BLOCKS_NUM; block++)
+	{
+		QHash<quint32, QList<Entry>>::iterator bucketIt=mTables.find(tableKey(block, sim_hash));
+		if(bucketIt==mTables.end())
+		{
+			continue;
+		}
+		bucketIt->removeIf([&content_hash](const Entry &entry) { return entry.contentHash==content_hash; });
+		if(bucketIt->isEmpty())
+		{
+			mTables.erase(bucketIt);
+		}
+	}
+}
+
+void NearDuplicateIndex::clear()
+{
+	mTables.clear();
+}
+
+QByteArray NearDuplicateIndex::findNearDuplicate(quint64 sim_hash, int max_distance, const QByteArray &exclude_content_hash) const
+{
+	if(max_distance<0)
+	{
+		return QByteArray();
+	}
+	max_distance=qMin(max_distance, DISTANCE_MAX);
+	for(int block=0; block<BLOCKS_NUM; block++)
+	{
+		QHash<quint32, QList<Entry>>::const_iterator bucketIt=mTables.constFind(tableKey(block, sim_hash));
+		if(bucketIt==mTables.constEnd())
+		{
+			continue;
+		}
+		for(const Entry &entry : bucketIt.value())
+		{
+			if(qPopulationCount(entry.simHash ^ sim_hash)<=(uint)max_distance && entry.contentHash!=exclude_content_hash)
+			{
+				return entry.contentHash;
+			}
+		}
+	}
+	return QByteArray();
+}
@@ -0,0 +1,33 @@
+#ifndef NEAR_DUPLICATE_INDEX_HPP
+#define NEAR_DUPLICATE_INDEX_HPP
+
+#include <QHash>
+#include <QList>
+#include <QByteArray>
+
+uint64_t simhash_64(const QList<QPair<quint32, quint32>> &weighted_features);
+
+// Permuted-bit-table index over 64-bit SimHash fingerprints. The fingerprint
+// is split into BLOCKS_NUM blocks; two fingerprints within Hamming distance
+// BLOCKS_NUM-1 share at least one block exactly, so only the candidates
+// bucketed under one of the query blocks have to be compared.
+class NearDuplicateIndex
+{
+	static constexpr int BLOCKS_NUM=4;
+	static constexpr int BLOCK_BITS=64/BLOCKS_NUM;
+	struct Entry
+	{
+		quint64 simHash;
+		QByteArray contentHash;
+	};
+	QHash<quint32, QList<Entry>> mTables;
+	static quint32 tableKey(int block, quint64 sim_hash);
+public:
+	static constexpr int DISTANCE_MAX=BLOCKS_NUM-1;
+	void insert(quint64 sim_hash, const QByteArray &content_hash);
+	void remove(quint64 sim_hash, const QByteArray &content_hash);
+	void clear();
+	QByteArray findNearDuplicate(quint64 sim_hash, int max_distance, const QByteArray &exclude_content_hash=QByteArray()) const;
+};
+
+#endif // NEAR_DUPLICATE_INDEX_HPP
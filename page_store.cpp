@@ -0,0 +1,234 @@
+#include "page_store.hpp"
+#include "util.hpp"
+
+PageStore::PageStore(int cache_blocks) : mCache(cache_blocks)
+{
+	clear();
+}
+
+void PageStore::clear()
+{
+	mBlocks.clear();
+	mOpenBlock.clear();
+	mOpenBlockRecords=0;
+	mCompressedBytes=0;
+	mRawBytes=0;
+	mCache.clear();
+	mCacheHits=0;
+	mCacheMisses=0;
+}
+
+void PageStore::setCacheBlocks(int cache_blocks)
+{
+	mCache.setMaxCost(cache_blocks);
+}
+
+quint32 PageStore::size() const
+{
+	return mBlocks.size()*BLOCK_RECORDS+mOpenBlockRecords;
+}
+
+quint32 PageStore::append(const QString &title, const QByteArray &url, qint64 time_stamp)
+{
+	quint32 docId=size();
+	const QByteArray titleUtf8=title.toUtf8();
+	qsizetype openBlockSize=mOpenBlock.size();
+	varint_append(mOpenBlock, titleUtf8.size());
+	mOpenBlock.append(titleUtf8);
+	varint_append(mOpenBlock, url.size());
+	mOpenBlock.append(url);
+	varint_append(mOpenBlock, time_stamp);
+	mRawBytes+=mOpenBlock.size()-openBlockSize;
+	mOpenBlockRecords++;
+	if(mOpenBlockRecords==BLOCK_RECORDS)
+	{
+		mBlocks.append(qCompress(mOpenBlock));
+		mCompressedBytes+=mBlocks.last().size();
+		mOpenBlock.clear();
+		mOpenBlockRecords=0;
+	}
+	return docId;
+}
+
+QList<PageRecord> PageStore::decodeBlock(const QByteArray &block)
+{
+	QList<PageRecord> records;
+	records.reserve(BLOCK_RECORDS);
+	const char *data=block.constData();
+	const char *end=data+block.size();
+	quint64 titleLength, urlLength, timeStamp;
+	while(data<end)
+	{
+		if(!varint_read(data, end, titleLength) || titleLength>(quint64)(end-data))
+		{
+			break;
+		}
+		PageRecord record;
+		record.title=QString::fromUtf8(data, titleLength);
+		data+=titleLength;
+		if(!varint_read(data, end, urlLength) || urlLength>(quint64)(end-data))
+		{
+			break;
+		}
+		record.url=QByteArray(data, urlLength);
+		data+=urlLength;
+		if(!varint_read(data, end, timeStamp))
+		{
+			break;
+		}
+		record.timeStamp=timeStamp;
+		records.append(record);
+	}
+	return records;
+}
+
+PageRecord PageStore::record(quint32 doc_id) const
+{
+	quint32 block=doc_id/BLOCK_RECORDS;
+	quint32 index=doc_id%BLOCK_RECORDS;
+	if(block>=(quint32)mBlocks.size())
+	{
+		if(block>(quint32)mBlocks.size() || index>=mOpenBlockRecords)
+		{
+			return PageRecord();
+		}
+		return decodeBlock(mOpenBlock).value(index);
+	}
+	const QList<PageRecord> *records=mCache.object(block);
+	if(nullptr!=records)
+	{
+		mCacheHits++;
+		return records->value(index);
+	}
+	mCacheMisses++;
+	QList<PageRecord> *decodedRecords=new QList<PageRecord>(decodeBlock(qUncompress(mBlocks.at(block))));
+	PageRecord result=decodedRecords->value(index);
+	mCache.insert(block, decodedRecords);
+	return result;
+}
+
+// Rewrites the store with only the given records; the record of doc_ids[i]
+// becomes doc ID i. Ascending doc IDs decode every block once.
+void PageStore::retain(const QList<quint32> &doc_ids)
+{
+	PageStore retained(1);
+	for(quint32 docId : doc_ids)
+	{
+		PageRecord pageRecord=record(docId);
+		retained.append(pageRecord.title, pageRecord.url, pageRecord.timeStamp);
+	}
+	mBlocks=std::move(retained.mBlocks);
+	mOpenBlock=std::move(retained.mOpenBlock);
+	mOpenBlockRecords=retained.mOpenBlockRecords;
+	mCompressedBytes=retained.mCompressedBytes;
+	mRawBytes=retained.mRawBytes;
+	mCache.clear();
+}
+
+// Decodes a whole block, the open one being blocksNum(), without going
+// through the cache, so blocks can be scanned from several threads.
+QList<PageRecord> PageStore::blockRecords(qsizetype block) const
+{
+	if(block==mBlocks.size())
+	{
+		return decodeBlock(mOpenBlock);
+	}
+	if(block<0 || block>mBlocks.size())
+	{
+		return QList<PageRecord>();
+	}
+	return decodeBlock(qUncompress(mBlocks.at(block)));
+}
+
+qsizetype PageStore::sizeInBytes() const
+{
+	return mCompressedBytes+mBlocks.capacity()*sizeof(QByteArray)+mOpenBlock.capacity()+cacheSizeInBytes();
+}
+
+qsizetype PageStore::cacheSizeInBytes() const
+{
+	qsizetype recordBytes=size() ? mRawBytes/size() : 0;
+	return mCache.size()*BLOCK_RECORDS*(sizeof(PageRecord)+32+2*recordBytes);
+}
+
+void PageStore::evictCache()
+{
+	mCache.clear();
+}
+
+qsizetype PageStore::rawBytes() const
+{
+	return mRawBytes;
+}
+
+qsizetype PageStore::compressedBytes() const
+{
+	return mCompressedBytes+mOpenBlock.size();
+}
+
+qsizetype PageStore::blocksNum() const
+{
+	return mBlocks.size();
+}
+
+quint64 PageStore::cacheHits() const
+{
+	return mCacheHits;
+}
+
+quint64 PageStore::cacheMisses() const
+{
+	return mCacheMisses;
+}
+
+PageStore::Snapshot PageStore::snapshot() const
+{
+	Snapshot snapshot;
+	snapshot.blocks=mBlocks;
+	snapshot.openBlock=mOpenBlock;
+	snapshot.openBlockRecords=mOpenBlockRecords;
+	snapshot.rawBytes=mRawBytes;
+	return snapshot;
+}
+
+quint32 PageStore::Snapshot::size() const
+{
+	return blocks.size()*BLOCK_RECORDS+openBlockRecords;
+}
+
+void PageStore::Snapshot::writeToStream(QDataStream &stream) const
+{
+	stream << BLOCK_RECORDS;
+	stream << blocks;
+	stream << openBlock;
+	stream << openBlockRecords;
+	stream << rawBytes;
+}
+
+void PageStore::writeToStream(QDataStream &stream) const
+{
+	snapshot().writeToStream(stream);
+}
+
+bool PageStore::readFromStream(QDataStream &stream)
+{
+	quint32 blockRecords;
+	qint64 rawBytes;
+	clear();
+	stream >> blockRecords;
+	stream >> mBlocks;
+	stream >> mOpenBlock;
+	stream >> mOpenBlockRecords;
+	stream >> rawBytes;
+	if(stream.status()!=QDataStream::Ok || blockRecords!=BLOCK_RECORDS || mOpenBlockRecords>=BLOCK_RECORDS)
+	{
+		clear();
+		return false;
+	}
+	mRawBytes=rawBytes;
+	for(const QByteArray &block : std::as_const(mBlocks))
+	{
+		mCompressedBytes+=block.size();
+	}
+	return true;
+}
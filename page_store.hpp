@@ -0,0 +1,66 @@
+#ifndef PAGE_STORE_HPP
+#define PAGE_STORE_HPP
+
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QCache>
+#include <QDataStream>
+
+struct PageRecord
+{
+	QString title;
+	QByteArray url;
+	qint64 timeStamp;
+};
+
+// Titles, URLs and timestamps addressed by doc ID. Records are appended to an
+// open block; every BLOCK_RECORDS records the block is compressed and sealed.
+// Sealed blocks are only decompressed when one of their records is asked
+// for, and the decoded blocks are kept in a small LRU cache.
+class PageStore
+{
+	QList<QByteArray> mBlocks;
+	QByteArray mOpenBlock;
+	quint32 mOpenBlockRecords;
+	qsizetype mCompressedBytes;
+	qsizetype mRawBytes;
+	mutable QCache<quint32, QList<PageRecord>> mCache;
+	mutable quint64 mCacheHits;
+	mutable quint64 mCacheMisses;
+	static QList<PageRecord> decodeBlock(const QByteArray &block);
+public:
+	static constexpr quint32 BLOCK_RECORDS=64;
+	// Blocks are implicitly shared, so a snapshot is cheap to take and stays
+	// valid while records keep being appended to the store.
+	struct Snapshot
+	{
+		QList<QByteArray> blocks;
+		QByteArray openBlock;
+		quint32 openBlockRecords;
+		qint64 rawBytes;
+		quint32 size() const;
+		void writeToStream(QDataStream &stream) const;
+	};
+	PageStore(int cache_blocks=32);
+	void clear();
+	void setCacheBlocks(int cache_blocks);
+	quint32 size() const;
+	quint32 append(const QString &title, const QByteArray &url, qint64 time_stamp);
+	PageRecord record(quint32 doc_id) const;
+	void retain(const QList<quint32> &doc_ids);
+	QList<PageRecord> blockRecords(qsizetype block) const;
+	qsizetype sizeInBytes() const;
+	qsizetype cacheSizeInBytes() const;
+	void evictCache();
+	qsizetype rawBytes() const;
+	qsizetype compressedBytes() const;
+	qsizetype blocksNum() const;
+	quint64 cacheHits() const;
+	quint64 cacheMisses() const;
+	Snapshot snapshot() const;
+	void writeToStream(QDataStream &stream) const;
+	bool readFromStream(QDataStream &stream);
+};
+
+#endif // PAGE_STORE_HPP
@@ -0,0 +1,123 @@
+#include <QCoreApplication>
+#include <QSocketNotifier>
+#include <QFile>
+#include <QDebug>
+#include "main.hpp"
+#include "indexer.hpp"
+#include "peer_query.hpp"
+#include "util.hpp"
+
+ConfigurationKeeper *gSettings;
+
+static int usage()
+{
+	qWarning() << "Usage: seeklet-peer serve [--port PORT] [database_directory]";
+	qWarning() << "       seeklet-peer query [--k K] [--deadline MS] [--peer HOST:PORT]... [--local database_directory] word...";
+	qWarning() << "Peers from crawler.json are queried as well. A serving node announces itself to them and fans out";
+	qWarning() << "every line of words read from standard input to them and to the peers that announced themselves.";
+	return 2;
+}
+
+static void print_results(const PeerQuery &query)
+{
+	for(const PeerQueryResult &result : query.results())
+	{
+		qInfo().noquote() << QString::number(result.score, 'f', 4) << (result.peer.isEmpty() ? QString("local") : result.peer) <<
+			QString::fromUtf8(result.url) << result.title;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	QCoreApplication peerApp(argc, argv);
+	gSettings=new ConfigurationKeeper();
+	gSettings->loadSettingsFromJsonFile("crawler.json");
+
+	QStringList arguments=peerApp.arguments().mid(1);
+	if(arguments.isEmpty() || (arguments.first()!="serve" && arguments.first()!="query"))
+	{
+		return usage();
+	}
+	if(arguments.takeFirst()=="serve")
+	{
+		int port=gSettings->peerPort();
+		if(!take_number_option(arguments, "--port", port) || port>65535 || arguments.size()>1 ||
+			(arguments.size()==1 && arguments.first().startsWith("-")))
+		{
+			return usage();
+		}
+		Indexer indexer;
+		if(!arguments.isEmpty())
+		{
+			indexer.setDatabaseDirectory(arguments.first());
+		}
+		indexer.load();
+		PeerQueryServer server(&indexer);
+		QObject::connect(&server, &PeerQueryServer::peerDiscovered, [](const QString &peer)
+			{
+				qInfo() << "Discovered peer" << peer;
+			});
+		if(!server.listen(port))
+		{
+			return 1;
+		}
+		server.announce();
+		QFile input;
+		input.open(stdin, QIODevice::ReadOnly);
+		QSocketNotifier inputNotifier(input.handle(), QSocketNotifier::Read);
+		QObject::connect(&inputNotifier, &QSocketNotifier::activated, [&input, &inputNotifier, &server]()
+			{
+				QByteArray line=input.readLine();
+				if(line.isEmpty())
+				{
+					// End of input, keep serving.
+					inputNotifier.setEnabled(false);
+					return;
+				}
+				QStringList words=QString::fromUtf8(line).split(' ', Qt::SkipEmptyParts);
+				for(QString &word : words)
+				{
+					word=word.trimmed();
+				}
+				words.removeAll(QString());
+				if(words.isEmpty())
+				{
+					return;
+				}
+				PeerQuery *query=server.createQuery(words, 10, gSettings->peerQueryDeadline());
+				QObject::connect(query, &PeerQuery::finished, query, [query]()
+					{
+						print_results(*query);
+						query->deleteLater();
+					});
+				query->start(server.peers());
+			});
+		return peerApp.exec();
+	}
+
+	int k=10;
+	int deadline=gSettings->peerQueryDeadline();
+	QStringList peers=gSettings->peers();
+	QString localDirectory;
+	if(!take_number_option(arguments, "--k", k) || !take_number_option(arguments, "--deadline", deadline) ||
+		!take_options(arguments, "--peer", peers) || !take_option(arguments, "--local", localDirectory) || arguments.isEmpty())
+	{
+		return usage();
+	}
+	Indexer indexer;
+	PeerQuery query(arguments, k, deadline);
+	query.setSenderPort(gSettings->peerPort());
+	if(!localDirectory.isEmpty())
+	{
+		indexer.setDatabaseDirectory(localDirectory);
+		indexer.load();
+		query.addLocalResults(&indexer);
+	}
+	QObject::connect(&query, &PeerQuery::finished, &peerApp, [&query, &peerApp]()
+		{
+			print_results(query);
+			peerApp.quit();
+		}, Qt::QueuedConnection);
+	query.start(peers);
+	return peerApp.exec();
+}
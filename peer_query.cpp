@@ -0,0 +1,553 @@
+#include <algorithm>
+#include <cstring>
+#include <QtEndian>
+#include <QRandomGenerator>
+#include <QDebug>
+#include "main.hpp"
+#include "peer_query.hpp"
+#include "indexer.hpp"
+#include "util.hpp"
+
+static constexpr quint32 PEER_FRAME_MAX=4*1024*1024;
+static constexpr quint64 PEER_RESULTS_MAX=1000;
+static constexpr quint64 PEER_WORDS_MAX=64;
+static constexpr quint64 PEER_DEADLINE_MAX=60*1000;
+static constexpr qsizetype PEER_HASH_SIZE=16;
+
+static void append_string(QByteArray &out, const QByteArray &string)
+{
+	varint_append(out, string.size());
+	out.append(string);
+}
+
+static bool read_string(const char *&data, const char *end, QByteArray &string)
+{
+	quint64 length;
+	if(!varint_read(data, end, length) || length>quint64(end-data))
+	{
+		return false;
+	}
+	string=QByteArray(data, length);
+	data+=length;
+	return true;
+}
+
+static bool decode_message(const char *data, const char *end, PeerQueryMessage &message)
+{
+	message.type=quint8(*data++);
+	message.queryId=qFromLittleEndian<quint32>(data);
+	data+=sizeof(quint32);
+	if(message.type==PEER_MESSAGE_QUERY)
+	{
+		quint64 k, deadline, senderPort, wordsNum;
+		if(data>=end || quint8(*data++)!=PEER_PROTOCOL_VERSION || !varint_read(data, end, k) || !varint_read(data, end, deadline) ||
+			!varint_read(data, end, senderPort) || !varint_read(data, end, wordsNum))
+		{
+			return false;
+		}
+		if(k==0 || k>PEER_RESULTS_MAX || deadline>PEER_DEADLINE_MAX || senderPort>65535 || wordsNum>PEER_WORDS_MAX)
+		{
+			return false;
+		}
+		message.k=k;
+		message.deadline=deadline;
+		message.senderPort=senderPort;
+		QByteArray word;
+		for(quint64 wordIndex=0; wordIndex<wordsNum; wordIndex++)
+		{
+			if(!read_string(data, end, word))
+			{
+				return false;
+			}
+			message.words.append(QString::fromUtf8(word));
+		}
+	}
+	else if(message.type==PEER_MESSAGE_RESULTS)
+	{
+		quint64 resultsNum;
+		if(!varint_read(data, end, resultsNum) || resultsNum>PEER_RESULTS_MAX)
+		{
+			return false;
+		}
+		QByteArray title;
+		for(quint64 resultIndex=0; resultIndex<resultsNum; resultIndex++)
+		{
+			if(end-data<qsizetype(sizeof(quint64))+2*PEER_HASH_SIZE)
+			{
+				return false;
+			}
+			PeerQueryResult result;
+			quint64 scoreBits=qFromLittleEndian<quint64>(data);
+			memcpy(&result.score, &scoreBits, sizeof(result.score));
+			data+=sizeof(quint64);
+			result.urlHash=QByteArray(data, PEER_HASH_SIZE);
+			data+=PEER_HASH_SIZE;
+			result.contentHash=QByteArray(data, PEER_HASH_SIZE);
+			data+=PEER_HASH_SIZE;
+			if(!qIsFinite(result.score) || !read_string(data, end, result.url) || !read_string(data, end, title))
+			{
+				return false;
+			}
+			result.title=QString::fromUtf8(title);
+			message.results.append(result);
+		}
+	}
+	else
+	{
+		return false;
+	}
+	return data==end;
+}
+
+QByteArray peer_query_encode(const PeerQueryMessage &message)
+{
+	QByteArray frame(sizeof(quint32), '\0');
+	char number[sizeof(quint64)];
+	frame.append(char(message.type));
+	qToLittleEndian<quint32>(message.queryId, number);
+	frame.append(number, sizeof(quint32));
+	if(message.type==PEER_MESSAGE_QUERY)
+	{
+		frame.append(char(PEER_PROTOCOL_VERSION));
+		varint_append(frame, message.k);
+		varint_append(frame, message.deadline);
+		varint_append(frame, message.senderPort);
+		varint_append(frame, message.words.size());
+		for(const QString &word : message.words)
+		{
+			append_string(frame, word.toUtf8());
+		}
+	}
+	else
+	{
+		varint_append(frame, message.results.size());
+		for(const PeerQueryResult &result : message.results)
+		{
+			quint64 scoreBits;
+			memcpy(&scoreBits, &result.score, sizeof(scoreBits));
+			qToLittleEndian<quint64>(scoreBits, number);
+			frame.append(number, sizeof(quint64));
+			frame.append(result.urlHash.leftJustified(PEER_HASH_SIZE, '\0', true));
+			frame.append(result.contentHash.leftJustified(PEER_HASH_SIZE, '\0', true));
+			append_string(frame, result.url);
+			append_string(frame, result.title.toUtf8());
+		}
+	}
+	qToLittleEndian<quint32>(frame.size()-sizeof(quint32), frame.data());
+	return frame;
+}
+
+bool peer_query_decode(QByteArray &buffer, QList<PeerQueryMessage> &messages)
+{
+	static constexpr qsizetype MESSAGE_HEADER_SIZE=1+sizeof(quint32);
+	qsizetype offset=0;
+	bool valid=true;
+	while(buffer.size()-offset>=qsizetype(sizeof(quint32)))
+	{
+		quint32 length=qFromLittleEndian<quint32>(buffer.constData()+offset);
+		if(length<MESSAGE_HEADER_SIZE || length>PEER_FRAME_MAX)
+		{
+			valid=false;
+			break;
+		}
+		if(buffer.size()-offset-qsizetype(sizeof(quint32))<length)
+		{
+			break;
+		}
+		const char *data=buffer.constData()+offset+sizeof(quint32);
+		PeerQueryMessage message;
+		if(!decode_message(data, data+length, message))
+		{
+			valid=false;
+			break;
+		}
+		messages.append(message);
+		offset+=sizeof(quint32)+length;
+	}
+	buffer.remove(0, offset);
+	return valid;
+}
+
+QList<PeerQueryResult> peer_query_local_results(const Indexer *indexer, const QStringList &words, int k)
+{
+	const QVector<const PageMetadata *> pages=indexer->searchPagesByWords(words);
+	QList<QPair<double, const PageMetadata *>> scoredPages;
+	scoredPages.reserve(pages.size());
+	for(const PageMetadata *page : pages)
+	{
+		scoredPages.append(qMakePair(indexer->calculateTfIdfScore(page, words), page));
+	}
+	qsizetype resultsNum=qMin(scoredPages.size(), qsizetype(qMax(k, 0)));
+	std::partial_sort(scoredPages.begin(), scoredPages.begin()+resultsNum, scoredPages.end(),
+		[](const QPair<double, const PageMetadata *> &a, const QPair<double, const PageMetadata *> &b)
+		{
+			return a.first>b.first;
+		});
+	QList<PeerQueryResult> results;
+	results.reserve(resultsNum);
+	for(qsizetype result=0; result<resultsNum; result++)
+	{
+		const PageMetadata *page=scoredPages.at(result).second;
+		results.append(PeerQueryResult{scoredPages.at(result).first, page->urlHashBytes(), page->contentHashBytes(),
+			indexer->pageUrl(page), indexer->pageTitle(page), QString()});
+	}
+	return results;
+}
+
+static QString peer_address(const QHostAddress &address, quint16 port)
+{
+	bool isIPv4=false;
+	QHostAddress ipv4Address(address.toIPv4Address(&isIPv4));
+	if(isIPv4)
+	{
+		return QString("%1:%2").arg(ipv4Address.toString()).arg(port);
+	}
+	return QString("[%1]:%2").arg(address.toString()).arg(port);
+}
+
+static bool parse_peer(const QString &peer, QString &host, quint16 &port)
+{
+	qsizetype colon=peer.lastIndexOf(':');
+	if(colon<=0)
+	{
+		return false;
+	}
+	bool valid=false;
+	port=peer.mid(colon+1).toUShort(&valid);
+	host=peer.left(colon);
+	if(host.startsWith('[') && host.endsWith(']'))
+	{
+		host=host.mid(1, host.size()-2);
+	}
+	return valid && port>0 && !host.isEmpty();
+}
+
+PeerQueryServer::PeerQueryServer(Indexer *indexer, QObject *parent) : QObject(parent), mIndexer(indexer)
+{
+	mServer=new QTcpServer(this);
+	connect(mServer, &QTcpServer::newConnection, this, &PeerQueryServer::onNewConnection);
+}
+
+bool PeerQueryServer::listen(quint16 port)
+{
+	if(!mServer->listen(QHostAddress::Any, port))
+	{
+		qWarning() << "Failed to listen for peer queries on port" << port << mServer->errorString();
+		return false;
+	}
+	qInfo() << "Listening for peer queries on port" << mServer->serverPort();
+	return true;
+}
+
+void PeerQueryServer::start()
+{
+	if(gSettings->peerPort()>0 && listen(gSettings->peerPort()))
+	{
+		announce();
+	}
+}
+
+// An empty query carrying our port: peers answer it with nothing and record
+// this node.
+void PeerQueryServer::announce()
+{
+	if(gSettings->peers().isEmpty() || !mServer->isListening())
+	{
+		return;
+	}
+	PeerQuery *announcement=new PeerQuery(QStringList(), 1, gSettings->peerQueryDeadline(), this);
+	announcement->setSenderPort(port());
+	connect(announcement, &PeerQuery::finished, announcement, &QObject::deleteLater);
+	announcement->start(gSettings->peers());
+}
+
+quint16 PeerQueryServer::port() const
+{
+	return mServer->serverPort();
+}
+
+QStringList PeerQueryServer::discoveredPeers() const
+{
+	return QStringList(mDiscoveredPeers.constBegin(), mDiscoveredPeers.constEnd());
+}
+
+QStringList PeerQueryServer::peers() const
+{
+	QStringList peers=gSettings->peers();
+	for(const QString &peer : mDiscoveredPeers)
+	{
+		if(!peers.contains(peer))
+		{
+			peers.append(peer);
+		}
+	}
+	return peers;
+}
+
+// The query carries this node's local results and port; start it with peers().
+PeerQuery *PeerQueryServer::createQuery(const QStringList &words, int k, int deadline)
+{
+	PeerQuery *query=new PeerQuery(words, k, deadline, this);
+	query->setSenderPort(port());
+	query->addLocalResults(mIndexer);
+	return query;
+}
+
+void PeerQueryServer::onNewConnection()
+{
+	while(mServer->hasPendingConnections())
+	{
+		QTcpSocket *socket=mServer->nextPendingConnection();
+		mBuffers.insert(socket, QByteArray());
+		connect(socket, &QTcpSocket::readyRead, this, &PeerQueryServer::onReadyRead);
+		connect(socket, &QTcpSocket::disconnected, this, &PeerQueryServer::onDisconnected);
+	}
+}
+
+void PeerQueryServer::onReadyRead()
+{
+	QTcpSocket *socket=qobject_cast<QTcpSocket *>(sender());
+	if(nullptr==socket || !mBuffers.contains(socket))
+	{
+		return;
+	}
+	QByteArray &buffer=mBuffers[socket];
+	buffer.append(socket->readAll());
+	QList<PeerQueryMessage> messages;
+	bool valid=peer_query_decode(buffer, messages);
+	for(const PeerQueryMessage &message : std::as_const(messages))
+	{
+		if(message.type!=PEER_MESSAGE_QUERY)
+		{
+			continue;
+		}
+		if(message.senderPort>0 && mDiscoveredPeers.size()<DISCOVERED_PEERS_MAX)
+		{
+			const QString peer=peer_address(socket->peerAddress(), message.senderPort);
+			if(!mDiscoveredPeers.contains(peer))
+			{
+				mDiscoveredPeers.insert(peer);
+				emit peerDiscovered(peer);
+			}
+		}
+		QElapsedTimer searchTimer;
+		searchTimer.start();
+		PeerQueryMessage reply;
+		reply.type=PEER_MESSAGE_RESULTS;
+		reply.queryId=message.queryId;
+		reply.results=peer_query_local_results(mIndexer, message.words, message.k);
+		// The asking node has given up on this one already.
+		if(searchTimer.elapsed()>message.deadline)
+		{
+			continue;
+		}
+		socket->write(peer_query_encode(reply));
+	}
+	if(!valid)
+	{
+		qWarning() << "Malformed peer query from" << socket->peerAddress().toString();
+		socket->disconnectFromHost();
+	}
+}
+
+void PeerQueryServer::onDisconnected()
+{
+	QTcpSocket *socket=qobject_cast<QTcpSocket *>(sender());
+	if(nullptr!=socket)
+	{
+		mBuffers.remove(socket);
+		socket->deleteLater();
+	}
+}
+
+PeerQuery::PeerQuery(const QStringList &words, int k, int deadline, QObject *parent) : QObject(parent), mWords(words)
+{
+	mK=qBound(1, k, int(PEER_RESULTS_MAX));
+	mDeadline=qBound(1, deadline, int(PEER_DEADLINE_MAX));
+	mQueryId=QRandomGenerator::global()->generate();
+	mSenderPort=0;
+	mPeersQueried=0;
+	mPeersAnswered=0;
+	mFinished=false;
+	mDeadlineTimer.setSingleShot(true);
+	connect(&mDeadlineTimer, &QTimer::timeout, this, &PeerQuery::finish);
+}
+
+void PeerQuery::setSenderPort(quint16 sender_port)
+{
+	mSenderPort=sender_port;
+}
+
+void PeerQuery::addLocalResults(const Indexer *indexer)
+{
+	mergeResults(peer_query_local_results(indexer, mWords, mK));
+}
+
+void PeerQuery::start(const QStringList &peers)
+{
+	mQueryClock.start();
+	mDeadlineTimer.start(mDeadline);
+	for(const QString &peer : peers)
+	{
+		QString host;
+		quint16 port;
+		if(!parse_peer(peer, host, port))
+		{
+			qWarning() << "Bad peer address:" << peer;
+			continue;
+		}
+		QTcpSocket *socket=new QTcpSocket(this);
+		mPendingPeers.insert(socket, {peer, QByteArray()});
+		mPeersQueried++;
+		connect(socket, &QTcpSocket::connected, this, &PeerQuery::onConnected);
+		connect(socket, &QTcpSocket::readyRead, this, &PeerQuery::onReadyRead);
+		connect(socket, &QTcpSocket::errorOccurred, this, &PeerQuery::onErrorOccurred);
+		socket->connectToHost(host, port);
+	}
+	if(mPendingPeers.isEmpty())
+	{
+		QMetaObject::invokeMethod(this, &PeerQuery::finish, Qt::QueuedConnection);
+	}
+}
+
+const QList<PeerQueryResult> &PeerQuery::results() const
+{
+	return mResults;
+}
+
+int PeerQuery::peersQueried() const
+{
+	return mPeersQueried;
+}
+
+int PeerQuery::peersAnswered() const
+{
+	return mPeersAnswered;
+}
+
+void PeerQuery::mergeResults(const QList<PeerQueryResult> &results)
+{
+	for(const PeerQueryResult &result : results)
+	{
+		QList<PeerQueryResult>::iterator knownIt=std::find_if(mResults.begin(), mResults.end(),
+			[&result](const PeerQueryResult &known)
+			{
+				return known.contentHash==result.contentHash || known.urlHash==result.urlHash;
+			});
+		if(knownIt==mResults.end())
+		{
+			mResults.append(result);
+		}
+		else if(result.score>knownIt->score)
+		{
+			*knownIt=result;
+		}
+	}
+	std::stable_sort(mResults.begin(), mResults.end(), [](const PeerQueryResult &a, const PeerQueryResult &b)
+		{
+			return a.score>b.score;
+		});
+	if(mResults.size()>mK)
+	{
+		mResults.resize(mK);
+	}
+	emit resultsChanged();
+}
+
+void PeerQuery::closePeer(QTcpSocket *socket)
+{
+	mPendingPeers.remove(socket);
+	socket->disconnect(this);
+	socket->abort();
+	socket->deleteLater();
+}
+
+void PeerQuery::onConnected()
+{
+	QTcpSocket *socket=qobject_cast<QTcpSocket *>(sender());
+	if(nullptr==socket)
+	{
+		return;
+	}
+	PeerQueryMessage query;
+	query.type=PEER_MESSAGE_QUERY;
+	query.queryId=mQueryId;
+	query.k=mK;
+	query.deadline=qMax(qint64(1), mDeadline-mQueryClock.elapsed());
+	query.senderPort=mSenderPort;
+	query.words=mWords;
+	socket->write(peer_query_encode(query));
+}
+
+void PeerQuery::onReadyRead()
+{
+	QTcpSocket *socket=qobject_cast<QTcpSocket *>(sender());
+	if(nullptr==socket || !mPendingPeers.contains(socket))
+	{
+		return;
+	}
+	PendingPeer &pendingPeer=mPendingPeers[socket];
+	pendingPeer.buffer.append(socket->readAll());
+	QList<PeerQueryMessage> messages;
+	bool valid=peer_query_decode(pendingPeer.buffer, messages);
+	bool answered=false;
+	for(PeerQueryMessage &message : messages)
+	{
+		if(message.type==PEER_MESSAGE_RESULTS && message.queryId==mQueryId)
+		{
+			for(PeerQueryResult &result : message.results)
+			{
+				result.peer=pendingPeer.peer;
+			}
+			mergeResults(message.results);
+			mPeersAnswered++;
+			answered=true;
+			break;
+		}
+	}
+	if(!valid && !answered)
+	{
+		qWarning() << "Malformed answer from peer" << pendingPeer.peer;
+	}
+	if(!valid || answered)
+	{
+		closePeer(socket);
+		if(mPendingPeers.isEmpty())
+		{
+			finish();
+		}
+	}
+}
+
+void PeerQuery::onErrorOccurred()
+{
+	QTcpSocket *socket=qobject_cast<QTcpSocket *>(sender());
+	if(nullptr==socket)
+	{
+		return;
+	}
+	qWarning() << "Peer" << mPendingPeers.value(socket).peer << "failed:" << socket->errorString();
+	closePeer(socket);
+	if(mPendingPeers.isEmpty())
+	{
+		finish();
+	}
+}
+
+void PeerQuery::finish()
+{
+	if(mFinished)
+	{
+		return;
+	}
+	mFinished=true;
+	mDeadlineTimer.stop();
+	const QList<QTcpSocket *> sockets=mPendingPeers.keys();
+	for(QTcpSocket *socket : sockets)
+	{
+		closePeer(socket);
+	}
+	qInfo() << "Peer query answered by" << mPeersAnswered << "of" << mPeersQueried << "peers in" << mQueryClock.elapsed() << "ms," <<
+		mResults.size() << "results";
+	emit finished();
+}
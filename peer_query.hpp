@@ -0,0 +1,129 @@
+#ifndef PEER_QUERY_HPP
+#define PEER_QUERY_HPP
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+
+class Indexer;
+
+static constexpr quint8 PEER_PROTOCOL_VERSION=1;
+static constexpr quint8 PEER_MESSAGE_QUERY=1;
+static constexpr quint8 PEER_MESSAGE_RESULTS=2;
+
+struct PeerQueryResult
+{
+	double score;
+	QByteArray urlHash;
+	QByteArray contentHash;
+	QByteArray url;
+	QString title;
+	QString peer;
+};
+
+struct PeerQueryMessage
+{
+	quint8 type;
+	quint32 queryId;
+	quint32 k;
+	quint32 deadline;
+	quint16 senderPort;
+	QStringList words;
+	QList<PeerQueryResult> results;
+};
+
+// Every message is a little-endian u32 payload length and the payload: a type
+// byte and the little-endian u32 query ID, then for a query the protocol
+// version byte, k, the deadline in milliseconds, the sender's own peer port
+// (0 if it does not serve) and the words; for results their number and, per
+// result, the score as a little-endian IEEE 754 double, URL hash, content hash,
+// URL and title. Numbers and string lengths are varints, strings UTF-8.
+QByteArray peer_query_encode(const PeerQueryMessage &message);
+// Moves the complete messages at the front of buffer to messages; false if
+// one of them is malformed.
+bool peer_query_decode(QByteArray &buffer, QList<PeerQueryMessage> &messages);
+QList<PeerQueryResult> peer_query_local_results(const Indexer *indexer, const QStringList &words, int k);
+
+class PeerQuery;
+
+// Answers peer queries from the local index, so it has to live in the
+// Indexer's thread. Peers that announce their own port are remembered and
+// queried along with the configured ones; start() announces this node to the
+// configured peers so that they learn about it in turn.
+class PeerQueryServer : public QObject
+{
+	Q_OBJECT
+	static constexpr int DISCOVERED_PEERS_MAX=256;
+	Indexer *mIndexer;
+	QTcpServer *mServer;
+	QHash<QTcpSocket *, QByteArray> mBuffers;
+	QSet<QString> mDiscoveredPeers;
+private slots:
+	void onNewConnection();
+	void onReadyRead();
+	void onDisconnected();
+public:
+	PeerQueryServer(Indexer *indexer, QObject *parent = nullptr);
+	bool listen(quint16 port);
+	quint16 port() const;
+	QStringList discoveredPeers() const;
+	QStringList peers() const;
+	PeerQuery *createQuery(const QStringList &words, int k, int deadline);
+public slots:
+	void start();
+	void announce();
+signals:
+	void peerDiscovered(const QString &peer);
+};
+
+// One query fanned out to peers in parallel. Results are merged into the top
+// k by score as they arrive, a page found by several nodes keeping its best
+// score. finished() comes once every peer has answered or failed, or at the
+// deadline with what has arrived by then. Each node scores with its own
+// TF-IDF, so scores are only roughly comparable across nodes.
+class PeerQuery : public QObject
+{
+	Q_OBJECT
+	struct PendingPeer
+	{
+		QString peer;
+		QByteArray buffer;
+	};
+	QStringList mWords;
+	int mK;
+	int mDeadline;
+	quint32 mQueryId;
+	quint16 mSenderPort;
+	QList<PeerQueryResult> mResults;
+	QHash<QTcpSocket *, PendingPeer> mPendingPeers;
+	int mPeersQueried;
+	int mPeersAnswered;
+	bool mFinished;
+	QTimer mDeadlineTimer;
+	QElapsedTimer mQueryClock;
+	void mergeResults(const QList<PeerQueryResult> &results);
+	void closePeer(QTcpSocket *socket);
+private slots:
+	void onConnected();
+	void onReadyRead();
+	void onErrorOccurred();
+	void finish();
+public:
+	PeerQuery(const QStringList &words, int k, int deadline, QObject *parent = nullptr);
+	void setSenderPort(quint16 sender_port);
+	void addLocalResults(const Indexer *indexer);
+	void start(const QStringList &peers);
+	const QList<PeerQueryResult> &results() const;
+	int peersQueried() const;
+	int peersAnswered() const;
+signals:
+	void resultsChanged();
+	void finished();
+};
+
+#endif // PEER_QUERY_HPP
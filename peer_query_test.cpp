@@ -0,0 +1,250 @@
+#include <QTest>
+#include <QSignalSpy>
+#include <QTcpServer>
+#include <QtEndian>
+#include "main.hpp"
+#include "indexer.hpp"
+#include "peer_query.hpp"
+#include "util.hpp"
+
+ConfigurationKeeper *gSettings;
+
+static constexpr int PEER_QUERY_TIMEOUT=5000;
+
+// Accepts connections and never answers, like a peer that hangs.
+class SilentPeerServer : public QTcpServer
+{
+public:
+	SilentPeerServer()
+	{
+		listen(QHostAddress::LocalHost);
+	}
+};
+
+class PeerQueryTest : public QObject
+{
+	Q_OBJECT
+	static void addTestPage(Indexer &indexer, const QByteArray &url, const QByteArray &content, const QMap<QString, quint32> &words)
+	{
+		QList<QPair<quint32, quint32>> termFrequencies;
+		for(QMap<QString, quint32>::const_iterator wordIt=words.constBegin(); wordIt!=words.constEnd(); wordIt++)
+		{
+			indexer.addWord(wordIt.key());
+			termFrequencies.append(qMakePair(indexer.termId(wordIt.key()), wordIt.value()));
+		}
+		PageHeader pageHeader;
+		pageHeader.url=url;
+		pageHeader.urlHash=hash_function_128(url);
+		pageHeader.contentHash=hash_function_128(content);
+		pageHeader.title=QString::fromUtf8(url);
+		pageHeader.timeStamp=QDateTime::currentDateTime();
+		indexer.addPage(pageHeader, termFrequencies);
+	}
+	static QString localPeer(quint16 port)
+	{
+		return QString("127.0.0.1:%1").arg(port);
+	}
+	static PeerQueryMessage queryMessage()
+	{
+		PeerQueryMessage message;
+		message.type=PEER_MESSAGE_QUERY;
+		message.queryId=0xDEADBEEF;
+		message.k=10;
+		message.deadline=1500;
+		message.senderPort=8080;
+		message.words={"seeklet", QString::fromUtf8("größe")};
+		return message;
+	}
+	static PeerQueryMessage resultsMessage()
+	{
+		PeerQueryMessage message;
+		message.type=PEER_MESSAGE_RESULTS;
+		message.queryId=42;
+		message.k=0;
+		message.deadline=0;
+		message.senderPort=0;
+		message.results.append(PeerQueryResult{1.5, QByteArray(16, 'u'), QByteArray(16, 'c'), "https://example.com/", QString::fromUtf8("Ünïcode title"), QString()});
+		message.results.append(PeerQueryResult{-0.25, QByteArray(16, 'v'), QByteArray(16, 'd'), "https://example.com/2", "x", QString()});
+		return message;
+	}
+	// Decodes one frame on its own and reports whether it was accepted.
+	static bool decodes(QByteArray frame)
+	{
+		QList<PeerQueryMessage> messages;
+		return peer_query_decode(frame, messages) && messages.size()==1;
+	}
+	static void setFrameLength(QByteArray &frame)
+	{
+		qToLittleEndian<quint32>(frame.size()-sizeof(quint32), frame.data());
+	}
+private slots:
+	void initTestCase()
+	{
+		gSettings=new ConfigurationKeeper();
+		gSettings->setNearDuplicateDistance(-1);
+	}
+
+	void roundTrip()
+	{
+		const QByteArray queryFrame=peer_query_encode(queryMessage());
+		const QByteArray resultsFrame=peer_query_encode(resultsMessage());
+		QByteArray buffer=queryFrame+resultsFrame+queryFrame.left(3);
+		QList<PeerQueryMessage> messages;
+		QVERIFY(peer_query_decode(buffer, messages));
+		QCOMPARE(messages.size(), 2);
+		QCOMPARE(buffer, queryFrame.left(3));
+		const PeerQueryMessage &query=messages.at(0);
+		QCOMPARE(query.type, PEER_MESSAGE_QUERY);
+		QCOMPARE(query.queryId, quint32(0xDEADBEEF));
+		QCOMPARE(query.k, quint32(10));
+		QCOMPARE(query.deadline, quint32(1500));
+		QCOMPARE(query.senderPort, quint16(8080));
+		QCOMPARE(query.words, queryMessage().words);
+		const PeerQueryMessage &results=messages.at(1);
+		QCOMPARE(results.type, PEER_MESSAGE_RESULTS);
+		QCOMPARE(results.queryId, quint32(42));
+		QCOMPARE(results.results.size(), 2);
+		for(int result=0; result<2; result++)
+		{
+			const PeerQueryResult &expected=resultsMessage().results.at(result);
+			QCOMPARE(results.results.at(result).score, expected.score);
+			QCOMPARE(results.results.at(result).urlHash, expected.urlHash);
+			QCOMPARE(results.results.at(result).contentHash, expected.contentHash);
+			QCOMPARE(results.results.at(result).url, expected.url);
+			QCOMPARE(results.results.at(result).title, expected.title);
+		}
+		buffer.append(queryFrame.mid(3));
+		messages.clear();
+		QVERIFY(peer_query_decode(buffer, messages));
+		QCOMPARE(messages.size(), 1);
+		QVERIFY(buffer.isEmpty());
+	}
+
+	void malformedFrames()
+	{
+		const QByteArray queryFrame=peer_query_encode(queryMessage());
+		const QByteArray resultsFrame=peer_query_encode(resultsMessage());
+		QVERIFY(decodes(queryFrame));
+		QVERIFY(decodes(resultsFrame));
+		// Shorter than the type and query ID.
+		QVERIFY(!decodes(QByteArray("\x02\x00\x00\x00\x01\x00", 6)));
+		// Longer than any frame is allowed to be.
+		QVERIFY(!decodes(QByteArray("\xFF\xFF\xFF\x7F\x01", 5)));
+		QByteArray unknownType=queryFrame;
+		unknownType[4]=char(9);
+		QVERIFY(!decodes(unknownType));
+		QByteArray otherVersion=queryFrame;
+		otherVersion[9]=char(PEER_PROTOCOL_VERSION+1);
+		QVERIFY(!decodes(otherVersion));
+		PeerQueryMessage zeroK=queryMessage();
+		zeroK.k=0;
+		QVERIFY(!decodes(peer_query_encode(zeroK)));
+		PeerQueryMessage longDeadline=queryMessage();
+		longDeadline.deadline=10*60*1000;
+		QVERIFY(!decodes(peer_query_encode(longDeadline)));
+		QByteArray trailingByte=queryFrame+'x';
+		setFrameLength(trailingByte);
+		QVERIFY(!decodes(trailingByte));
+		QByteArray truncatedTitle=resultsFrame;
+		truncatedTitle.chop(1);
+		setFrameLength(truncatedTitle);
+		QVERIFY(!decodes(truncatedTitle));
+		PeerQueryMessage notANumber=resultsMessage();
+		notANumber.results[0].score=qQNaN();
+		QVERIFY(!decodes(peer_query_encode(notANumber)));
+		// Messages before a malformed frame are kept.
+		QByteArray buffer=queryFrame+unknownType;
+		QList<PeerQueryMessage> messages;
+		QVERIFY(!peer_query_decode(buffer, messages));
+		QCOMPARE(messages.size(), 1);
+	}
+
+	void mergeAcrossPeers()
+	{
+		Indexer firstIndexer;
+		firstIndexer.setDatabaseDirectory(QString());
+		addTestPage(firstIndexer, "https://a.invalid/1", "one", {{"seeklet", 3}, {"alpha", 5}});
+		addTestPage(firstIndexer, "https://shared.invalid/", "shared", {{"seeklet", 1}, {"gamma", 5}});
+		addTestPage(firstIndexer, "https://a.invalid/other", "other", {{"filler", 4}});
+		Indexer secondIndexer;
+		secondIndexer.setDatabaseDirectory(QString());
+		// Same content as a.invalid/1 under another URL.
+		addTestPage(secondIndexer, "https://b.invalid/copy", "one", {{"seeklet", 3}, {"alpha", 5}});
+		// Same URL as on the first peer, other content.
+		addTestPage(secondIndexer, "https://shared.invalid/", "shared, edited", {{"seeklet", 2}, {"delta", 4}});
+		addTestPage(secondIndexer, "https://b.invalid/3", "three", {{"seeklet", 1}, {"beta", 8}});
+		addTestPage(secondIndexer, "https://b.invalid/other", "other b", {{"filler", 4}});
+		PeerQueryServer firstServer(&firstIndexer);
+		PeerQueryServer secondServer(&secondIndexer);
+		QVERIFY(firstServer.listen(0));
+		QVERIFY(secondServer.listen(0));
+
+		PeerQuery query({"seeklet"}, 10, PEER_QUERY_TIMEOUT);
+		query.setSenderPort(secondServer.port());
+		QSignalSpy finishedSpy(&query, &PeerQuery::finished);
+		query.start({localPeer(firstServer.port()), localPeer(secondServer.port())});
+		QVERIFY(finishedSpy.wait(PEER_QUERY_TIMEOUT));
+		QCOMPARE(query.peersQueried(), 2);
+		QCOMPARE(query.peersAnswered(), 2);
+		const QList<PeerQueryResult> &results=query.results();
+		QCOMPARE(results.size(), 3);
+		QSet<QByteArray> urlHashes, contentHashes, urls;
+		for(int result=0; result<results.size(); result++)
+		{
+			urlHashes.insert(results.at(result).urlHash);
+			contentHashes.insert(results.at(result).contentHash);
+			urls.insert(results.at(result).url);
+			QVERIFY(!results.at(result).peer.isEmpty());
+			if(result>0)
+			{
+				QVERIFY(results.at(result-1).score>=results.at(result).score);
+			}
+		}
+		QCOMPARE(urlHashes.size(), 3);
+		QCOMPARE(contentHashes.size(), 3);
+		QVERIFY(urls.contains("https://shared.invalid/"));
+		QVERIFY(urls.contains("https://b.invalid/3"));
+		QVERIFY(urls.contains("https://a.invalid/1") || urls.contains("https://b.invalid/copy"));
+		// The sender port makes the asking node known to both peers.
+		QVERIFY(firstServer.discoveredPeers().contains(localPeer(secondServer.port())));
+		QVERIFY(firstServer.peers().contains(localPeer(secondServer.port())));
+
+		PeerQuery topQuery({"seeklet"}, 2, PEER_QUERY_TIMEOUT);
+		QSignalSpy topFinishedSpy(&topQuery, &PeerQuery::finished);
+		topQuery.start({localPeer(firstServer.port()), localPeer(secondServer.port())});
+		QVERIFY(topFinishedSpy.wait(PEER_QUERY_TIMEOUT));
+		QCOMPARE(topQuery.results().size(), 2);
+		QCOMPARE(topQuery.results().at(0).score, results.at(0).score);
+		QCOMPARE(topQuery.results().at(1).score, results.at(1).score);
+	}
+
+	void partialResultsAtDeadline()
+	{
+		static constexpr int DEADLINE=300;
+		Indexer indexer;
+		indexer.setDatabaseDirectory(QString());
+		addTestPage(indexer, "https://a.invalid/1", "one", {{"seeklet", 3}, {"alpha", 5}});
+		addTestPage(indexer, "https://a.invalid/other", "other", {{"filler", 4}});
+		PeerQueryServer server(&indexer);
+		QVERIFY(server.listen(0));
+		SilentPeerServer silentServer;
+		QVERIFY(silentServer.isListening());
+
+		PeerQuery query({"seeklet"}, 10, DEADLINE);
+		QSignalSpy finishedSpy(&query, &PeerQuery::finished);
+		QElapsedTimer queryTimer;
+		queryTimer.start();
+		query.start({localPeer(server.port()), localPeer(silentServer.serverPort())});
+		QVERIFY(finishedSpy.wait(PEER_QUERY_TIMEOUT));
+		QVERIFY(queryTimer.elapsed()>=DEADLINE-50);
+		QCOMPARE(finishedSpy.count(), 1);
+		QCOMPARE(query.peersQueried(), 2);
+		QCOMPARE(query.peersAnswered(), 1);
+		QCOMPARE(query.results().size(), 1);
+		QCOMPARE(query.results().at(0).url, QByteArray("https://a.invalid/1"));
+		QCOMPARE(query.results().at(0).peer, localPeer(server.port()));
+	}
+};
+
+QTEST_GUILESS_MAIN(PeerQueryTest)
+#include "peer_query_test.moc"
@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <QDebug>
+#include "posting_segment.hpp"
+
+static constexpr qsizetype CONTENT_HASH_SIZE=16;
+
+PostingSegment::PostingSegment(const QString &file_template) : mFile(file_template)
+{
+	mPostingsNum=0;
+}
+
+bool PostingSegment::appendTerm(quint32 term_id, const QSet<QByteArray> &content_hashes, QByteArray &buffer)
+{
+	buffer.clear();
+	for(const QByteArray &contentHash : content_hashes)
+	{
+		if(contentHash.size()==CONTENT_HASH_SIZE)
+		{
+			buffer.append(contentHash);
+		}
+	}
+	if(buffer.isEmpty())
+	{
+		return true;
+	}
+	qint64 offset=mFile.pos();
+	if(mFile.write(buffer)!=buffer.size())
+	{
+		qWarning() << "Failed to write posting segment" << mFile.fileName();
+		return false;
+	}
+	quint32 count=buffer.size()/CONTENT_HASH_SIZE;
+	mTerms.insert(term_id, {offset, count});
+	mPostingsNum+=count;
+	return true;
+}
+
+PostingSegmentPointer PostingSegment::write(const QString &file_template, const QHash<quint32, QSet<QByteArray>> &postings)
+{
+	PostingSegmentPointer segment(new PostingSegment(file_template));
+	if(!segment->mFile.open())
+	{
+		qWarning() << "Failed to create posting segment" << file_template;
+		return PostingSegmentPointer();
+	}
+	QList<quint32> termIds=postings.keys();
+	std::sort(termIds.begin(), termIds.end());
+	QByteArray buffer;
+	segment->mTerms.reserve(termIds.size());
+	for(quint32 termId : std::as_const(termIds))
+	{
+		if(!segment->appendTerm(termId, *postings.constFind(termId), buffer))
+		{
+			return PostingSegmentPointer();
+		}
+	}
+	if(!segment->mFile.flush())
+	{
+		return PostingSegmentPointer();
+	}
+	return segment;
+}
+
+PostingSegmentPointer PostingSegment::merge(const QString &file_template, const QList<PostingSegmentPointer> &segments,
+	const std::function<bool(quint32, const QByteArray &)> &keep)
+{
+	PostingSegmentPointer merged(new PostingSegment(file_template));
+	if(!merged->mFile.open())
+	{
+		qWarning() << "Failed to create posting segment" << file_template;
+		return PostingSegmentPointer();
+	}
+	QSet<quint32> termIdSet;
+	for(const PostingSegmentPointer &segment : segments)
+	{
+		for(QHash<quint32, TermRange>::const_iterator termIt=segment->mTerms.constBegin(); termIt!=segment->mTerms.constEnd(); termIt++)
+		{
+			termIdSet.insert(termIt.key());
+		}
+	}
+	QList<quint32> termIds(termIdSet.constBegin(), termIdSet.constEnd());
+	std::sort(termIds.begin(), termIds.end());
+	QByteArray buffer;
+	for(quint32 termId : std::as_const(termIds))
+	{
+		QSet<QByteArray> contentHashes;
+		for(const PostingSegmentPointer &segment : segments)
+		{
+			const QSet<QByteArray> segmentPostings=segment->postings(termId);
+			for(const QByteArray &contentHash : segmentPostings)
+			{
+				if(keep(termId, contentHash))
+				{
+					contentHashes.insert(contentHash);
+				}
+			}
+		}
+		if(!merged->appendTerm(termId, contentHashes, buffer))
+		{
+			return PostingSegmentPointer();
+		}
+	}
+	if(!merged->mFile.flush())
+	{
+		return PostingSegmentPointer();
+	}
+	return merged;
+}
+
+bool PostingSegment::contains(quint32 term_id) const
+{
+	return mTerms.contains(term_id);
+}
+
+quint32 PostingSegment::documentFrequency(quint32 term_id) const
+{
+	return mTerms.value(term_id, {0, 0}).count;
+}
+
+QSet<QByteArray> PostingSegment::postings(quint32 term_id) const
+{
+	QSet<QByteArray> result;
+	QHash<quint32, TermRange>::const_iterator termIt=mTerms.constFind(term_id);
+	if(termIt==mTerms.constEnd())
+	{
+		return result;
+	}
+	QByteArray termPostings;
+	{
+		QMutexLocker locker(&mFileMutex);
+		if(!mFile.seek(termIt->offset))
+		{
+			return result;
+		}
+		termPostings=mFile.read(qint64(termIt->count)*CONTENT_HASH_SIZE);
+	}
+	result.reserve(termPostings.size()/CONTENT_HASH_SIZE);
+	for(qsizetype offset=0; offset+CONTENT_HASH_SIZE<=termPostings.size(); offset+=CONTENT_HASH_SIZE)
+	{
+		result.insert(termPostings.mid(offset, CONTENT_HASH_SIZE));
+	}
+	return result;
+}
+
+QList<quint32> PostingSegment::terms() const
+{
+	return mTerms.keys();
+}
+
+qint64 PostingSegment::postingsNum() const
+{
+	return mPostingsNum;
+}
+
+qsizetype PostingSegment::sizeInBytes() const
+{
+	return sizeof(PostingSegment)+mTerms.capacity()*(sizeof(quint32)+sizeof(TermRange)+8);
+}
@@ -0,0 +1,46 @@
+#ifndef POSTING_SEGMENT_HPP
+#define POSTING_SEGMENT_HPP
+
+#include <QHash>
+#include <QSet>
+#include <QList>
+#include <QByteArray>
+#include <QTemporaryFile>
+#include <QMutex>
+#include <QSharedPointer>
+#include <functional>
+
+// Immutable run of list postings spilled to disk when the Indexer goes over
+// its memory budget. Content hashes of each term are stored back to back;
+// only the term -> (offset, count) table stays in memory. The file is a
+// temporary one and goes away with the segment. Segments are shared with
+// index snapshots, so reads are serialized on the file.
+class PostingSegment;
+typedef QSharedPointer<PostingSegment> PostingSegmentPointer;
+
+class PostingSegment
+{
+	struct TermRange
+	{
+		qint64 offset;
+		quint32 count;
+	};
+	mutable QTemporaryFile mFile;
+	mutable QMutex mFileMutex;
+	QHash<quint32, TermRange> mTerms;
+	qint64 mPostingsNum;
+	PostingSegment(const QString &file_template);
+	bool appendTerm(quint32 term_id, const QSet<QByteArray> &content_hashes, QByteArray &buffer);
+public:
+	static PostingSegmentPointer write(const QString &file_template, const QHash<quint32, QSet<QByteArray>> &postings);
+	static PostingSegmentPointer merge(const QString &file_template, const QList<PostingSegmentPointer> &segments,
+		const std::function<bool(quint32, const QByteArray &)> &keep);
+	bool contains(quint32 term_id) const;
+	quint32 documentFrequency(quint32 term_id) const;
+	QSet<QByteArray> postings(quint32 term_id) const;
+	QList<quint32> terms() const;
+	qint64 postingsNum() const;
+	qsizetype sizeInBytes() const;
+};
+
+#endif // POSTING_SEGMENT_HPP
@@ -0,0 +1,379 @@
+#include <QDir>
+#include <QFile>
+#include <QDateTime>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include "main.hpp"
+#include "recrawl_scheduler.hpp"
+
+static constexpr int PROBE_TRANSFER_TIMEOUT=10000;
+
+RecrawlRecord::RecrawlRecord()
+{
+	firstFetchTime=0;
+	lastFetchTime=0;
+	lastModifiedHint=0;
+	visits=0;
+	changes=0;
+}
+
+void RecrawlRecord::writeToStream(QDataStream &stream) const
+{
+	stream << this->url;
+	stream << this->firstFetchTime;
+	stream << this->lastFetchTime;
+	stream << this->lastModifiedHint;
+	stream << this->eTag;
+	stream << this->lastModified;
+	stream << this->contentHashHistory;
+	stream << this->visits;
+	stream << this->changes;
+}
+
+void RecrawlRecord::readFromStream(QDataStream &stream)
+{
+	stream >> this->url;
+	stream >> this->firstFetchTime;
+	stream >> this->lastFetchTime;
+	stream >> this->lastModifiedHint;
+	stream >> this->eTag;
+	stream >> this->lastModified;
+	stream >> this->contentHashHistory;
+	stream >> this->visits;
+	stream >> this->changes;
+}
+
+RecrawlScheduler::RecrawlScheduler(QObject *parent) : QObject(parent)
+{
+	mNetworkManager=new QNetworkAccessManager(this);
+	mProbesNotModified=0;
+	mProbesModified=0;
+	setDefaultRecrawlInterval(gSettings->recrawlDefaultInterval());
+	setDatabaseDirectory(gSettings->databaseDirectory());
+}
+
+void RecrawlScheduler::setDatabaseDirectory(const QString &database_directory)
+{
+	mDatabaseDirectory=database_directory;
+}
+
+void RecrawlScheduler::setDefaultRecrawlInterval(qint64 seconds)
+{
+	if(seconds<1)
+	{
+		seconds=1;
+	}
+	mDefaultChangeRate=1.0/seconds;
+}
+
+bool RecrawlScheduler::contains(const QByteArray &url_hash) const
+{
+	QMutexLocker locker(&mRecordsMutex);
+	return mRecords.contains(url_hash);
+}
+
+QList<QByteArray> RecrawlScheduler::knownURLHashes() const
+{
+	QMutexLocker locker(&mRecordsMutex);
+	return mRecords.keys();
+}
+
+bool RecrawlScheduler::recordFetch(const QByteArray &url_hash, const QUrl &url, const QByteArray &content_hash)
+{
+	QMutexLocker locker(&mRecordsMutex);
+	qint64 now=QDateTime::currentSecsSinceEpoch();
+	RecrawlRecord &record=mRecords[url_hash];
+	mURLHashesInFlight.remove(url_hash);
+	bool changed=true;
+	if(record.visits==0)
+	{
+		record.url=url;
+		record.firstFetchTime=now;
+	}
+	else if(!record.contentHashHistory.isEmpty() && record.contentHashHistory.last().second==content_hash)
+	{
+		changed=false;
+	}
+	else
+	{
+		record.changes++;
+	}
+	if(changed)
+	{
+		record.contentHashHistory.append(qMakePair(now, content_hash));
+		while(record.contentHashHistory.size()>RecrawlRecord::HISTORY_LENGTH_MAX)
+		{
+			record.contentHashHistory.removeFirst();
+		}
+	}
+	record.visits++;
+	record.lastFetchTime=now;
+	return changed;
+}
+
+void RecrawlScheduler::recordNotModified(const QByteArray &url_hash)
+{
+	QMutexLocker locker(&mRecordsMutex);
+	mURLHashesInFlight.remove(url_hash);
+	QHash<QByteArray, RecrawlRecord>::iterator recordIt=mRecords.find(url_hash);
+	if(recordIt==mRecords.end())
+	{
+		return;
+	}
+	recordIt->visits++;
+	recordIt->lastFetchTime=QDateTime::currentSecsSinceEpoch();
+}
+
+void RecrawlScheduler::recordFetchFailed(const QByteArray &url_hash)
+{
+	QMutexLocker locker(&mRecordsMutex);
+	mURLHashesInFlight.remove(url_hash);
+}
+
+void RecrawlScheduler::setLastModifiedHint(const QByteArray &url_hash, const QUrl &url, qint64 last_modified)
+{
+	QMutexLocker locker(&mRecordsMutex);
+	QHash<QByteArray, RecrawlRecord>::iterator recordIt=mRecords.find(url_hash);
+	if(recordIt==mRecords.end())
+	{
+		return;
+	}
+	if(recordIt->url.isEmpty())
+	{
+		recordIt->url=url;
+	}
+	recordIt->lastModifiedHint=last_modified;
+}
+
+double RecrawlScheduler::changeRate(const RecrawlRecord &record) const
+{
+	// Poisson change-rate estimator for periodic checks with incomplete
+	// change history (Cho & Garcia-Molina): the number of detected changes
+	// undercounts the real ones, so the raw X/T ratio would be biased low.
+	if(record.visits<2)
+	{
+		return mDefaultChangeRate;
+	}
+	double revisits=record.visits-1;
+	double intervalMean=double(record.lastFetchTime-record.firstFetchTime)/revisits;
+	if(intervalMean<=0.0)
+	{
+		return mDefaultChangeRate;
+	}
+	double changesDetected=record.changes;
+	return -std::log((revisits-changesDetected+0.5)/(revisits+0.5))/intervalMean;
+}
+
+double RecrawlScheduler::revisitPriority(const RecrawlRecord &record, qint64 now) const
+{
+	if(record.lastModifiedHint>record.lastFetchTime)
+	{
+		return 1.0;
+	}
+	double elapsed=now-record.lastFetchTime;
+	if(elapsed<=0.0)
+	{
+		return 0.0;
+	}
+	return 1.0-std::exp(-changeRate(record)*elapsed);
+}
+
+QList<QUrl> RecrawlScheduler::takeDueURLs(int count, double min_priority)
+{
+	QList<QUrl> dueURLs;
+	if(count<=0)
+	{
+		return dueURLs;
+	}
+	QMutexLocker locker(&mRecordsMutex);
+	qint64 now=QDateTime::currentSecsSinceEpoch();
+	QList<QPair<double, QByteArray>> candidates;
+	QHash<QByteArray, RecrawlRecord>::const_iterator recordIt;
+	for(recordIt=mRecords.constBegin(); recordIt!=mRecords.constEnd(); recordIt++)
+	{
+		if(mURLHashesInFlight.contains(recordIt.key()) || !recordIt->url.isValid())
+		{
+			continue;
+		}
+		double priority=revisitPriority(recordIt.value(), now);
+		if(priority>=min_priority)
+		{
+			candidates.append(qMakePair(priority, recordIt.key()));
+		}
+	}
+	int selected=qMin(count, (int)candidates.size());
+	std::partial_sort(candidates.begin(), candidates.begin()+selected, candidates.end(),
+		[](const QPair<double, QByteArray> &a, const QPair<double, QByteArray> &b)
+		{
+			return a.first>b.first;
+		});
+	for(int i=0; i<selected; i++)
+	{
+		mURLHashesInFlight.insert(candidates.at(i).second);
+		dueURLs.append(mRecords.value(candidates.at(i).second).url);
+	}
+	return dueURLs;
+}
+
+void RecrawlScheduler::probe(const QUrl &url, const QByteArray &url_hash)
+{
+	mRecordsMutex.lock();
+	const RecrawlRecord record=mRecords.value(url_hash);
+	mRecordsMutex.unlock();
+	// The browser does not expose response headers, so the first probe of a
+	// page goes out without validators and only collects them.
+	QNetworkRequest request(url);
+	request.setHeader(QNetworkRequest::UserAgentHeader, gSettings->httpUserAgent());
+	request.setTransferTimeout(PROBE_TRANSFER_TIMEOUT);
+	if(!record.eTag.isEmpty())
+	{
+		request.setRawHeader("If-None-Match", record.eTag);
+	}
+	if(!record.lastModified.isEmpty())
+	{
+		request.setRawHeader("If-Modified-Since", record.lastModified);
+	}
+	QNetworkReply *reply=mNetworkManager->head(request);
+	connect(reply, &QNetworkReply::finished, this,
+		[this, reply, url, url_hash]()
+		{
+			reply->deleteLater();
+			int statusCode=reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+			QByteArray eTag=reply->rawHeader("ETag");
+			QByteArray lastModified=reply->rawHeader("Last-Modified");
+			bool modified=true;
+			QMutexLocker locker(&mRecordsMutex);
+			if(statusCode==0)
+			{
+				// No HTTP response; the page load that follows reports its own outcome.
+				qDebug() << "Recrawl probe failed:" << url.toString() << reply->errorString();
+				mURLHashesInFlight.remove(url_hash);
+			}
+			QHash<QByteArray, RecrawlRecord>::iterator recordIt=mRecords.find(url_hash);
+			if(recordIt!=mRecords.end())
+			{
+				if(statusCode==304)
+				{
+					modified=false;
+				}
+				else if(statusCode==200)
+				{
+					bool eTagMatches=!eTag.isEmpty() && eTag==recordIt->eTag;
+					bool lastModifiedMatches=!lastModified.isEmpty() && lastModified==recordIt->lastModified;
+					QDateTime lastModifiedTime=reply->header(QNetworkRequest::LastModifiedHeader).toDateTime();
+					bool unchangedSinceFetch=lastModifiedTime.isValid() && recordIt->lastFetchTime>0 &&
+						lastModifiedTime.toSecsSinceEpoch()<recordIt->lastFetchTime;
+					modified=!(eTagMatches || lastModifiedMatches || unchangedSinceFetch);
+				}
+				if(!eTag.isEmpty())
+				{
+					recordIt->eTag=eTag;
+				}
+				if(!lastModified.isEmpty())
+				{
+					recordIt->lastModified=lastModified;
+				}
+			}
+			if(modified)
+			{
+				mProbesModified++;
+			}
+			else
+			{
+				mProbesNotModified++;
+				recordNotModified(url_hash);
+			}
+			locker.unlock();
+			emit probeFinished(url, modified);
+		});
+}
+
+quint64 RecrawlScheduler::probesNotModified() const
+{
+	return mProbesNotModified;
+}
+
+quint64 RecrawlScheduler::probesModified() const
+{
+	return mProbesModified;
+}
+
+void RecrawlScheduler::save()
+{
+	qDebug("RecrawlScheduler::save");
+	if(mDatabaseDirectory.isEmpty())
+	{
+		return;
+	}
+	QDir dbDir(mDatabaseDirectory);
+	quint64 dataStreamVersion=QDataStream::Qt_6_0;
+	QString recrawlFilePath=dbDir.filePath("recrawl.dat");
+	QFile recrawlFile(recrawlFilePath);
+	if(recrawlFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+	{
+		QDataStream recrawlFileStream(&recrawlFile);
+		recrawlFileStream.setVersion(QDataStream::Qt_6_0);
+		recrawlFileStream << dataStreamVersion;
+		QMutexLocker locker(&mRecordsMutex);
+		quint64 numOfRecords=mRecords.size();
+		recrawlFileStream << numOfRecords;
+		QHash<QByteArray, RecrawlRecord>::const_iterator recordIt;
+		for(recordIt=mRecords.constBegin(); recordIt!=mRecords.constEnd(); recordIt++)
+		{
+			recrawlFileStream << recordIt.key();
+			recordIt->writeToStream(recrawlFileStream);
+		}
+		recrawlFile.close();
+		qInfo() << "Recrawl metadata has been saved successfully:" << mRecords.size() << "records saved.";
+	}
+	else
+	{
+		qWarning() << "Failed to open" << recrawlFilePath << "for writing";
+	}
+}
+
+void RecrawlScheduler::load()
+{
+	qDebug("RecrawlScheduler::load");
+	if(mDatabaseDirectory.isEmpty())
+	{
+		return;
+	}
+	QDir dbDir(mDatabaseDirectory);
+	quint64 dataStreamVersion, numOfRecords;
+	QString recrawlFilePath=dbDir.filePath("recrawl.dat");
+	QFile recrawlFile(recrawlFilePath);
+	if(recrawlFile.open(QIODevice::ReadOnly))
+	{
+		QDataStream recrawlFileStream(&recrawlFile);
+		recrawlFileStream.setVersion(QDataStream::Qt_6_0);
+		recrawlFileStream >> dataStreamVersion;
+		if(dataStreamVersion==(quint64)(QDataStream::Qt_6_0))
+		{
+			QMutexLocker locker(&mRecordsMutex);
+			mRecords.clear();
+			recrawlFileStream >> numOfRecords;
+			for(quint64 record=0; record<numOfRecords && recrawlFileStream.status()==QDataStream::Ok; record++)
+			{
+				QByteArray urlHash;
+				RecrawlRecord newRecord;
+				recrawlFileStream >> urlHash;
+				newRecord.readFromStream(recrawlFileStream);
+				mRecords.insert(urlHash, newRecord);
+			}
+			qInfo() << "Recrawl metadata has been loaded successfully:" << mRecords.size() << "new records.";
+		}
+		else
+		{
+			qWarning() << "Unknown file version. Cannot load data from:" << recrawlFilePath;
+		}
+		recrawlFile.close();
+	}
+	else
+	{
+		qWarning() << "Failed to open" << recrawlFilePath << "for reading";
+	}
+}
@@ -0,0 +1,65 @@
+#ifndef RECRAWL_SCHEDULER_HPP
+#define RECRAWL_SCHEDULER_HPP
+
+#include <QObject>
+#include <QUrl>
+#include <QHash>
+#include <QSet>
+#include <QList>
+#include <QPair>
+#include <QDataStream>
+#include <QRecursiveMutex>
+#include <QNetworkAccessManager>
+
+struct RecrawlRecord
+{
+	static constexpr int HISTORY_LENGTH_MAX=16;
+	QUrl url;
+	qint64 firstFetchTime;
+	qint64 lastFetchTime;
+	qint64 lastModifiedHint;
+	QByteArray eTag;
+	QByteArray lastModified;
+	QList<QPair<qint64, QByteArray>> contentHashHistory;
+	quint32 visits;
+	quint32 changes;
+	RecrawlRecord();
+	void writeToStream(QDataStream &stream) const;
+	void readFromStream(QDataStream &stream);
+};
+
+class RecrawlScheduler : public QObject
+{
+	Q_OBJECT
+	mutable QRecursiveMutex mRecordsMutex;
+	QHash<QByteArray, RecrawlRecord> mRecords;
+	QSet<QByteArray> mURLHashesInFlight;
+	QNetworkAccessManager *mNetworkManager;
+	QString mDatabaseDirectory;
+	double mDefaultChangeRate;
+	quint64 mProbesNotModified;
+	quint64 mProbesModified;
+public:
+	RecrawlScheduler(QObject *parent=nullptr);
+	void setDatabaseDirectory(const QString &database_directory);
+	void setDefaultRecrawlInterval(qint64 seconds);
+	bool contains(const QByteArray &url_hash) const;
+	QList<QByteArray> knownURLHashes() const;
+	bool recordFetch(const QByteArray &url_hash, const QUrl &url, const QByteArray &content_hash);
+	void recordNotModified(const QByteArray &url_hash);
+	void recordFetchFailed(const QByteArray &url_hash);
+	void setLastModifiedHint(const QByteArray &url_hash, const QUrl &url, qint64 last_modified);
+	double changeRate(const RecrawlRecord &record) const;
+	double revisitPriority(const RecrawlRecord &record, qint64 now) const;
+	QList<QUrl> takeDueURLs(int count, double min_priority);
+	void probe(const QUrl &url, const QByteArray &url_hash);
+	quint64 probesNotModified() const;
+	quint64 probesModified() const;
+public slots:
+	void save();
+	void load();
+signals:
+	void probeFinished(QUrl url, bool modified);
+};
+
+#endif // RECRAWL_SCHEDULER_HPP
@@ -0,0 +1,140 @@
+#include <QHash>
+#include <QDebug>
+#include "request_interceptor.hpp"
+
+static const QHash<QString, int> &resourceTypesByName()
+{
+	static const QHash<QString, int> types=
+	{
+		{"subframe", QWebEngineUrlRequestInfo::ResourceTypeSubFrame},
+		{"stylesheet", QWebEngineUrlRequestInfo::ResourceTypeStylesheet},
+		{"script", QWebEngineUrlRequestInfo::ResourceTypeScript},
+		{"image", QWebEngineUrlRequestInfo::ResourceTypeImage},
+		{"font", QWebEngineUrlRequestInfo::ResourceTypeFontResource},
+		{"subresource", QWebEngineUrlRequestInfo::ResourceTypeSubResource},
+		{"object", QWebEngineUrlRequestInfo::ResourceTypeObject},
+		{"media", QWebEngineUrlRequestInfo::ResourceTypeMedia},
+		{"worker", QWebEngineUrlRequestInfo::ResourceTypeWorker},
+		{"shared_worker", QWebEngineUrlRequestInfo::ResourceTypeSharedWorker},
+		{"prefetch", QWebEngineUrlRequestInfo::ResourceTypePrefetch},
+		{"favicon", QWebEngineUrlRequestInfo::ResourceTypeFavicon},
+		{"xhr", QWebEngineUrlRequestInfo::ResourceTypeXhr},
+		{"ping", QWebEngineUrlRequestInfo::ResourceTypePing},
+		{"service_worker", QWebEngineUrlRequestInfo::ResourceTypeServiceWorker},
+		{"csp_report", QWebEngineUrlRequestInfo::ResourceTypeCspReport},
+		{"plugin_resource", QWebEngineUrlRequestInfo::ResourceTypePluginResource}
+	};
+	return types;
+}
+
+RequestInterceptor::RequestInterceptor(QObject *parent) : QWebEngineUrlRequestInterceptor(parent)
+{
+	resetStatistics();
+}
+
+bool RequestInterceptor::isHostBlocked(const QString &host) const
+{
+	if(host.isEmpty())
+	{
+		return false;
+	}
+	if(mBlockedHostsExact.contains(host))
+	{
+		return true;
+	}
+	for(const QString &suffix : mBlockedHostsSuffixes)
+	{
+		if(host.endsWith(suffix))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void RequestInterceptor::interceptRequest(QWebEngineUrlRequestInfo &info)
+{
+	QWebEngineUrlRequestInfo::ResourceType resourceType=info.resourceType();
+	if(resourceType==QWebEngineUrlRequestInfo::ResourceTypeMainFrame)
+	{
+		mRequestsAllowed++;
+		return;
+	}
+	if(mBlockedResourceTypes.contains(resourceType))
+	{
+		info.block(true);
+		mRequestsBlocked++;
+		mRequestsBlockedByType++;
+		return;
+	}
+	if(isHostBlocked(info.requestUrl().host()))
+	{
+		info.block(true);
+		mRequestsBlocked++;
+		mRequestsBlockedByHost++;
+		return;
+	}
+	mRequestsAllowed++;
+}
+
+void RequestInterceptor::setBlockedResourceTypes(const QStringList &resource_types)
+{
+	mBlockedResourceTypes.clear();
+	for(const QString &resourceTypeName : resource_types)
+	{
+		QHash<QString, int>::const_iterator typeIt=resourceTypesByName().constFind(resourceTypeName);
+		if(typeIt!=resourceTypesByName().constEnd())
+		{
+			mBlockedResourceTypes.insert(typeIt.value());
+		}
+		else
+		{
+			qWarning() << "Unknown resource type:" << resourceTypeName;
+		}
+	}
+}
+
+void RequestInterceptor::setBlockedHosts(const QStringList &host_patterns)
+{
+	mBlockedHostsExact.clear();
+	mBlockedHostsSuffixes.clear();
+	for(const QString &hostPattern : host_patterns)
+	{
+		if(hostPattern.startsWith("*."))
+		{
+			mBlockedHostsSuffixes.append(hostPattern.mid(1));
+		}
+		else if(!hostPattern.isEmpty())
+		{
+			mBlockedHostsExact.insert(hostPattern);
+		}
+	}
+}
+
+void RequestInterceptor::resetStatistics()
+{
+	mRequestsAllowed=0;
+	mRequestsBlocked=0;
+	mRequestsBlockedByType=0;
+	mRequestsBlockedByHost=0;
+}
+
+quint64 RequestInterceptor::requestsAllowed() const
+{
+	return mRequestsAllowed;
+}
+
+quint64 RequestInterceptor::requestsBlocked() const
+{
+	return mRequestsBlocked;
+}
+
+quint64 RequestInterceptor::requestsBlockedByType() const
+{
+	return mRequestsBlockedByType;
+}
+
+quint64 RequestInterceptor::requestsBlockedByHost() const
+{
+	return mRequestsBlockedByHost;
+}
@@ -0,0 +1,31 @@
+#ifndef REQUEST_INTERCEPTOR_HPP
+#define REQUEST_INTERCEPTOR_HPP
+
+#include <QWebEngineUrlRequestInterceptor>
+#include <QStringList>
+#include <QSet>
+
+class RequestInterceptor : public QWebEngineUrlRequestInterceptor
+{
+	Q_OBJECT
+	QSet<int> mBlockedResourceTypes;
+	QSet<QString> mBlockedHostsExact;
+	QStringList mBlockedHostsSuffixes;
+	quint64 mRequestsAllowed;
+	quint64 mRequestsBlocked;
+	quint64 mRequestsBlockedByType;
+	quint64 mRequestsBlockedByHost;
+	bool isHostBlocked(const QString &host) const;
+public:
+	RequestInterceptor(QObject *parent=nullptr);
+	void interceptRequest(QWebEngineUrlRequestInfo &info) override;
+	void setBlockedResourceTypes(const QStringList &resource_types);
+	void setBlockedHosts(const QStringList &host_patterns);
+	void resetStatistics();
+	quint64 requestsAllowed() const;
+	quint64 requestsBlocked() const;
+	quint64 requestsBlockedByType() const;
+	quint64 requestsBlockedByHost() const;
+};
+
+#endif // REQUEST_INTERCEPTOR_HPP
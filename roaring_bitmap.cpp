@@ -0,0 +1,259 @@
+#include <algorithm>
+#include <iterator>
+#include "roaring_bitmap.hpp"
+
+bool RoaringBitmap::Container::isBitmap() const
+{
+	return !bitmap.empty();
+}
+
+bool RoaringBitmap::Container::contains(uint16_t low) const
+{
+	if(isBitmap())
+	{
+		return (bitmap[low>>6]>>(low & 63)) & 1;
+	}
+	return std::binary_search(array.begin(), array.end(), low);
+}
+
+bool RoaringBitmap::Container::add(uint16_t low)
+{
+	if(isBitmap())
+	{
+		uint64_t mask=uint64_t(1)<<(low & 63);
+		if(bitmap[low>>6] & mask)
+		{
+			return false;
+		}
+		bitmap[low>>6]|=mask;
+		cardinality++;
+		return true;
+	}
+	std::vector<uint16_t>::iterator it=std::lower_bound(array.begin(), array.end(), low);
+	if(it!=array.end() && *it==low)
+	{
+		return false;
+	}
+	array.insert(it, low);
+	cardinality++;
+	if(cardinality>ARRAY_CONTAINER_MAX)
+	{
+		toBitmap();
+	}
+	return true;
+}
+
+bool RoaringBitmap::Container::remove(uint16_t low)
+{
+	if(isBitmap())
+	{
+		uint64_t mask=uint64_t(1)<<(low & 63);
+		if(!(bitmap[low>>6] & mask))
+		{
+			return false;
+		}
+		bitmap[low>>6]&=~mask;
+		cardinality--;
+		if(cardinality<=ARRAY_CONTAINER_MAX/2)
+		{
+			toArray();
+		}
+		return true;
+	}
+	std::vector<uint16_t>::iterator it=std::lower_bound(array.begin(), array.end(), low);
+	if(it==array.end() || *it!=low)
+	{
+		return false;
+	}
+	array.erase(it);
+	cardinality--;
+	return true;
+}
+
+void RoaringBitmap::Container::toBitmap()
+{
+	bitmap.assign(BITMAP_CONTAINER_WORDS, 0);
+	for(uint16_t low : array)
+	{
+		bitmap[low>>6]|=uint64_t(1)<<(low & 63);
+	}
+	array.clear();
+	array.shrink_to_fit();
+}
+
+void RoaringBitmap::Container::toArray()
+{
+	array.clear();
+	array.reserve(cardinality);
+	for(uint32_t word=0; word<BITMAP_CONTAINER_WORDS; word++)
+	{
+		uint64_t bits=bitmap[word];
+		while(bits!=0)
+		{
+			array.push_back(uint16_t(word*64+uint32_t(__builtin_ctzll(bits))));
+			bits&=bits-1;
+		}
+	}
+	bitmap.clear();
+	bitmap.shrink_to_fit();
+}
+
+size_t RoaringBitmap::findContainer(uint16_t key) const
+{
+	size_t low=0, high=mContainers.size();
+	while(low<high)
+	{
+		size_t middle=(low+high)/2;
+		if(mContainers[middle].key<key)
+		{
+			low=middle+1;
+		}
+		else
+		{
+			high=middle;
+		}
+	}
+	return low;
+}
+
+bool RoaringBitmap::add(uint32_t value)
+{
+	uint16_t key=uint16_t(value>>16);
+	size_t index=findContainer(key);
+	if(index==mContainers.size() || mContainers[index].key!=key)
+	{
+		Container container;
+		container.key=key;
+		container.cardinality=0;
+		mContainers.insert(mContainers.begin()+index, std::move(container));
+	}
+	return mContainers[index].add(uint16_t(value));
+}
+
+bool RoaringBitmap::remove(uint32_t value)
+{
+	uint16_t key=uint16_t(value>>16);
+	size_t index=findContainer(key);
+	if(index==mContainers.size() || mContainers[index].key!=key)
+	{
+		return false;
+	}
+	if(!mContainers[index].remove(uint16_t(value)))
+	{
+		return false;
+	}
+	if(mContainers[index].cardinality==0)
+	{
+		mContainers.erase(mContainers.begin()+index);
+	}
+	return true;
+}
+
+bool RoaringBitmap::contains(uint32_t value) const
+{
+	uint16_t key=uint16_t(value>>16);
+	size_t index=findContainer(key);
+	if(index==mContainers.size() || mContainers[index].key!=key)
+	{
+		return false;
+	}
+	return mContainers[index].contains(uint16_t(value));
+}
+
+uint64_t RoaringBitmap::cardinality() const
+{
+	uint64_t result=0;
+	for(const Container &container : mContainers)
+	{
+		result+=container.cardinality;
+	}
+	return result;
+}
+
+bool RoaringBitmap::isEmpty() const
+{
+	return mContainers.empty();
+}
+
+void RoaringBitmap::clear()
+{
+	mContainers.clear();
+}
+
+size_t RoaringBitmap::sizeInBytes() const
+{
+	size_t result=sizeof(RoaringBitmap);
+	for(const Container &container : mContainers)
+	{
+		result+=sizeof(Container)+container.array.capacity()*sizeof(uint16_t)+container.bitmap.capacity()*sizeof(uint64_t);
+	}
+	return result;
+}
+
+RoaringBitmap::Container RoaringBitmap::intersect(const Container &a, const Container &b)
+{
+	Container result;
+	result.key=a.key;
+	result.cardinality=0;
+	if(a.isBitmap() && b.isBitmap())
+	{
+		result.bitmap.resize(BITMAP_CONTAINER_WORDS);
+		for(uint32_t word=0; word<BITMAP_CONTAINER_WORDS; word++)
+		{
+			result.bitmap[word]=a.bitmap[word] & b.bitmap[word];
+			result.cardinality+=uint32_t(__builtin_popcountll(result.bitmap[word]));
+		}
+		if(result.cardinality<=ARRAY_CONTAINER_MAX)
+		{
+			result.toArray();
+		}
+	}
+	else if(a.isBitmap() || b.isBitmap())
+	{
+		const Container &sparse=a.isBitmap() ? b : a;
+		const Container &dense=a.isBitmap() ? a : b;
+		for(uint16_t low : sparse.array)
+		{
+			if(dense.contains(low))
+			{
+				result.array.push_back(low);
+			}
+		}
+		result.cardinality=uint32_t(result.array.size());
+	}
+	else
+	{
+		std::set_intersection(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(), std::back_inserter(result.array));
+		result.cardinality=uint32_t(result.array.size());
+	}
+	return result;
+}
+
+RoaringBitmap &RoaringBitmap::operator&=(const RoaringBitmap &other)
+{
+	std::vector<Container> result;
+	size_t i=0, j=0;
+	while(i<mContainers.size() && j<other.mContainers.size())
+	{
+		if(mContainers[i].key<other.mContainers[j].key)
+		{
+			i++;
+		}
+		else if(mContainers[i].key>other.mContainers[j].key)
+		{
+			j++;
+		}
+		else
+		{
+			Container container=intersect(mContainers[i], other.mContainers[j]);
+			if(container.cardinality>0)
+			{
+				result.push_back(std::move(container));
+			}
+			i++;
+			j++;
+		}
+	}
+	mContainers.swap(result);
+	return *this;
+}
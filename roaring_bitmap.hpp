@@ -0,0 +1,68 @@
+#ifndef ROARING_BITMAP_HPP
+#define ROARING_BITMAP_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// Compressed set of 32-bit document ids in the Roaring layout: ids are
+// bucketed by their high 16 bits, and every bucket holds its low 16 bits
+// either as a sorted array (sparse) or as a 65536-bit bitmap (dense).
+class RoaringBitmap
+{
+	static constexpr uint32_t ARRAY_CONTAINER_MAX=4096;
+	static constexpr uint32_t BITMAP_CONTAINER_WORDS=65536/64;
+	struct Container
+	{
+		uint16_t key;
+		uint32_t cardinality;
+		std::vector<uint16_t> array;
+		std::vector<uint64_t> bitmap;
+		bool isBitmap() const;
+		bool contains(uint16_t low) const;
+		bool add(uint16_t low);
+		bool remove(uint16_t low);
+		void toBitmap();
+		void toArray();
+	};
+	std::vector<Container> mContainers;
+	size_t findContainer(uint16_t key) const;
+	static Container intersect(const Container &a, const Container &b);
+public:
+	bool add(uint32_t value);
+	bool remove(uint32_t value);
+	bool contains(uint32_t value) const;
+	uint64_t cardinality() const;
+	bool isEmpty() const;
+	void clear();
+	size_t sizeInBytes() const;
+	RoaringBitmap &operator&=(const RoaringBitmap &other);
+	template<typename F> void forEach(F callback) const
+	{
+		for(const Container &container : mContainers)
+		{
+			uint32_t high=uint32_t(container.key)<<16;
+			if(container.isBitmap())
+			{
+				for(uint32_t word=0; word<BITMAP_CONTAINER_WORDS; word++)
+				{
+					uint64_t bits=container.bitmap[word];
+					while(bits!=0)
+					{
+						callback(high | (word*64+uint32_t(__builtin_ctzll(bits))));
+						bits&=bits-1;
+					}
+				}
+			}
+			else
+			{
+				for(uint16_t low : container.array)
+				{
+					callback(high | low);
+				}
+			}
+		}
+	}
+};
+
+#endif // ROARING_BITMAP_HPP
@@ -0,0 +1,423 @@
+#include <QDateTime>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <QXmlStreamReader>
+#include <QDebug>
+#include <algorithm>
+#include "main.hpp"
+#include "robots_cache.hpp"
+
+static constexpr int ROBOTS_TRANSFER_TIMEOUT=10000;
+static constexpr int ROBOTS_UNAVAILABLE_RETRY_INTERVAL=3600;
+static constexpr int SITEMAP_INDEX_DEPTH_MAX=2;
+static constexpr double ROBOTS_CRAWL_DELAY_MAX=3600*1000.0;
+
+// Product token of a user agent: the name before any version or comment,
+// compared case-insensitively (RFC 9309, section 2.2.1).
+static QString robots_product_token(const QString &user_agent)
+{
+	QString token=user_agent.trimmed().toLower();
+	qsizetype tokenEnd=0;
+	while(tokenEnd<token.size() && (token.at(tokenEnd).isLetterOrNumber() || token.at(tokenEnd)=='-' || token.at(tokenEnd)=='_'))
+	{
+		tokenEnd++;
+	}
+	token.truncate(tokenEnd);
+	return token;
+}
+
+void RobotsRuleSet::addRule(const QString &pattern, bool allow)
+{
+	RobotsRule rule;
+	rule.pattern=pattern;
+	rule.allow=allow;
+	rule.hasWildcards=pattern.contains('*') || pattern.endsWith('$');
+	mRules.append(rule);
+}
+
+void RobotsRuleSet::compile()
+{
+	std::stable_sort(mRules.begin(), mRules.end(),
+		[](const RobotsRule &a, const RobotsRule &b)
+		{
+			if(a.pattern.size()!=b.pattern.size())
+			{
+				return a.pattern.size()>b.pattern.size();
+			}
+			return a.allow && !b.allow;
+		});
+}
+
+bool RobotsRuleSet::matchWildcardPattern(const QString &pattern, const QString &path)
+{
+	qsizetype patternLength=pattern.size();
+	bool anchored=pattern.endsWith('$');
+	if(anchored)
+	{
+		patternLength--;
+	}
+	qsizetype i=0, j=0, star=-1, mark=0;
+	while(i<path.size())
+	{
+		if(j==patternLength && !anchored)
+		{
+			return true;
+		}
+		if(j<patternLength && pattern.at(j)=='*')
+		{
+			star=j++;
+			mark=i;
+			continue;
+		}
+		if(j<patternLength && pattern.at(j)==path.at(i))
+		{
+			i++;
+			j++;
+			continue;
+		}
+		if(star>=0)
+		{
+			j=star+1;
+			i=++mark;
+			continue;
+		}
+		return false;
+	}
+	while(j<patternLength && pattern.at(j)=='*')
+	{
+		j++;
+	}
+	return j==patternLength;
+}
+
+bool RobotsRuleSet::isAllowed(const QString &path) const
+{
+	for(const RobotsRule &rule : mRules)
+	{
+		bool matches=rule.hasWildcards ? matchWildcardPattern(rule.pattern, path) : path.startsWith(rule.pattern);
+		if(matches)
+		{
+			return rule.allow;
+		}
+	}
+	return true;
+}
+
+bool RobotsRuleSet::isEmpty() const
+{
+	return mRules.isEmpty();
+}
+
+RobotsRecord::RobotsRecord()
+{
+	expiryTime=0;
+	ready=false;
+	crawlDelay=0;
+	lastFetchTime=0;
+}
+
+RobotsCache::RobotsCache(QObject *parent) : QObject(parent)
+{
+	mNetworkManager=new QNetworkAccessManager(this);
+	mUserAgentToken=robots_product_token(gSettings->robotsUserAgent());
+	mSitemapsRequested=0;
+	mRobotsFetchesPending=0;
+}
+
+QString RobotsCache::originOf(const QUrl &url)
+{
+	return url.adjusted(QUrl::RemovePath | QUrl::RemoveQuery | QUrl::RemoveFragment | QUrl::RemoveUserInfo).toString();
+}
+
+RobotsCache::Verdict RobotsCache::check(const QUrl &url)
+{
+	if(!gSettings->robotsEnabled())
+	{
+		return Allowed;
+	}
+	QString origin=originOf(url);
+	RobotsRecord &record=mRecords[origin];
+	if(!record.ready || record.expiryTime<QDateTime::currentSecsSinceEpoch())
+	{
+		if(record.pendingURLs.isEmpty())
+		{
+			fetchRobots(origin);
+		}
+		record.pendingURLs.append(url);
+		return Pending;
+	}
+	QString path=url.path(QUrl::FullyEncoded);
+	if(path.isEmpty())
+	{
+		path="/";
+	}
+	if(url.hasQuery())
+	{
+		path+='?';
+		path+=url.query(QUrl::FullyEncoded);
+	}
+	return record.rules.isAllowed(path) ? Allowed : Disallowed;
+}
+
+qint64 RobotsCache::crawlDelayRemaining(const QUrl &url) const
+{
+	QHash<QString, RobotsRecord>::const_iterator recordIt=mRecords.constFind(originOf(url));
+	if(recordIt==mRecords.constEnd() || recordIt->crawlDelay<=0)
+	{
+		return 0;
+	}
+	qint64 remaining=recordIt->lastFetchTime+recordIt->crawlDelay-QDateTime::currentMSecsSinceEpoch();
+	return qMax((qint64)0, remaining);
+}
+
+void RobotsCache::recordFetch(const QUrl &url)
+{
+	QHash<QString, RobotsRecord>::iterator recordIt=mRecords.find(originOf(url));
+	if(recordIt!=mRecords.end())
+	{
+		recordIt->lastFetchTime=QDateTime::currentMSecsSinceEpoch();
+	}
+}
+
+bool RobotsCache::hasPendingFetches() const
+{
+	return mRobotsFetchesPending>0;
+}
+
+void RobotsCache::fetchRobots(const QString &origin)
+{
+	mRobotsFetchesPending++;
+	qDebug() << "Fetching robots.txt for" << origin;
+	QNetworkRequest request(QUrl(origin+"/robots.txt"));
+	request.setHeader(QNetworkRequest::UserAgentHeader, gSettings->httpUserAgent());
+	request.setTransferTimeout(ROBOTS_TRANSFER_TIMEOUT);
+	QNetworkReply *reply=mNetworkManager->get(request);
+	connect(reply, &QNetworkReply::finished, this,
+		[this, reply, origin]()
+		{
+			reply->deleteLater();
+			mRobotsFetchesPending--;
+			RobotsRecord &record=mRecords[origin];
+			int statusCode=reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+			qint64 now=QDateTime::currentSecsSinceEpoch();
+			record.rules=RobotsRuleSet();
+			record.sitemaps.clear();
+			record.crawlDelay=0;
+			if(statusCode>=200 && statusCode<300)
+			{
+				parseRobots(record, reply->readAll());
+				record.expiryTime=now+gSettings->robotsCacheTTL();
+			}
+			else if(statusCode>=400 && statusCode<500)
+			{
+				record.expiryTime=now+gSettings->robotsCacheTTL();
+			}
+			else
+			{
+				record.rules.addRule("/", false);
+				record.expiryTime=now+ROBOTS_UNAVAILABLE_RETRY_INTERVAL;
+				qDebug() << "robots.txt unavailable for" << origin << "- host is disallowed until" <<
+					QDateTime::fromSecsSinceEpoch(record.expiryTime).toString();
+			}
+			record.ready=true;
+			QList<QUrl> pendingURLs;
+			pendingURLs.swap(record.pendingURLs);
+			QList<QUrl> releasedURLs;
+			for(const QUrl &pendingURL : pendingURLs)
+			{
+				if(check(pendingURL)==Allowed)
+				{
+					releasedURLs.append(pendingURL);
+				}
+			}
+			if(gSettings->sitemapsEnabled())
+			{
+				const QStringList sitemaps=record.sitemaps;
+				for(const QString &sitemap : sitemaps)
+				{
+					fetchSitemap(QUrl(sitemap), 0);
+				}
+			}
+			if(!releasedURLs.isEmpty())
+			{
+				emit urlsReleased(releasedURLs);
+			}
+		});
+}
+
+void RobotsCache::parseRobots(RobotsRecord &record, const QByteArray &robots_txt) const
+{
+	RobotsRuleSet agentRules, wildcardRules;
+	int agentCrawlDelay=0, wildcardCrawlDelay=0;
+	bool agentGroupFound=false;
+	bool groupMatchesAgent=false, groupMatchesWildcard=false, groupHasRules=false;
+	const QList<QByteArray> lines=robots_txt.split('\n');
+	for(QByteArray line : lines)
+	{
+		qsizetype commentPos=line.indexOf('#');
+		if(commentPos>=0)
+		{
+			line.truncate(commentPos);
+		}
+		qsizetype colonPos=line.indexOf(':');
+		if(colonPos<0)
+		{
+			continue;
+		}
+		QByteArray key=line.left(colonPos).trimmed().toLower();
+		QString value=QString::fromUtf8(line.mid(colonPos+1).trimmed());
+		if(key=="user-agent")
+		{
+			if(groupHasRules)
+			{
+				groupMatchesAgent=false;
+				groupMatchesWildcard=false;
+				groupHasRules=false;
+			}
+			if(value=="*")
+			{
+				groupMatchesWildcard=true;
+			}
+			else if(!mUserAgentToken.isEmpty() && robots_product_token(value)==mUserAgentToken)
+			{
+				groupMatchesAgent=true;
+				agentGroupFound=true;
+			}
+		}
+		else if(key=="allow" || key=="disallow")
+		{
+			groupHasRules=true;
+			if(value.isEmpty())
+			{
+				continue;
+			}
+			if(groupMatchesAgent)
+			{
+				agentRules.addRule(value, key=="allow");
+			}
+			if(groupMatchesWildcard)
+			{
+				wildcardRules.addRule(value, key=="allow");
+			}
+		}
+		else if(key=="crawl-delay")
+		{
+			groupHasRules=true;
+			bool validDelay=false;
+			double crawlDelaySeconds=value.toDouble(&validDelay);
+			if(!validDelay || !qIsFinite(crawlDelaySeconds) || crawlDelaySeconds<0.0)
+			{
+				continue;
+			}
+			int crawlDelay=qMin(crawlDelaySeconds*1000.0, ROBOTS_CRAWL_DELAY_MAX);
+			if(groupMatchesAgent)
+			{
+				agentCrawlDelay=crawlDelay;
+			}
+			if(groupMatchesWildcard)
+			{
+				wildcardCrawlDelay=crawlDelay;
+			}
+		}
+		else if(key=="sitemap")
+		{
+			if(!value.isEmpty())
+			{
+				record.sitemaps.append(value);
+			}
+		}
+	}
+	record.rules=agentGroupFound ? agentRules : wildcardRules;
+	record.rules.compile();
+	record.crawlDelay=agentGroupFound ? agentCrawlDelay : wildcardCrawlDelay;
+}
+
+void RobotsCache::fetchSitemap(const QUrl &sitemap_url, int depth)
+{
+	if(!sitemap_url.isValid() || mSitemapsRequested>=gSettings->sitemapsPerSession())
+	{
+		return;
+	}
+	mSitemapsRequested++;
+	qDebug() << "Fetching sitemap" << sitemap_url.toString();
+	QNetworkRequest request(sitemap_url);
+	request.setHeader(QNetworkRequest::UserAgentHeader, gSettings->httpUserAgent());
+	request.setTransferTimeout(ROBOTS_TRANSFER_TIMEOUT);
+	QNetworkReply *reply=mNetworkManager->get(request);
+	connect(reply, &QNetworkReply::finished, this,
+		[this, reply, depth]()
+		{
+			reply->deleteLater();
+			int statusCode=reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+			if(statusCode>=200 && statusCode<300)
+			{
+				parseSitemap(reply->readAll(), depth);
+			}
+		});
+}
+
+void RobotsCache::parseSitemap(const QByteArray &sitemap_xml, int depth)
+{
+	QXmlStreamReader xml(sitemap_xml);
+	QList<QUrl> urls;
+	QList<qint64> lastModified;
+	QList<QUrl> nestedSitemaps;
+	QString location;
+	qint64 locationLastModified=0;
+	bool insideSitemapIndex=false;
+	while(!xml.atEnd())
+	{
+		QXmlStreamReader::TokenType token=xml.readNext();
+		if(token==QXmlStreamReader::StartElement)
+		{
+			if(xml.name()==QLatin1String("sitemapindex"))
+			{
+				insideSitemapIndex=true;
+			}
+			else if(xml.name()==QLatin1String("url") || xml.name()==QLatin1String("sitemap"))
+			{
+				location.clear();
+				locationLastModified=0;
+			}
+			else if(xml.name()==QLatin1String("loc"))
+			{
+				location=xml.readElementText().trimmed();
+			}
+			else if(xml.name()==QLatin1String("lastmod"))
+			{
+				QDateTime lastModifiedTime=QDateTime::fromString(xml.readElementText().trimmed(), Qt::ISODate);
+				if(lastModifiedTime.isValid())
+				{
+					locationLastModified=lastModifiedTime.toSecsSinceEpoch();
+				}
+			}
+		}
+		else if(token==QXmlStreamReader::EndElement && !location.isEmpty())
+		{
+			if(xml.name()==QLatin1String("url"))
+			{
+				urls.append(QUrl(location));
+				lastModified.append(locationLastModified);
+			}
+			else if(xml.name()==QLatin1String("sitemap") && insideSitemapIndex)
+			{
+				nestedSitemaps.append(QUrl(location));
+			}
+		}
+	}
+	if(xml.hasError())
+	{
+		qDebug() << "Sitemap parsing error:" << xml.errorString();
+	}
+	if(depth<SITEMAP_INDEX_DEPTH_MAX)
+	{
+		for(const QUrl &nestedSitemap : nestedSitemaps)
+		{
+			fetchSitemap(nestedSitemap, depth+1);
+		}
+	}
+	if(!urls.isEmpty())
+	{
+		emit sitemapEntriesFound(urls, lastModified);
+	}
+}
@@ -0,0 +1,71 @@
+#ifndef ROBOTS_CACHE_HPP
+#define ROBOTS_CACHE_HPP
+
+#include <QObject>
+#include <QUrl>
+#include <QHash>
+#include <QList>
+#include <QStringList>
+#include <QNetworkAccessManager>
+
+struct RobotsRule
+{
+	QString pattern;
+	bool allow;
+	bool hasWildcards;
+};
+
+class RobotsRuleSet
+{
+	QList<RobotsRule> mRules;
+	static bool matchWildcardPattern(const QString &pattern, const QString &path);
+public:
+	void addRule(const QString &pattern, bool allow);
+	void compile();
+	bool isAllowed(const QString &path) const;
+	bool isEmpty() const;
+};
+
+struct RobotsRecord
+{
+	qint64 expiryTime;
+	bool ready;
+	int crawlDelay;
+	qint64 lastFetchTime;
+	RobotsRuleSet rules;
+	QStringList sitemaps;
+	QList<QUrl> pendingURLs;
+	RobotsRecord();
+};
+
+class RobotsCache : public QObject
+{
+	Q_OBJECT
+	QHash<QString, RobotsRecord> mRecords;
+	QNetworkAccessManager *mNetworkManager;
+	QString mUserAgentToken;
+	int mSitemapsRequested;
+	int mRobotsFetchesPending;
+	static QString originOf(const QUrl &url);
+	void fetchRobots(const QString &origin);
+	void fetchSitemap(const QUrl &sitemap_url, int depth);
+	void parseRobots(RobotsRecord &record, const QByteArray &robots_txt) const;
+	void parseSitemap(const QByteArray &sitemap_xml, int depth);
+public:
+	enum Verdict
+	{
+		Allowed,
+		Disallowed,
+		Pending
+	};
+	RobotsCache(QObject *parent=nullptr);
+	Verdict check(const QUrl &url);
+	qint64 crawlDelayRemaining(const QUrl &url) const;
+	void recordFetch(const QUrl &url);
+	bool hasPendingFetches() const;
+signals:
+	void urlsReleased(QList<QUrl> urls);
+	void sitemapEntriesFound(QList<QUrl> urls, QList<qint64> last_modified);
+};
+
+#endif // ROBOTS_CACHE_HPP
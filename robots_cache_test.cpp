@@ -0,0 +1,167 @@
+#include <QTest>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include "main.hpp"
+#include "robots_cache.hpp"
+
+ConfigurationKeeper *gSettings;
+
+static constexpr int ROBOTS_FETCH_TIMEOUT=5000;
+
+// Serves one robots.txt body on 127.0.0.1, answering every request with it.
+class RobotsFixtureServer : public QTcpServer
+{
+	QByteArray mRobotsTxt;
+public:
+	RobotsFixtureServer(const QByteArray &robots_txt) : mRobotsTxt(robots_txt)
+	{
+		connect(this, &QTcpServer::newConnection, this, [this]()
+			{
+				while(hasPendingConnections())
+				{
+					QTcpSocket *socket=nextPendingConnection();
+					connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+					connect(socket, &QTcpSocket::readyRead, socket, [this, socket]()
+						{
+							socket->setProperty("request", socket->property("request").toByteArray()+socket->readAll());
+							if(!socket->property("request").toByteArray().contains("\r\n\r\n"))
+							{
+								return;
+							}
+							socket->write("HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nConnection: close\r\nContent-Length: "+
+								QByteArray::number(mRobotsTxt.size())+"\r\n\r\n"+mRobotsTxt);
+							socket->disconnectFromHost();
+						});
+				}
+			});
+		listen(QHostAddress::LocalHost);
+	}
+	QUrl url(const QString &path) const
+	{
+		return QUrl(QString("http://127.0.0.1:%1%2").arg(serverPort()).arg(path));
+	}
+};
+
+class RobotsCacheTest : public QObject
+{
+	Q_OBJECT
+	// Asks for url once so its robots.txt is fetched, then waits for the fetch.
+	static void fetchRobots(RobotsCache &cache, const QUrl &url)
+	{
+		if(cache.check(url)==RobotsCache::Pending)
+		{
+			QTRY_VERIFY_WITH_TIMEOUT(!cache.hasPendingFetches(), ROBOTS_FETCH_TIMEOUT);
+		}
+	}
+private slots:
+	void initTestCase()
+	{
+		gSettings=new ConfigurationKeeper();
+		gSettings->setRobotsUserAgent("Seeklet");
+		gSettings->setSitemapsEnabled(false);
+	}
+
+	void agentGroupSelection()
+	{
+		RobotsFixtureServer server(
+			"User-agent: e\n"
+			"Disallow: /\n"
+			"\n"
+			"User-agent: bot\n"
+			"Disallow: /\n"
+			"\n"
+			"User-agent: *\n"
+			"Disallow: /private\n");
+		QVERIFY(server.isListening());
+		RobotsCache cache;
+		fetchRobots(cache, server.url("/"));
+		QCOMPARE(cache.check(server.url("/public")), RobotsCache::Allowed);
+		QCOMPARE(cache.check(server.url("/private/page")), RobotsCache::Disallowed);
+	}
+
+	void productTokenGroup()
+	{
+		RobotsFixtureServer server(
+			"User-agent: *\n"
+			"Disallow: /\n"
+			"\n"
+			"User-agent: SEEKLET/2.0\n"
+			"Disallow: /seeklet-only\n");
+		QVERIFY(server.isListening());
+		RobotsCache cache;
+		fetchRobots(cache, server.url("/"));
+		QCOMPARE(cache.check(server.url("/public")), RobotsCache::Allowed);
+		QCOMPARE(cache.check(server.url("/seeklet-only")), RobotsCache::Disallowed);
+	}
+
+	void longestMatch()
+	{
+		RobotsFixtureServer server(
+			"User-agent: seeklet\n"
+			"Disallow: /a\n"
+			"Allow: /a/b\n"
+			"Disallow: /a/b/c\n"
+			"Disallow: /*.pdf$\n"
+			"Allow: /same\n"
+			"Disallow: /same\n");
+		QVERIFY(server.isListening());
+		RobotsCache cache;
+		fetchRobots(cache, server.url("/"));
+		QCOMPARE(cache.check(server.url("/a/x")), RobotsCache::Disallowed);
+		QCOMPARE(cache.check(server.url("/a/b/x")), RobotsCache::Allowed);
+		QCOMPARE(cache.check(server.url("/a/b/c/x")), RobotsCache::Disallowed);
+		QCOMPARE(cache.check(server.url("/docs/file.pdf")), RobotsCache::Disallowed);
+		QCOMPARE(cache.check(server.url("/docs/file.pdf.html")), RobotsCache::Allowed);
+		QCOMPARE(cache.check(server.url("/same")), RobotsCache::Allowed);
+	}
+
+	void crawlDelay()
+	{
+		RobotsFixtureServer server(
+			"User-agent: *\n"
+			"Crawl-delay: 10\n"
+			"\n"
+			"User-agent: seeklet\n"
+			"Crawl-delay: 2\n");
+		QVERIFY(server.isListening());
+		RobotsCache cache;
+		const QUrl url=server.url("/page");
+		fetchRobots(cache, url);
+		QCOMPARE(cache.check(url), RobotsCache::Allowed);
+		QCOMPARE(cache.crawlDelayRemaining(url), qint64(0));
+		cache.recordFetch(url);
+		qint64 remaining=cache.crawlDelayRemaining(url);
+		QVERIFY(remaining>1000);
+		QVERIFY(remaining<=2000);
+	}
+
+	void crawlDelayLimits()
+	{
+		RobotsFixtureServer server(
+			"User-agent: *\n"
+			"Crawl-delay: 2\n"
+			"Crawl-delay: -1\n"
+			"Crawl-delay: nan\n"
+			"Crawl-delay: soon\n");
+		QVERIFY(server.isListening());
+		RobotsCache cache;
+		const QUrl url=server.url("/page");
+		fetchRobots(cache, url);
+		cache.recordFetch(url);
+		QVERIFY(cache.crawlDelayRemaining(url)>1000);
+		QVERIFY(cache.crawlDelayRemaining(url)<=2000);
+
+		RobotsFixtureServer hugeDelayServer(
+			"User-agent: *\n"
+			"Crawl-delay: 1e30\n");
+		QVERIFY(hugeDelayServer.isListening());
+		const QUrl hugeDelayUrl=hugeDelayServer.url("/page");
+		fetchRobots(cache, hugeDelayUrl);
+		cache.recordFetch(hugeDelayUrl);
+		QVERIFY(cache.crawlDelayRemaining(hugeDelayUrl)>3599*1000);
+		QVERIFY(cache.crawlDelayRemaining(hugeDelayUrl)<=3600*1000);
+	}
+};
+
+QTEST_GUILESS_MAIN(RobotsCacheTest)
+#include "robots_cache_test.moc"
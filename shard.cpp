@@ -0,0 +1,68 @@
+#include <QCoreApplication>
+#include <QDebug>
+#include "main.hpp"
+#include "indexer.hpp"
+#include "util.hpp"
+
+ConfigurationKeeper *gSettings;
+
+static int usage()
+{
+	qWarning() << "Usage: seeklet-shard export [--host HOST] [--from TIME] [--to TIME] [--terms-from TERM] [--terms-to TERM] shard_file [database_directory]";
+	qWarning() << "       seeklet-shard import shard_file [database_directory]";
+	qWarning() << "TIME is in ISO 8601 format, term ranges compare index term keys.";
+	return 2;
+}
+
+int main(int argc, char **argv)
+{
+	QCoreApplication shardApp(argc, argv);
+	gSettings=new ConfigurationKeeper();
+	gSettings->loadSettingsFromJsonFile("crawler.json");
+
+	QStringList arguments=shardApp.arguments().mid(1);
+	if(arguments.isEmpty() || (arguments.first()!="export" && arguments.first()!="import"))
+	{
+		return usage();
+	}
+	bool exportShard=(arguments.takeFirst()=="export");
+	ShardFilter filter;
+	if(exportShard)
+	{
+		QString from, to, termsFrom, termsTo;
+		if(!take_option(arguments, "--host", filter.host) || !take_option(arguments, "--from", from) || !take_option(arguments, "--to", to) ||
+			!take_option(arguments, "--terms-from", termsFrom) || !take_option(arguments, "--terms-to", termsTo))
+		{
+			return usage();
+		}
+		filter.from=QDateTime::fromString(from, Qt::ISODate);
+		filter.to=QDateTime::fromString(to, Qt::ISODate);
+		if((!from.isEmpty() && !filter.from.isValid()) || (!to.isEmpty() && !filter.to.isValid()))
+		{
+			return usage();
+		}
+		filter.termsFrom=termsFrom.toUtf8();
+		filter.termsTo=termsTo.toUtf8();
+	}
+	if(arguments.isEmpty() || arguments.size()>2 || arguments.first().startsWith("-") || (arguments.size()==2 && arguments.last().startsWith("-")))
+	{
+		return usage();
+	}
+	Indexer indexer;
+	if(arguments.size()==2)
+	{
+		indexer.setDatabaseDirectory(arguments.last());
+	}
+	indexer.load();
+	if(exportShard)
+	{
+		return indexer.exportShard(arguments.first(), filter) ? 0 : 1;
+	}
+	if(!indexer.importShard(arguments.first()))
+	{
+		return 1;
+	}
+	QObject::connect(&indexer, &Indexer::saved, &shardApp, &QCoreApplication::quit, Qt::QueuedConnection);
+	indexer.save();
+	return shardApp.exec();
+}
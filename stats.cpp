@@ -0,0 +1,30 @@
+#include <QCoreApplication>
+#include <QDebug>
+#include "main.hpp"
+#include "indexer.hpp"
+#include "util.hpp"
+
+ConfigurationKeeper *gSettings;
+
+int main(int argc, char **argv)
+{
+	QCoreApplication statsApp(argc, argv);
+	gSettings=new ConfigurationKeeper();
+	gSettings->loadSettingsFromJsonFile("crawler.json");
+
+	QStringList arguments=statsApp.arguments().mid(1);
+	int topN=20;
+	if(!take_number_option(arguments, "--top", topN) || arguments.size()>1 || (arguments.size()==1 && arguments.first().startsWith("-")))
+	{
+		qWarning() << "Usage: seeklet-stats [--top N] [database_directory]";
+		return 1;
+	}
+	Indexer indexer;
+	if(!arguments.isEmpty())
+	{
+		indexer.setDatabaseDirectory(arguments.first());
+	}
+	indexer.load();
+	indexer.printStatistics(topN);
+	return 0;
+}
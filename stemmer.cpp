@@ -0,0 +1,672 @@
+#include <string.h>
+#include "stemmer.hpp"
+
+template<typename CharT>
+struct StemmerSuffix
+{
+	const CharT *suffix;
+	const CharT *replacement;
+	int condition;
+};
+
+template<typename CharT, size_t N>
+static int find_longest_suffix(const std::basic_string<CharT> &word, size_t limit, const StemmerSuffix<CharT> (&suffixes)[N])
+{
+	int longest=-1;
+	size_t longestLength=0;
+	for(size_t i=0; i<N; i++)
+	{
+		size_t suffixLength=std::char_traits<CharT>::length(suffixes[i].suffix);
+		if(suffixLength<=longestLength || suffixLength>word.size() || word.size()-suffixLength<limit)
+		{
+			continue;
+		}
+		if(word.compare(word.size()-suffixLength, suffixLength, suffixes[i].suffix)==0)
+		{
+			longest=int(i);
+			longestLength=suffixLength;
+		}
+	}
+	return longest;
+}
+
+template<typename CharT>
+static void replace_suffix(std::basic_string<CharT> &word, const StemmerSuffix<CharT> &suffix)
+{
+	word.resize(word.size()-std::char_traits<CharT>::length(suffix.suffix));
+	word.append(suffix.replacement);
+}
+
+int stemmer_language_from_name(const std::string &name)
+{
+	if(name=="english" || name=="en")
+	{
+		return STEMMER_LANGUAGE_ENGLISH;
+	}
+	if(name=="russian" || name=="ru")
+	{
+		return STEMMER_LANGUAGE_RUSSIAN;
+	}
+	return STEMMER_LANGUAGE_NONE;
+}
+
+// ---- English (Porter2) ----
+
+enum EnglishCondition
+{
+	EN_NONE,
+	EN_R1,
+	EN_R2,
+	EN_SHORT_IED,
+	EN_S,
+	EN_EED,
+	EN_ED,
+	EN_OGI,
+	EN_LI,
+	EN_ION
+};
+
+static const StemmerSuffix<char> ENGLISH_STEP_1A[]=
+{
+	{"sses", "ss", EN_NONE},
+	{"ied", "i", EN_SHORT_IED},
+	{"ies", "i", EN_SHORT_IED},
+	{"us", "us", EN_NONE},
+	{"ss", "ss", EN_NONE},
+	{"s", "", EN_S}
+};
+
+static const StemmerSuffix<char> ENGLISH_STEP_1B[]=
+{
+	{"eed", "ee", EN_EED},
+	{"eedly", "ee", EN_EED},
+	{"ed", "", EN_ED},
+	{"edly", "", EN_ED},
+	{"ing", "", EN_ED},
+	{"ingly", "", EN_ED}
+};
+
+static const StemmerSuffix<char> ENGLISH_STEP_2[]=
+{
+	{"tional", "tion", EN_R1},
+	{"enci", "ence", EN_R1},
+	{"anci", "ance", EN_R1},
+	{"abli", "able", EN_R1},
+	{"entli", "ent", EN_R1},
+	{"izer", "ize", EN_R1},
+	{"ization", "ize", EN_R1},
+	{"ational", "ate", EN_R1},
+	{"ation", "ate", EN_R1},
+	{"ator", "ate", EN_R1},
+	{"alism", "al", EN_R1},
+	{"aliti", "al", EN_R1},
+	{"alli", "al", EN_R1},
+	{"fulness", "ful", EN_R1},
+	{"ousli", "ous", EN_R1},
+	{"ousness", "ous", EN_R1},
+	{"iveness", "ive", EN_R1},
+	{"iviti", "ive", EN_R1},
+	{"biliti", "ble", EN_R1},
+	{"bli", "ble", EN_R1},
+	{"ogi", "og", EN_OGI},
+	{"fulli", "ful", EN_R1},
+	{"lessli", "less", EN_R1},
+	{"li", "", EN_LI}
+};
+
+static const StemmerSuffix<char> ENGLISH_STEP_3[]=
+{
+	{"tional", "tion", EN_R1},
+	{"ational", "ate", EN_R1},
+	{"alize", "al", EN_R1},
+	{"icate", "ic", EN_R1},
+	{"iciti", "ic", EN_R1},
+	{"ical", "ic", EN_R1},
+	{"ful", "", EN_R1},
+	{"ness", "", EN_R1},
+	{"ative", "", EN_R2}
+};
+
+static const StemmerSuffix<char> ENGLISH_STEP_4[]=
+{
+	{"al", "", EN_R2},
+	{"ance", "", EN_R2},
+	{"ence", "", EN_R2},
+	{"er", "", EN_R2},
+	{"ic", "", EN_R2},
+	{"able", "", EN_R2},
+	{"ible", "", EN_R2},
+	{"ant", "", EN_R2},
+	{"ement", "", EN_R2},
+	{"ment", "", EN_R2},
+	{"ent", "", EN_R2},
+	{"ism", "", EN_R2},
+	{"ate", "", EN_R2},
+	{"iti", "", EN_R2},
+	{"ous", "", EN_R2},
+	{"ive", "", EN_R2},
+	{"ize", "", EN_R2},
+	{"ion", "", EN_ION}
+};
+
+static const char *const ENGLISH_EXCEPTIONS[][2]=
+{
+	{"skis", "ski"},
+	{"skies", "sky"},
+	{"dying", "die"},
+	{"lying", "lie"},
+	{"tying", "tie"},
+	{"idly", "idl"},
+	{"gently", "gentl"},
+	{"ugly", "ugli"},
+	{"early", "earli"},
+	{"only", "onli"},
+	{"singly", "singl"},
+	{"sky", "sky"},
+	{"news", "news"},
+	{"howe", "howe"},
+	{"atlas", "atlas"},
+	{"cosmos", "cosmos"},
+	{"bias", "bias"},
+	{"andes", "andes"}
+};
+
+static const char *const ENGLISH_INVARIANTS_AFTER_1A[]=
+{
+	"inning", "outing", "canning", "herring", "earring", "proceed", "exceed", "succeed"
+};
+
+static const char *const ENGLISH_R1_PREFIXES[]=
+{
+	"gener", "commun", "arsen"
+};
+
+static inline bool en_is_vowel(char c)
+{
+	return c=='a' || c=='e' || c=='i' || c=='o' || c=='u' || c=='y';
+}
+
+static inline bool en_is_double(const std::string &word)
+{
+	size_t len=word.size();
+	if(len<2 || word[len-1]!=word[len-2])
+	{
+		return false;
+	}
+	return strchr("bdfgmnprt", word[len-1])!=nullptr;
+}
+
+static bool en_has_vowel(const std::string &word, size_t end)
+{
+	for(size_t i=0; i<end; i++)
+	{
+		if(en_is_vowel(word[i]))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// Short syllable ending right before position end.
+static bool en_is_short_syllable(const std::string &word, size_t end)
+{
+	if(end>=3 && !en_is_vowel(word[end-3]) && en_is_vowel(word[end-2]) && !en_is_vowel(word[end-1]) &&
+		word[end-1]!='w' && word[end-1]!='x' && word[end-1]!='Y')
+	{
+		return true;
+	}
+	return end==2 && en_is_vowel(word[0]) && !en_is_vowel(word[1]);
+}
+
+static size_t en_region_after(const std::string &word, size_t from)
+{
+	size_t i=from;
+	while(i<word.size() && !en_is_vowel(word[i]))
+	{
+		i++;
+	}
+	while(i<word.size() && en_is_vowel(word[i]))
+	{
+		i++;
+	}
+	return i<word.size() ? i+1 : word.size();
+}
+
+template<size_t N>
+static void en_apply_step(std::string &word, const StemmerSuffix<char> (&suffixes)[N], size_t p1, size_t p2)
+{
+	int found=find_longest_suffix(word, 0, suffixes);
+	if(found<0)
+	{
+		return;
+	}
+	const StemmerSuffix<char> &suffix=suffixes[found];
+	size_t start=word.size()-strlen(suffix.suffix);
+	switch(suffix.condition)
+	{
+		case EN_R1:
+			if(start<p1)
+			{
+				return;
+			}
+			break;
+		case EN_R2:
+			if(start<p2)
+			{
+				return;
+			}
+			break;
+		case EN_OGI:
+			if(start<p1 || start==0 || word[start-1]!='l')
+			{
+				return;
+			}
+			break;
+		case EN_LI:
+			if(start<p1 || start==0 || strchr("cdeghkmnrt", word[start-1])==nullptr)
+			{
+				return;
+			}
+			break;
+		case EN_ION:
+			if(start<p2 || start==0 || (word[start-1]!='s' && word[start-1]!='t'))
+			{
+				return;
+			}
+			break;
+		default:
+			break;
+	}
+	replace_suffix(word, suffix);
+}
+
+static void en_finish(std::string &word)
+{
+	for(char &c : word)
+	{
+		if(c=='Y')
+		{
+			c='y';
+		}
+	}
+}
+
+void stem_english(std::string &word)
+{
+	if(word.size()<=2)
+	{
+		return;
+	}
+	for(const auto &exception : ENGLISH_EXCEPTIONS)
+	{
+		if(word==exception[0])
+		{
+			word=exception[1];
+			return;
+		}
+	}
+	if(word[0]=='y')
+	{
+		word[0]='Y';
+	}
+	for(size_t i=1; i<word.size(); i++)
+	{
+		if(word[i]=='y' && en_is_vowel(word[i-1]))
+		{
+			word[i]='Y';
+		}
+	}
+	size_t p1=0;
+	for(const char *prefix : ENGLISH_R1_PREFIXES)
+	{
+		if(word.compare(0, strlen(prefix), prefix)==0)
+		{
+			p1=strlen(prefix);
+			break;
+		}
+	}
+	if(p1==0)
+	{
+		p1=en_region_after(word, 0);
+	}
+	size_t p2=en_region_after(word, p1);
+
+	int found=find_longest_suffix(word, 0, ENGLISH_STEP_1A);
+	if(found>=0)
+	{
+		const StemmerSuffix<char> &suffix=ENGLISH_STEP_1A[found];
+		size_t start=word.size()-strlen(suffix.suffix);
+		if(suffix.condition==EN_SHORT_IED)
+		{
+			word.resize(start);
+			word.append(start>1 ? "i" : "ie");
+		}
+		else if(suffix.condition==EN_S)
+		{
+			if(start>0 && en_has_vowel(word, start-1))
+			{
+				word.resize(start);
+			}
+		}
+		else
+		{
+			replace_suffix(word, suffix);
+		}
+	}
+	for(const char *invariant : ENGLISH_INVARIANTS_AFTER_1A)
+	{
+		if(word==invariant)
+		{
+			en_finish(word);
+			return;
+		}
+	}
+
+	found=find_longest_suffix(word, 0, ENGLISH_STEP_1B);
+	if(found>=0)
+	{
+		const StemmerSuffix<char> &suffix=ENGLISH_STEP_1B[found];
+		size_t start=word.size()-strlen(suffix.suffix);
+		if(suffix.condition==EN_EED)
+		{
+			if(start>=p1)
+			{
+				replace_suffix(word, suffix);
+			}
+		}
+		else if(en_has_vowel(word, start))
+		{
+			word.resize(start);
+			size_t len=word.size();
+			if(len>=2 && (word.compare(len-2, 2, "at")==0 || word.compare(len-2, 2, "bl")==0 || word.compare(len-2, 2, "iz")==0))
+			{
+				word.push_back('e');
+			}
+			else if(en_is_double(word))
+			{
+				word.pop_back();
+			}
+			else if(len==p1 && en_is_short_syllable(word, len))
+			{
+				word.push_back('e');
+			}
+		}
+	}
+
+	size_t len=word.size();
+	if(len>2 && (word[len-1]=='y' || word[len-1]=='Y') && !en_is_vowel(word[len-2]))
+	{
+		word[len-1]='i';
+	}
+
+	en_apply_step(word, ENGLISH_STEP_2, p1, p2);
+	en_apply_step(word, ENGLISH_STEP_3, p1, p2);
+	en_apply_step(word, ENGLISH_STEP_4, p1, p2);
+
+	len=word.size();
+	if(len>0 && word[len-1]=='e')
+	{
+		if(len-1>=p2 || (len-1>=p1 && !en_is_short_syllable(word, len-1)))
+		{
+			word.pop_back();
+		}
+	}
+	else if(len>1 && word[len-1]=='l' && len-1>=p2 && word[len-2]=='l')
+	{
+		word.pop_back();
+	}
+	en_finish(word);
+}
+
+// ---- Russian ----
+
+enum RussianCondition
+{
+	RU_NONE,
+	RU_AFTER_A_YA
+};
+
+static const StemmerSuffix<char16_t> RUSSIAN_PERFECTIVE_GERUND[]=
+{
+	{u"в", u"", RU_AFTER_A_YA},
+	{u"вши", u"", RU_AFTER_A_YA},
+	{u"вшись", u"", RU_AFTER_A_YA},
+	{u"ив", u"", RU_NONE},
+	{u"ивши", u"", RU_NONE},
+	{u"ившись", u"", RU_NONE},
+	{u"ыв", u"", RU_NONE},
+	{u"ывши", u"", RU_NONE},
+	{u"ывшись", u"", RU_NONE}
+};
+
+static const StemmerSuffix<char16_t> RUSSIAN_ADJECTIVE[]=
+{
+	{u"ее", u"", RU_NONE}, {u"ие", u"", RU_NONE}, {u"ые", u"", RU_NONE}, {u"ое", u"", RU_NONE},
+	{u"ими", u"", RU_NONE}, {u"ыми", u"", RU_NONE}, {u"ей", u"", RU_NONE}, {u"ий", u"", RU_NONE},
+	{u"ый", u"", RU_NONE}, {u"ой", u"", RU_NONE}, {u"ем", u"", RU_NONE}, {u"им", u"", RU_NONE},
+	{u"ым", u"", RU_NONE}, {u"ом", u"", RU_NONE}, {u"его", u"", RU_NONE}, {u"ого", u"", RU_NONE},
+	{u"ему", u"", RU_NONE}, {u"ому", u"", RU_NONE}, {u"их", u"", RU_NONE}, {u"ых", u"", RU_NONE},
+	{u"ую", u"", RU_NONE}, {u"юю", u"", RU_NONE}, {u"ая", u"", RU_NONE}, {u"яя", u"", RU_NONE},
+	{u"ою", u"", RU_NONE}, {u"ею", u"", RU_NONE}
+};
+
+static const StemmerSuffix<char16_t> RUSSIAN_PARTICIPLE[]=
+{
+	{u"ем", u"", RU_AFTER_A_YA},
+	{u"нн", u"", RU_AFTER_A_YA},
+	{u"вш", u"", RU_AFTER_A_YA},
+	{u"ющ", u"", RU_AFTER_A_YA},
+	{u"щ", u"", RU_AFTER_A_YA},
+	{u"ивш", u"", RU_NONE},
+	{u"ывш", u"", RU_NONE},
+	{u"ующ", u"", RU_NONE}
+};
+
+static const StemmerSuffix<char16_t> RUSSIAN_REFLEXIVE[]=
+{
+	{u"ся", u"", RU_NONE},
+	{u"сь", u"", RU_NONE}
+};
+
+static const StemmerSuffix<char16_t> RUSSIAN_VERB[]=
+{
+	{u"ла", u"", RU_AFTER_A_YA}, {u"на", u"", RU_AFTER_A_YA}, {u"ете", u"", RU_AFTER_A_YA},
+	{u"йте", u"", RU_AFTER_A_YA}, {u"ли", u"", RU_AFTER_A_YA}, {u"й", u"", RU_AFTER_A_YA},
+	{u"л", u"", RU_AFTER_A_YA}, {u"ем", u"", RU_AFTER_A_YA}, {u"н", u"", RU_AFTER_A_YA},
+	{u"ло", u"", RU_AFTER_A_YA}, {u"но", u"", RU_AFTER_A_YA}, {u"ет", u"", RU_AFTER_A_YA},
+	{u"ют", u"", RU_AFTER_A_YA}, {u"ны", u"", RU_AFTER_A_YA}, {u"ть", u"", RU_AFTER_A_YA},
+	{u"ешь", u"", RU_AFTER_A_YA}, {u"нно", u"", RU_AFTER_A_YA},
+	{u"ила", u"", RU_NONE}, {u"ыла", u"", RU_NONE}, {u"ена", u"", RU_NONE}, {u"ейте", u"", RU_NONE},
+	{u"уйте", u"", RU_NONE}, {u"ите", u"", RU_NONE}, {u"или", u"", RU_NONE}, {u"ыли", u"", RU_NONE},
+	{u"ей", u"", RU_NONE}, {u"уй", u"", RU_NONE}, {u"ил", u"", RU_NONE}, {u"ыл", u"", RU_NONE},
+	{u"им", u"", RU_NONE}, {u"ым", u"", RU_NONE}, {u"ен", u"", RU_NONE}, {u"ило", u"", RU_NONE},
+	{u"ыло", u"", RU_NONE}, {u"ено", u"", RU_NONE}, {u"ят", u"", RU_NONE}, {u"ует", u"", RU_NONE},
+	{u"уют", u"", RU_NONE}, {u"ит", u"", RU_NONE}, {u"ыт", u"", RU_NONE}, {u"ены", u"", RU_NONE},
+	{u"ить", u"", RU_NONE}, {u"ыть", u"", RU_NONE}, {u"ишь", u"", RU_NONE}, {u"ую", u"", RU_NONE},
+	{u"ю", u"", RU_NONE}
+};
+
+static const StemmerSuffix<char16_t> RUSSIAN_NOUN[]=
+{
+	{u"а", u"", RU_NONE}, {u"ев", u"", RU_NONE}, {u"ов", u"", RU_NONE}, {u"ие", u"", RU_NONE},
+	{u"ье", u"", RU_NONE}, {u"е", u"", RU_NONE}, {u"иями", u"", RU_NONE}, {u"ями", u"", RU_NONE},
+	{u"ами", u"", RU_NONE}, {u"еи", u"", RU_NONE}, {u"ии", u"", RU_NONE}, {u"и", u"", RU_NONE},
+	{u"ией", u"", RU_NONE}, {u"ей", u"", RU_NONE}, {u"ой", u"", RU_NONE}, {u"ий", u"", RU_NONE},
+	{u"й", u"", RU_NONE}, {u"иям", u"", RU_NONE}, {u"ям", u"", RU_NONE}, {u"ием", u"", RU_NONE},
+	{u"ем", u"", RU_NONE}, {u"ам", u"", RU_NONE}, {u"ом", u"", RU_NONE}, {u"о", u"", RU_NONE},
+	{u"у", u"", RU_NONE}, {u"ах", u"", RU_NONE}, {u"иях", u"", RU_NONE}, {u"ях", u"", RU_NONE},
+	{u"ы", u"", RU_NONE}, {u"ь", u"", RU_NONE}, {u"ию", u"", RU_NONE}, {u"ью", u"", RU_NONE},
+	{u"ю", u"", RU_NONE}, {u"ия", u"", RU_NONE}, {u"ья", u"", RU_NONE}, {u"я", u"", RU_NONE}
+};
+
+static const StemmerSuffix<char16_t> RUSSIAN_DERIVATIONAL[]=
+{
+	{u"ост", u"", RU_NONE},
+	{u"ость", u"", RU_NONE}
+};
+
+static const StemmerSuffix<char16_t> RUSSIAN_TIDY_UP[]=
+{
+	{u"ейш", u"", RU_NONE},
+	{u"ейше", u"", RU_NONE},
+	{u"н", u"", RU_NONE},
+	{u"ь", u"", RU_NONE}
+};
+
+static inline bool ru_is_vowel(char16_t c)
+{
+	return c==u'а' || c==u'е' || c==u'и' || c==u'о' || c==u'у' || c==u'ы' || c==u'э' || c==u'ю' || c==u'я';
+}
+
+// Removes the longest matching suffix lying within the RV region; suffixes
+// marked RU_AFTER_A_YA must also be preceded by а or я inside RV.
+template<size_t N>
+static bool ru_remove_suffix(std::u16string &word, size_t rv, const StemmerSuffix<char16_t> (&suffixes)[N])
+{
+	int found=find_longest_suffix(word, rv, suffixes);
+	if(found<0)
+	{
+		return false;
+	}
+	size_t start=word.size()-std::char_traits<char16_t>::length(suffixes[found].suffix);
+	if(suffixes[found].condition==RU_AFTER_A_YA)
+	{
+		if(start<=rv || (word[start-1]!=u'а' && word[start-1]!=u'я'))
+		{
+			return false;
+		}
+	}
+	word.resize(start);
+	return true;
+}
+
+void stem_russian(std::u16string &word)
+{
+	for(char16_t &c : word)
+	{
+		if(c==u'ё')
+		{
+			c=u'е';
+		}
+	}
+	size_t len=word.size();
+	size_t rv=len, p2=len;
+	size_t i=0;
+	while(i<len && !ru_is_vowel(word[i]))
+	{
+		i++;
+	}
+	if(i>=len)
+	{
+		return;
+	}
+	rv=++i;
+	while(i<len && ru_is_vowel(word[i]))
+	{
+		i++;
+	}
+	if(i<len)
+	{
+		i++;
+		while(i<len && !ru_is_vowel(word[i]))
+		{
+			i++;
+		}
+		while(i<len && ru_is_vowel(word[i]))
+		{
+			i++;
+		}
+		if(i<len)
+		{
+			p2=i+1;
+		}
+	}
+
+	if(!ru_remove_suffix(word, rv, RUSSIAN_PERFECTIVE_GERUND))
+	{
+		ru_remove_suffix(word, rv, RUSSIAN_REFLEXIVE);
+		if(ru_remove_suffix(word, rv, RUSSIAN_ADJECTIVE))
+		{
+			ru_remove_suffix(word, rv, RUSSIAN_PARTICIPLE);
+		}
+		else if(!ru_remove_suffix(word, rv, RUSSIAN_VERB))
+		{
+			ru_remove_suffix(word, rv, RUSSIAN_NOUN);
+		}
+	}
+
+	if(word.size()>rv && word.back()==u'и')
+	{
+		word.pop_back();
+	}
+
+	int found=find_longest_suffix(word, rv, RUSSIAN_DERIVATIONAL);
+	if(found>=0)
+	{
+		size_t start=word.size()-std::char_traits<char16_t>::length(RUSSIAN_DERIVATIONAL[found].suffix);
+		if(start>=p2)
+		{
+			word.resize(start);
+		}
+	}
+
+	found=find_longest_suffix(word, rv, RUSSIAN_TIDY_UP);
+	if(found==0 || found==1)
+	{
+		word.resize(word.size()-std::char_traits<char16_t>::length(RUSSIAN_TIDY_UP[found].suffix));
+		found=find_longest_suffix(word, rv, RUSSIAN_TIDY_UP);
+		if(found!=2)
+		{
+			return;
+		}
+	}
+	if(found==2)
+	{
+		len=word.size();
+		if(len-1>rv && word[len-2]==u'н')
+		{
+			word.pop_back();
+		}
+	}
+	else if(found==3)
+	{
+		word.pop_back();
+	}
+}
+
+size_t stem_word_utf8(const uint8_t *word, size_t len, int languages, uint8_t *out)
+{
+	bool latin=true, cyrillic=(len%2==0);
+	for(size_t i=0; i<len && (latin || cyrillic); i++)
+	{
+		latin=latin && word[i]>='a' && word[i]<='z';
+	}
+	std::u16string cyrillicWord;
+	for(size_t i=0; i+1<len && cyrillic; i+=2)
+	{
+		char16_t c=char16_t(((word[i] & 0x1F)<<6) | (word[i+1] & 0x3F));
+		cyrillic=(word[i] & 0xE0)==0xC0 && (word[i+1] & 0xC0)==0x80 && ((c>=u'а' && c<=u'я') || c==u'ё');
+		cyrillicWord.push_back(c);
+	}
+	if(latin && (languages & STEMMER_LANGUAGE_ENGLISH))
+	{
+		std::string latinWord((const char *)word, len);
+		stem_english(latinWord);
+		memcpy(out, latinWord.data(), latinWord.size());
+		return latinWord.size();
+	}
+	if(cyrillic && len>0 && (languages & STEMMER_LANGUAGE_RUSSIAN))
+	{
+		stem_russian(cyrillicWord);
+		size_t outLen=0;
+		for(char16_t c : cyrillicWord)
+		{
+			out[outLen++]=uint8_t(0xC0 | (c>>6));
+			out[outLen++]=uint8_t(0x80 | (c & 0x3F));
+		}
+		return outLen;
+	}
+	memcpy(out, word, len);
+	return len;
+}
@@ -0,0 +1,27 @@
+#ifndef STEMMER_HPP
+#define STEMMER_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+// Snowball stemmers (Porter2 English and Snowball Russian) for words already
+// folded to lowercase by count_words().
+
+enum StemmerLanguage
+{
+	STEMMER_LANGUAGE_NONE=0,
+	STEMMER_LANGUAGE_ENGLISH=1,
+	STEMMER_LANGUAGE_RUSSIAN=2
+};
+
+int stemmer_language_from_name(const std::string &name);
+
+void stem_english(std::string &word);
+void stem_russian(std::u16string &word);
+
+// Picks the stemmer by script: pure a-z words go to English, pure а-яё words
+// to Russian, anything else is copied unchanged. out must hold len bytes.
+size_t stem_word_utf8(const uint8_t *word, size_t len, int languages, uint8_t *out);
+
+#endif // STEMMER_HPP
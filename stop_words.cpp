@@ -0,0 +1,51 @@
+#include "stop_words.hpp"
+#include "stemmer.hpp"
+
+static const char *const ENGLISH_STOP_WORDS[]=
+{
+	"about", "above", "after", "again", "against", "all", "and", "any", "are", "aren", "because", "been",
+	"before", "being", "below", "between", "both", "but", "can", "cannot", "could", "couldn", "did", "didn",
+	"does", "doesn", "doing", "don", "down", "during", "each", "few", "for", "from", "further", "had", "hadn",
+	"has", "hasn", "have", "haven", "having", "her", "here", "hers", "herself", "him", "himself", "his", "how",
+	"into", "isn", "its", "itself", "just", "more", "most", "mustn", "myself", "nor", "not", "now", "off",
+	"once", "only", "other", "ought", "our", "ours", "ourselves", "out", "over", "own", "same", "shan", "she",
+	"should", "shouldn", "some", "such", "than", "that", "the", "their", "theirs", "them", "themselves",
+	"then", "there", "these", "they", "this", "those", "through", "too", "under", "until", "very", "was",
+	"wasn", "were", "weren", "what", "when", "where", "which", "while", "who", "whom", "why", "will", "with",
+	"won", "would", "wouldn", "you", "your", "yours", "yourself", "yourselves"
+};
+
+static const char *const RUSSIAN_STOP_WORDS[]=
+{
+	"без", "более", "больше", "будет", "будто", "был", "была", "были", "было", "быть", "вам", "вас",
+	"вдруг", "ведь", "вот", "впрочем", "все", "всегда", "всего", "всех", "всю", "где", "говорил", "даже",
+	"два", "для", "другой", "его", "ее", "её", "ему", "если", "есть", "еще", "ещё", "зачем", "здесь",
+	"или", "иногда", "их", "как", "какая", "какой", "когда", "конечно", "кто", "куда", "лучше", "между",
+	"меня", "мне", "много", "может", "можно", "мой", "моя", "над", "надо", "наконец", "нас", "него",
+	"нее", "неё", "ней", "нельзя", "нет", "нибудь", "никогда", "ним", "них", "ничего", "один", "она",
+	"они", "опять", "перед", "под", "после", "потом", "потому", "почти", "при", "про", "раз", "разве",
+	"свою", "себе", "себя", "сейчас", "сказал", "сказала", "сказать", "совсем", "так", "такой", "там",
+	"тебя", "тем", "теперь", "тогда", "того", "тоже", "только", "том", "тот", "три", "тут", "уже",
+	"хорошо", "хоть", "чего", "чем", "через", "что", "чтоб", "чтобы", "чуть", "эти", "этого", "этой",
+	"этом", "этот", "эту", "это"
+};
+
+QStringList stop_words(int languages)
+{
+	QStringList words;
+	if(languages & STEMMER_LANGUAGE_ENGLISH)
+	{
+		for(const char *word : ENGLISH_STOP_WORDS)
+		{
+			words.append(QString::fromUtf8(word));
+		}
+	}
+	if(languages & STEMMER_LANGUAGE_RUSSIAN)
+	{
+		for(const char *word : RUSSIAN_STOP_WORDS)
+		{
+			words.append(QString::fromUtf8(word));
+		}
+	}
+	return words;
+}
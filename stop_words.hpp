@@ -0,0 +1,9 @@
+#ifndef STOP_WORDS_HPP
+#define STOP_WORDS_HPP
+
+#include <QStringList>
+
+// Snowball stop-word lists; languages is a mask of StemmerLanguage flags.
+QStringList stop_words(int languages);
+
+#endif // STOP_WORDS_HPP
@@ -0,0 +1,263 @@
+#include <cstring>
+#include <algorithm>
+#include <numeric>
+#include "term_dictionary.hpp"
+#include "util.hpp"
+
+static constexpr qsizetype TERM_DICTIONARY_SLOTS_MIN=1024;
+
+TermDictionary::TermDictionary()
+{
+	clear();
+}
+
+void TermDictionary::clear()
+{
+	mArena.clear();
+	mEntries.clear();
+	mSlots.fill(0, TERM_DICTIONARY_SLOTS_MIN);
+	mCollisions=0;
+}
+
+qsizetype TermDictionary::size() const
+{
+	return mEntries.size();
+}
+
+quint64 TermDictionary::collisions() const
+{
+	return mCollisions;
+}
+
+qsizetype TermDictionary::sizeInBytes() const
+{
+	return mArena.capacity()+mEntries.capacity()*sizeof(Entry)+mSlots.capacity()*sizeof(quint32);
+}
+
+void TermDictionary::place(quint32 term_id)
+{
+	quint64 hash=mEntries.at(term_id).hash;
+	qsizetype mask=mSlots.size()-1;
+	qsizetype slot=hash & mask;
+	bool collision=false;
+	while(mSlots.at(slot)!=0)
+	{
+		collision|=(mEntries.at(mSlots.at(slot)-1).hash==hash);
+		slot=(slot+1) & mask;
+	}
+	if(collision)
+	{
+		mCollisions++;
+	}
+	mSlots[slot]=term_id+1;
+}
+
+void TermDictionary::rehash(qsizetype slots_num)
+{
+	mSlots.fill(0, slots_num);
+	mCollisions=0;
+	for(qsizetype termId=0; termId<mEntries.size(); termId++)
+	{
+		place(termId);
+	}
+}
+
+quint32 TermDictionary::find(const char *term, quint32 len, quint64 hash) const
+{
+	qsizetype mask=mSlots.size()-1;
+	qsizetype slot=hash & mask;
+	while(mSlots.at(slot)!=0)
+	{
+		const Entry &entry=mEntries.at(mSlots.at(slot)-1);
+		if(entry.hash==hash && entry.length==len && memcmp(mArena.constData()+entry.offset, term, len)==0)
+		{
+			return mSlots.at(slot)-1;
+		}
+		slot=(slot+1) & mask;
+	}
+	return INVALID_TERM_ID;
+}
+
+quint32 TermDictionary::find(const QByteArray &term) const
+{
+	return find(term.constData(), term.size(), hash_function_64(term));
+}
+
+quint32 TermDictionary::insert(const char *term, quint32 len, quint64 hash, const char *surface, quint32 surface_len)
+{
+	quint32 termId=find(term, len, hash);
+	if(termId!=INVALID_TERM_ID)
+	{
+		return termId;
+	}
+	if(mEntries.size()>=(qsizetype)INVALID_TERM_ID || mArena.size()+len+surface_len>(qsizetype)UINT32_MAX)
+	{
+		return INVALID_TERM_ID;
+	}
+	Entry entry;
+	entry.hash=hash;
+	entry.offset=mArena.size();
+	entry.length=len;
+	mArena.append(term, len);
+	if(surface_len==len && memcmp(surface, term, len)==0)
+	{
+		entry.surfaceOffset=entry.offset;
+	}
+	else
+	{
+		entry.surfaceOffset=mArena.size();
+		mArena.append(surface, surface_len);
+	}
+	entry.surfaceLength=surface_len;
+	termId=mEntries.size();
+	mEntries.append(entry);
+	if(mEntries.size()*2>mSlots.size())
+	{
+		rehash(mSlots.size()*2);
+	}
+	else
+	{
+		place(termId);
+	}
+	return termId;
+}
+
+quint32 TermDictionary::insert(const QByteArray &term, const QByteArray &surface)
+{
+	return insert(term.constData(), term.size(), hash_function_64(term), surface.constData(), surface.size());
+}
+
+QByteArray TermDictionary::term(quint32 term_id) const
+{
+	if(term_id>=(quint32)mEntries.size())
+	{
+		return QByteArray();
+	}
+	const Entry &entry=mEntries.at(term_id);
+	return mArena.mid(entry.offset, entry.length);
+}
+
+QString TermDictionary::surface(quint32 term_id) const
+{
+	if(term_id>=(quint32)mEntries.size())
+	{
+		return QString();
+	}
+	const Entry &entry=mEntries.at(term_id);
+	return QString::fromUtf8(mArena.constData()+entry.surfaceOffset, entry.surfaceLength);
+}
+
+quint64 TermDictionary::hash(quint32 term_id) const
+{
+	return mEntries.value(term_id).hash;
+}
+
+void TermDictionary::writeToStream(QDataStream &stream) const
+{
+	QList<quint32> order(mEntries.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [this](quint32 a, quint32 b)
+		{
+			const Entry &entryA=mEntries.at(a);
+			const Entry &entryB=mEntries.at(b);
+			int result=memcmp(mArena.constData()+entryA.offset, mArena.constData()+entryB.offset, qMin(entryA.length, entryB.length));
+			return result<0 || (result==0 && entryA.length<entryB.length);
+		});
+	QByteArray block;
+	const char *previous=nullptr;
+	quint32 previousLength=0;
+	for(quint32 termId : std::as_const(order))
+	{
+		const Entry &entry=mEntries.at(termId);
+		const char *current=mArena.constData()+entry.offset;
+		quint32 prefix=0;
+		while(prefix<previousLength && prefix<entry.length && previous[prefix]==current[prefix])
+		{
+			prefix++;
+		}
+		varint_append(block, prefix);
+		varint_append(block, entry.length-prefix);
+		block.append(current+prefix, entry.length-prefix);
+		varint_append(block, termId);
+		if(entry.surfaceOffset==entry.offset)
+		{
+			varint_append(block, 0);
+		}
+		else
+		{
+			varint_append(block, entry.surfaceLength);
+			block.append(mArena.constData()+entry.surfaceOffset, entry.surfaceLength);
+		}
+		previous=current;
+		previousLength=entry.length;
+	}
+	stream << (quint64)mEntries.size();
+	stream << block;
+}
+
+bool TermDictionary::readFromStream(QDataStream &stream)
+{
+	quint64 termsNum;
+	QByteArray block;
+	stream >> termsNum;
+	stream >> block;
+	clear();
+	if(stream.status()!=QDataStream::Ok || termsNum>(quint64)block.size())
+	{
+		return false;
+	}
+	mEntries.resize(termsNum);
+	QList<bool> termIdSeen(termsNum, false);
+	QByteArray current;
+	const char *data=block.constData();
+	const char *end=data+block.size();
+	for(quint64 i=0; i<termsNum; i++)
+	{
+		quint64 prefix, suffixLength, termId, surfaceLength;
+		if(!varint_read(data, end, prefix) || prefix>(quint64)current.size() ||
+			!varint_read(data, end, suffixLength) || suffixLength>(quint64)(end-data))
+		{
+			clear();
+			return false;
+		}
+		current.truncate(prefix);
+		current.append(data, suffixLength);
+		data+=suffixLength;
+		if(!varint_read(data, end, termId) || termId>=termsNum || termIdSeen.at(termId) ||
+			!varint_read(data, end, surfaceLength) || surfaceLength>(quint64)(end-data))
+		{
+			clear();
+			return false;
+		}
+		Entry &entry=mEntries[termId];
+		entry.hash=hash_function_64(current);
+		entry.offset=mArena.size();
+		entry.length=current.size();
+		mArena.append(current);
+		if(surfaceLength==0)
+		{
+			entry.surfaceOffset=entry.offset;
+			entry.surfaceLength=entry.length;
+		}
+		else
+		{
+			entry.surfaceOffset=mArena.size();
+			entry.surfaceLength=surfaceLength;
+			mArena.append(data, surfaceLength);
+			data+=surfaceLength;
+		}
+		termIdSeen[termId]=true;
+	}
+	if(data!=end)
+	{
+		clear();
+		return false;
+	}
+	qsizetype slotsNum=TERM_DICTIONARY_SLOTS_MIN;
+	while(mEntries.size()*2>slotsNum)
+	{
+		slotsNum*=2;
+	}
+	rehash(slotsNum);
+	return true;
+}
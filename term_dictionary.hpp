@@ -0,0 +1,48 @@
+#ifndef TERM_DICTIONARY_HPP
+#define TERM_DICTIONARY_HPP
+
+#include <QByteArray>
+#include <QString>
+#include <QList>
+#include <QDataStream>
+
+// Maps terms to dense 32-bit term IDs. Term and surface bytes live in one
+// arena; lookups go through an open-addressing table keyed by the 64-bit term
+// hash and are confirmed by comparing bytes, so terms sharing a hash still get
+// distinct IDs. Saved as a single block of terms sorted and front-coded.
+
+class TermDictionary
+{
+	struct Entry
+	{
+		quint64 hash;
+		quint32 offset;
+		quint32 length;
+		quint32 surfaceOffset;
+		quint32 surfaceLength;
+	};
+	QByteArray mArena;
+	QList<Entry> mEntries;
+	QList<quint32> mSlots;
+	quint64 mCollisions;
+	void place(quint32 term_id);
+	void rehash(qsizetype slots_num);
+public:
+	static constexpr quint32 INVALID_TERM_ID=0xFFFFFFFF;
+	TermDictionary();
+	void clear();
+	qsizetype size() const;
+	quint64 collisions() const;
+	qsizetype sizeInBytes() const;
+	quint32 find(const char *term, quint32 len, quint64 hash) const;
+	quint32 find(const QByteArray &term) const;
+	quint32 insert(const char *term, quint32 len, quint64 hash, const char *surface, quint32 surface_len);
+	quint32 insert(const QByteArray &term, const QByteArray &surface);
+	QByteArray term(quint32 term_id) const;
+	QString surface(quint32 term_id) const;
+	quint64 hash(quint32 term_id) const;
+	void writeToStream(QDataStream &stream) const;
+	bool readFromStream(QDataStream &stream);
+};
+
+#endif // TERM_DICTIONARY_HPP
@@ -0,0 +1,107 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QDebug>
+#include "main.hpp"
+#include "indexer.hpp"
+#include "util.hpp"
+
+ConfigurationKeeper *gSettings;
+
+static constexpr int BENCHMARK_PAGES=20000;
+static constexpr int BENCHMARK_TERMS=5000;
+static constexpr int BENCHMARK_TERMS_PER_PAGE=64;
+static constexpr int BENCHMARK_QUERY_TERMS=50;
+static constexpr int BENCHMARK_QUERIES=500;
+
+// Adds synthetic pages to a scratch index, updates them until a quarter, a third
+// and a half of the doc IDs are tombstones, and reports add/update throughput and
+// query latency at each step and after compaction.
+int main(int argc, char **argv)
+{
+	QCoreApplication benchApp(argc, argv);
+	gSettings=new ConfigurationKeeper();
+	gSettings->loadSettingsFromJsonFile("crawler.json");
+
+	Indexer benchmarkIndexer;
+	benchmarkIndexer.setDatabaseDirectory(QString());
+	QStringList words;
+	QList<quint32> termIds;
+	for(int term=0; term<BENCHMARK_TERMS; term++)
+	{
+		words.append(QString("bench%1").arg(term));
+		benchmarkIndexer.addWord(words.last());
+		termIds.append(benchmarkIndexer.termId(words.last()));
+	}
+	QRandomGenerator rng(1);
+	// Cubing a uniform draw skews term choice towards low term numbers, close
+	// enough to a Zipf distribution for posting list lengths.
+	auto addBenchmarkPage=[&benchmarkIndexer, &rng, &termIds](int page, int version)
+		{
+			QMap<quint32, quint32> termCounts;
+			for(int term=0; term<BENCHMARK_TERMS_PER_PAGE; term++)
+			{
+				double uniform=rng.generateDouble();
+				termCounts[termIds.at(int(uniform*uniform*uniform*termIds.size()))]++;
+			}
+			QList<QPair<quint32, quint32>> termFrequencies;
+			for(QMap<quint32, quint32>::const_iterator termIt=termCounts.constBegin(); termIt!=termCounts.constEnd(); termIt++)
+			{
+				termFrequencies.append(qMakePair(termIt.key(), termIt.value()));
+			}
+			PageHeader pageHeader;
+			pageHeader.url=QByteArray("https://benchmark.invalid/")+QByteArray::number(page);
+			pageHeader.urlHash=hash_function_128(pageHeader.url);
+			pageHeader.contentHash=hash_function_128(pageHeader.url+"#"+QByteArray::number(version));
+			pageHeader.title=QString("Benchmark page %1 version %2").arg(page).arg(version);
+			pageHeader.timeStamp=QDateTime::currentDateTime();
+			benchmarkIndexer.addPage(pageHeader, termFrequencies);
+		};
+	// Every update replaces a live page, so the live doc IDs stay at BENCHMARK_PAGES.
+	auto docIdsNum=[&benchmarkIndexer]()
+		{
+			return qint64(BENCHMARK_PAGES)+benchmarkIndexer.tombstonesNum();
+		};
+	auto measureQueries=[&benchmarkIndexer, &rng, &words, &docIdsNum](const char *label)
+		{
+			QElapsedTimer queryTimer;
+			qint64 resultsNum=0;
+			queryTimer.start();
+			for(int query=0; query<BENCHMARK_QUERIES; query++)
+			{
+				QStringList queryWords;
+				queryWords.append(words.at(rng.bounded(BENCHMARK_QUERY_TERMS)));
+				queryWords.append(words.at(rng.bounded(BENCHMARK_QUERY_TERMS)));
+				resultsNum+=benchmarkIndexer.searchPagesByWords(queryWords).size();
+			}
+			qInfo() << label << "tombstones:" << benchmarkIndexer.tombstonesNum() << "of" << docIdsNum() <<
+				"doc IDs, mean query" << queryTimer.nsecsElapsed()/1000/BENCHMARK_QUERIES << "us," << resultsNum/BENCHMARK_QUERIES <<
+				"results per query";
+		};
+	QElapsedTimer benchmarkTimer;
+	benchmarkTimer.start();
+	for(int page=0; page<BENCHMARK_PAGES; page++)
+	{
+		addBenchmarkPage(page, 0);
+	}
+	qInfo() << "Added" << BENCHMARK_PAGES << "pages at" << BENCHMARK_PAGES*1000.0/qMax(benchmarkTimer.elapsed(), qint64(1)) << "pages/s";
+	measureQueries("Before updates");
+	const double tombstoneRatios[]={0.25, 1.0/3.0, 0.5};
+	int updatesNum=0;
+	for(double tombstoneRatio : tombstoneRatios)
+	{
+		benchmarkTimer.restart();
+		int stepUpdatesNum=0;
+		while(benchmarkIndexer.tombstonesNum()<tombstoneRatio*docIdsNum())
+		{
+			addBenchmarkPage(updatesNum%BENCHMARK_PAGES, 1+updatesNum/BENCHMARK_PAGES);
+			updatesNum++;
+			stepUpdatesNum++;
+		}
+		qInfo() << "Updated" << stepUpdatesNum << "pages at" << stepUpdatesNum*1000.0/qMax(benchmarkTimer.elapsed(), qint64(1)) << "pages/s";
+		measureQueries("After updates");
+	}
+	benchmarkIndexer.compact();
+	measureQueries("After compaction");
+	return 0;
+}
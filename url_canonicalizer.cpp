@@ -0,0 +1,107 @@
+#include <QUrlQuery>
+#include <algorithm>
+#include "url_canonicalizer.hpp"
+
+void UrlCanonicalizer::compile(const QStringList &strip_parameters, const QHash<QString, QStringList> &parameter_allowlists, const QStringList &index_files)
+{
+	mStripParameters.clear();
+	mStripParameterPrefixes.clear();
+	mParameterAllowlists.clear();
+	mIndexFiles.clear();
+	for(const QString &parameter : strip_parameters)
+	{
+		if(parameter.endsWith('*'))
+		{
+			mStripParameterPrefixes.append(parameter.chopped(1));
+		}
+		else if(!parameter.isEmpty())
+		{
+			mStripParameters.insert(parameter);
+		}
+	}
+	QHash<QString, QStringList>::const_iterator allowlistIt;
+	for(allowlistIt=parameter_allowlists.constBegin(); allowlistIt!=parameter_allowlists.constEnd(); allowlistIt++)
+	{
+		QSet<QString> &allowlist=mParameterAllowlists[allowlistIt.key().toLower()];
+		for(const QString &parameter : allowlistIt.value())
+		{
+			allowlist.insert(parameter);
+		}
+	}
+	for(const QString &indexFile : index_files)
+	{
+		mIndexFiles.insert(indexFile.toLower());
+	}
+}
+
+bool UrlCanonicalizer::isParameterStripped(const QString &host, const QString &parameter) const
+{
+	QHash<QString, QSet<QString>>::const_iterator allowlistIt=mParameterAllowlists.constFind(host);
+	if(allowlistIt!=mParameterAllowlists.constEnd())
+	{
+		return !allowlistIt->contains(parameter);
+	}
+	if(mStripParameters.contains(parameter))
+	{
+		return true;
+	}
+	for(const QString &prefix : mStripParameterPrefixes)
+	{
+		if(parameter.startsWith(prefix))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+QUrl UrlCanonicalizer::canonicalize(const QUrl &url) const
+{
+	QUrl result=url.adjusted(QUrl::RemoveFragment | QUrl::NormalizePathSegments);
+	if(!result.isValid() || result.host().isEmpty())
+	{
+		return result;
+	}
+	QString host=result.host(QUrl::EncodeUnicode).toLower();
+	if(host.endsWith('.'))
+	{
+		host.chop(1);
+	}
+	result.setHost(host);
+	if((result.scheme()=="http" && result.port()==80) || (result.scheme()=="https" && result.port()==443))
+	{
+		result.setPort(-1);
+	}
+	QString path=result.path(QUrl::FullyEncoded);
+	if(path.isEmpty())
+	{
+		path="/";
+	}
+	qsizetype lastSlash=path.lastIndexOf('/');
+	if(!mIndexFiles.isEmpty() && mIndexFiles.contains(path.mid(lastSlash+1).toLower()))
+	{
+		path.truncate(lastSlash+1);
+	}
+	result.setPath(path, QUrl::TolerantMode);
+	if(result.hasQuery())
+	{
+		QList<QPair<QString, QString>> queryItems=QUrlQuery(result).queryItems(QUrl::FullyEncoded);
+		queryItems.removeIf(
+			[this, &host](const QPair<QString, QString> &item)
+			{
+				return isParameterStripped(host, item.first);
+			});
+		std::stable_sort(queryItems.begin(), queryItems.end());
+		if(queryItems.isEmpty())
+		{
+			result.setQuery(QString());
+		}
+		else
+		{
+			QUrlQuery canonicalQuery;
+			canonicalQuery.setQueryItems(queryItems);
+			result.setQuery(canonicalQuery.query(QUrl::FullyEncoded), QUrl::TolerantMode);
+		}
+	}
+	return result;
+}
@@ -0,0 +1,21 @@
+#ifndef URL_CANONICALIZER_HPP
+#define URL_CANONICALIZER_HPP
+
+#include <QUrl>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+
+class UrlCanonicalizer
+{
+	QSet<QString> mStripParameters;
+	QStringList mStripParameterPrefixes;
+	QHash<QString, QSet<QString>> mParameterAllowlists;
+	QSet<QString> mIndexFiles;
+	bool isParameterStripped(const QString &host, const QString &parameter) const;
+public:
+	void compile(const QStringList &strip_parameters, const QHash<QString, QStringList> &parameter_allowlists, const QStringList &index_files);
+	QUrl canonicalize(const QUrl &url) const;
+};
+
+#endif // URL_CANONICALIZER_HPP
@@ -0,0 +1,228 @@
+#include <algorithm>
+#include "url_filter.hpp"
+
+void CharTrie::clear()
+{
+	mNodes.clear();
+	mEdges.clear();
+	mBuilderEdges.clear();
+}
+
+qint32 CharTrie::addRoot()
+{
+	mNodes.push_back({0, 0, 0, NO_NODE});
+	mBuilderEdges.emplace_back();
+	return mNodes.size()-1;
+}
+
+qint32 CharTrie::insert(qint32 root, const QChar *data, qsizetype length, bool reversed)
+{
+	qint32 node=root;
+	for(qsizetype i=0; i<length; i++)
+	{
+		char16_t label=reversed ? data[length-1-i].unicode() : data[i].unicode();
+		std::vector<Edge> &edges=mBuilderEdges[node];
+		std::vector<Edge>::iterator edgeIt=std::find_if(edges.begin(), edges.end(),
+			[label](const Edge &edge) { return edge.label==label; });
+		if(edgeIt!=edges.end())
+		{
+			node=edgeIt->target;
+		}
+		else
+		{
+			qint32 child=addRoot();
+			mBuilderEdges[node].push_back({label, (quint32)child});
+			node=child;
+		}
+	}
+	return node;
+}
+
+void CharTrie::setFlags(qint32 node, quint32 flags)
+{
+	mNodes[node].flags|=flags;
+}
+
+void CharTrie::setValue(qint32 node, qint32 value)
+{
+	mNodes[node].value=value;
+}
+
+void CharTrie::finalize()
+{
+	mEdges.clear();
+	for(size_t node=0; node<mNodes.size(); node++)
+	{
+		std::vector<Edge> &edges=mBuilderEdges[node];
+		std::sort(edges.begin(), edges.end(), [](const Edge &a, const Edge &b) { return a.label<b.label; });
+		mNodes[node].firstEdge=mEdges.size();
+		mNodes[node].edgeCount=edges.size();
+		mEdges.insert(mEdges.end(), edges.begin(), edges.end());
+	}
+	mBuilderEdges.clear();
+	mBuilderEdges.shrink_to_fit();
+}
+
+qint32 CharTrie::step(qint32 node, char16_t label) const
+{
+	const Node &current=mNodes[node];
+	const Edge *first=mEdges.data()+current.firstEdge;
+	const Edge *last=first+current.edgeCount;
+	const Edge *edge=std::lower_bound(first, last, label, [](const Edge &e, char16_t l) { return e.label<l; });
+	if(edge==last || edge->label!=label)
+	{
+		return NO_NODE;
+	}
+	return edge->target;
+}
+
+quint32 CharTrie::flags(qint32 node) const
+{
+	return mNodes[node].flags;
+}
+
+qint32 CharTrie::value(qint32 node) const
+{
+	return mNodes[node].value;
+}
+
+UrlFilter::UrlFilter()
+{
+	mHostsRoot=mHosts.addRoot();
+	mHosts.finalize();
+}
+
+QString UrlFilter::zoneKey(const QString &scheme, int port, const QString &path, const QString &query)
+{
+	QString key=scheme;
+	key+=':';
+	if(port>=0)
+	{
+		key+=QString::number(port);
+	}
+	key+='|';
+	key+=path;
+	if(!query.isEmpty())
+	{
+		key+='?';
+		key+=query;
+	}
+	return key;
+}
+
+void UrlFilter::compile(const QStringList &allowed_schemes, const QSet<QString> &blacklisted_hosts, const QHash<QString, QStringList> &crawling_zones)
+{
+	mAllowedSchemes=allowed_schemes;
+	mHosts.clear();
+	mZones.clear();
+	mHostsRoot=mHosts.addRoot();
+	for(const QString &blacklistedHost : blacklisted_hosts)
+	{
+		QString host=blacklistedHost.toLower();
+		if(host.startsWith("*."))
+		{
+			host.remove(0, 2);
+			qint32 node=mHosts.insert(mHostsRoot, host.constData(), host.size(), true);
+			mHosts.setFlags(node, HOST_SUBDOMAINS_BLACKLISTED);
+		}
+		else
+		{
+			qint32 node=mHosts.insert(mHostsRoot, host.constData(), host.size(), true);
+			mHosts.setFlags(node, HOST_BLACKLISTED);
+		}
+	}
+	QHash<QString, QStringList>::const_iterator zonesIt;
+	for(zonesIt=crawling_zones.constBegin(); zonesIt!=crawling_zones.constEnd(); zonesIt++)
+	{
+		const QString host=zonesIt.key().toLower();
+		qint32 hostNode=mHosts.insert(mHostsRoot, host.constData(), host.size(), true);
+		// Keys that differ only in case share one zone root.
+		qint32 zonesRoot=(mHosts.flags(hostNode) & HOST_HAS_ZONES) ? mHosts.value(hostNode) : mZones.addRoot();
+		mHosts.setFlags(hostNode, HOST_HAS_ZONES);
+		mHosts.setValue(hostNode, zonesRoot);
+		for(const QString &zonePrefix : zonesIt.value())
+		{
+			if(zonePrefix.isEmpty())
+			{
+				continue;
+			}
+			QUrl zoneUrl(zonePrefix);
+			QString key=zoneKey(zoneUrl.scheme(), zoneUrl.port(), zoneUrl.path(), zoneUrl.query());
+			qint32 zoneNode=mZones.insert(zonesRoot, key.constData(), key.size());
+			mZones.setFlags(zoneNode, ZONE_PREFIX_END);
+		}
+	}
+	mHosts.finalize();
+	mZones.finalize();
+}
+
+qint32 UrlFilter::walkZones(qint32 node, const QChar *data, qsizetype length, bool &matched) const
+{
+	for(qsizetype i=0; i<length && node!=CharTrie::NO_NODE; i++)
+	{
+		node=mZones.step(node, data[i].unicode());
+		if(node!=CharTrie::NO_NODE && (mZones.flags(node) & ZONE_PREFIX_END))
+		{
+			matched=true;
+			return node;
+		}
+	}
+	return node;
+}
+
+UrlFilter::Verdict UrlFilter::admit(const QUrl &url) const
+{
+	const QString scheme=url.scheme();
+	if(!mAllowedSchemes.isEmpty() && !mAllowedSchemes.contains(scheme))
+	{
+		return RejectedScheme;
+	}
+	const QString host=url.host();
+	qint32 node=mHostsRoot;
+	for(qsizetype i=host.size()-1; i>=0 && node!=CharTrie::NO_NODE; i--)
+	{
+		if(host.at(i)=='.' && (mHosts.flags(node) & HOST_SUBDOMAINS_BLACKLISTED))
+		{
+			return RejectedHost;
+		}
+		node=mHosts.step(node, host.at(i).unicode());
+	}
+	if(node==CharTrie::NO_NODE || node==mHostsRoot)
+	{
+		return Admitted;
+	}
+	quint32 hostFlags=mHosts.flags(node);
+	if(hostFlags & HOST_BLACKLISTED)
+	{
+		return RejectedHost;
+	}
+	if(!(hostFlags & HOST_HAS_ZONES))
+	{
+		return Admitted;
+	}
+	bool matched=false;
+	qint32 zoneNode=mHosts.value(node);
+	zoneNode=walkZones(zoneNode, scheme.constData(), scheme.size(), matched);
+	const QChar separator[]={QChar(':')};
+	zoneNode=walkZones(zoneNode, separator, 1, matched);
+	if(url.port()>=0)
+	{
+		const QString port=QString::number(url.port());
+		zoneNode=walkZones(zoneNode, port.constData(), port.size(), matched);
+	}
+	const QChar pathSeparator[]={QChar('|')};
+	zoneNode=walkZones(zoneNode, pathSeparator, 1, matched);
+	if(!matched)
+	{
+		const QString path=url.path();
+		zoneNode=walkZones(zoneNode, path.constData(), path.size(), matched);
+	}
+	if(!matched && url.hasQuery())
+	{
+		const QChar querySeparator[]={QChar('?')};
+		const QString query=url.query();
+		zoneNode=walkZones(zoneNode, querySeparator, 1, matched);
+		zoneNode=walkZones(zoneNode, query.constData(), query.size(), matched);
+	}
+	return matched ? Admitted : RejectedZone;
+}
@@ -0,0 +1,71 @@
+#ifndef URL_FILTER_HPP
+#define URL_FILTER_HPP
+
+#include <QUrl>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <vector>
+
+class CharTrie
+{
+	struct Node
+	{
+		quint32 firstEdge;
+		quint32 edgeCount;
+		quint32 flags;
+		qint32 value;
+	};
+	struct Edge
+	{
+		char16_t label;
+		quint32 target;
+	};
+	std::vector<Node> mNodes;
+	std::vector<Edge> mEdges;
+	std::vector<std::vector<Edge>> mBuilderEdges;
+public:
+	static constexpr qint32 NO_NODE=-1;
+	void clear();
+	qint32 addRoot();
+	qint32 insert(qint32 root, const QChar *data, qsizetype length, bool reversed=false);
+	void setFlags(qint32 node, quint32 flags);
+	void setValue(qint32 node, qint32 value);
+	void finalize();
+	qint32 step(qint32 node, char16_t label) const;
+	quint32 flags(qint32 node) const;
+	qint32 value(qint32 node) const;
+};
+
+class UrlFilter
+{
+	enum HostFlags
+	{
+		HOST_BLACKLISTED=1,
+		HOST_SUBDOMAINS_BLACKLISTED=2,
+		HOST_HAS_ZONES=4
+	};
+	enum ZoneFlags
+	{
+		ZONE_PREFIX_END=1
+	};
+	QStringList mAllowedSchemes;
+	CharTrie mHosts;
+	CharTrie mZones;
+	qint32 mHostsRoot;
+	qint32 walkZones(qint32 node, const QChar *data, qsizetype length, bool &matched) const;
+	static QString zoneKey(const QString &scheme, int port, const QString &path, const QString &query);
+public:
+	enum Verdict
+	{
+		Admitted,
+		RejectedScheme,
+		RejectedHost,
+		RejectedZone
+	};
+	UrlFilter();
+	void compile(const QStringList &allowed_schemes, const QSet<QString> &blacklisted_hosts, const QHash<QString, QStringList> &crawling_zones);
+	Verdict admit(const QUrl &url) const;
+};
+
+#endif // URL_FILTER_HPP
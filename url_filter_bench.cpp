@@ -0,0 +1,72 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QDebug>
+#include "main.hpp"
+#include "url_filter.hpp"
+#include "util.hpp"
+
+ConfigurationKeeper *gSettings;
+
+static int usage()
+{
+	qWarning() << "Usage: seeklet-bench-url-filter [--passes N] url_list_file";
+	qWarning() << "The filter is compiled from the schemes, blacklist and zones in crawler.json.";
+	return 2;
+}
+
+// Runs every URL of a list file, one per line, through the URL filter built
+// from crawler.json and reports the admission rate and the verdicts.
+int main(int argc, char **argv)
+{
+	QCoreApplication benchApp(argc, argv);
+	gSettings=new ConfigurationKeeper();
+	gSettings->loadSettingsFromJsonFile("crawler.json");
+
+	QStringList arguments=benchApp.arguments().mid(1);
+	int passes=20;
+	if(!take_number_option(arguments, "--passes", passes) || passes<1 || arguments.size()!=1)
+	{
+		return usage();
+	}
+	QFile listFile(arguments.first());
+	if(!listFile.open(QIODevice::ReadOnly | QIODevice::Text))
+	{
+		qWarning() << "Failed to open" << arguments.first() << listFile.errorString();
+		return 1;
+	}
+	QList<QUrl> urls;
+	while(!listFile.atEnd())
+	{
+		const QByteArray line=listFile.readLine().trimmed();
+		if(!line.isEmpty())
+		{
+			urls.append(QUrl::fromEncoded(line));
+		}
+	}
+	if(urls.isEmpty())
+	{
+		qWarning() << "No URLs in" << arguments.first();
+		return 1;
+	}
+	QElapsedTimer benchmarkTimer;
+	benchmarkTimer.start();
+	const UrlFilter &urlFilter=gSettings->urlFilter();
+	qInfo() << "Compiled the URL filter in" << benchmarkTimer.nsecsElapsed()/1000 << "us";
+	qint64 verdicts[UrlFilter::RejectedZone+1]={};
+	benchmarkTimer.restart();
+	for(int pass=0; pass<passes; pass++)
+	{
+		for(const QUrl &url : std::as_const(urls))
+		{
+			verdicts[urlFilter.admit(url)]++;
+		}
+	}
+	qint64 elapsed=qMax(benchmarkTimer.nsecsElapsed(), qint64(1));
+	qint64 checksNum=qint64(urls.size())*passes;
+	qInfo() << "Checked" << urls.size() << "URLs" << passes << "times at" << checksNum*1000000000.0/elapsed << "URLs/s," <<
+		elapsed/checksNum << "ns per URL";
+	qInfo() << "Admitted" << verdicts[UrlFilter::Admitted]/passes << "rejected by scheme" << verdicts[UrlFilter::RejectedScheme]/passes <<
+		"by host" << verdicts[UrlFilter::RejectedHost]/passes << "by zone" << verdicts[UrlFilter::RejectedZone]/passes;
+	return 0;
+}
@@ -0,0 +1,103 @@
+#include <QTest>
+#include "url_filter.hpp"
+
+class UrlFilterTest : public QObject
+{
+	Q_OBJECT
+	static UrlFilter::Verdict admit(const UrlFilter &filter, const QString &url)
+	{
+		return filter.admit(QUrl(url));
+	}
+private slots:
+	void emptyFilter()
+	{
+		UrlFilter filter;
+		QCOMPARE(admit(filter, "ftp://example.com/file"), UrlFilter::Admitted);
+		QCOMPARE(admit(filter, "https://example.com/"), UrlFilter::Admitted);
+	}
+
+	void schemes()
+	{
+		UrlFilter filter;
+		filter.compile({"http", "https"}, {}, {});
+		QCOMPARE(admit(filter, "http://example.com/"), UrlFilter::Admitted);
+		QCOMPARE(admit(filter, "HTTPS://example.com/"), UrlFilter::Admitted);
+		QCOMPARE(admit(filter, "ftp://example.com/"), UrlFilter::RejectedScheme);
+		QCOMPARE(admit(filter, "mailto:someone@example.com"), UrlFilter::RejectedScheme);
+	}
+
+	void exactBlacklist()
+	{
+		UrlFilter filter;
+		filter.compile({}, {"ads.example.com", "Tracker.INVALID"}, {});
+		QCOMPARE(admit(filter, "https://ads.example.com/banner"), UrlFilter::RejectedHost);
+		QCOMPARE(admit(filter, "https://tracker.invalid/"), UrlFilter::RejectedHost);
+		QCOMPARE(admit(filter, "https://example.com/"), UrlFilter::Admitted);
+		QCOMPARE(admit(filter, "https://sub.ads.example.com/"), UrlFilter::Admitted);
+		QCOMPARE(admit(filter, "https://bads.example.com/"), UrlFilter::Admitted);
+	}
+
+	void suffixBlacklist()
+	{
+		UrlFilter filter;
+		filter.compile({}, {"*.example.com"}, {});
+		QCOMPARE(admit(filter, "https://www.example.com/"), UrlFilter::RejectedHost);
+		QCOMPARE(admit(filter, "https://a.b.example.com/"), UrlFilter::RejectedHost);
+		// The pattern covers subdomains only, not the apex domain itself.
+		QCOMPARE(admit(filter, "https://example.com/"), UrlFilter::Admitted);
+		QCOMPARE(admit(filter, "https://badexample.com/"), UrlFilter::Admitted);
+		QCOMPARE(admit(filter, "https://example.com.evil.invalid/"), UrlFilter::Admitted);
+	}
+
+	void apexAndSuffixBlacklist()
+	{
+		UrlFilter filter;
+		filter.compile({}, {"*.example.com", "example.com"}, {});
+		QCOMPARE(admit(filter, "https://example.com/"), UrlFilter::RejectedHost);
+		QCOMPARE(admit(filter, "https://www.example.com/"), UrlFilter::RejectedHost);
+	}
+
+	void zonePrefixes()
+	{
+		UrlFilter filter;
+		QHash<QString, QStringList> zones;
+		zones["example.com"]={"https://example.com/docs/", "https://example.com/search?q=", "https://example.com:8443/"};
+		filter.compile({}, {}, zones);
+		QCOMPARE(admit(filter, "https://example.com/docs/page"), UrlFilter::Admitted);
+		QCOMPARE(admit(filter, "https://example.com/docs/"), UrlFilter::Admitted);
+		QCOMPARE(admit(filter, "https://example.com/blog/"), UrlFilter::RejectedZone);
+		QCOMPARE(admit(filter, "http://example.com/docs/page"), UrlFilter::RejectedZone);
+		QCOMPARE(admit(filter, "https://example.com/search?q=seeklet"), UrlFilter::Admitted);
+		QCOMPARE(admit(filter, "https://example.com/search?page=2"), UrlFilter::RejectedZone);
+		QCOMPARE(admit(filter, "https://example.com:8443/anything"), UrlFilter::Admitted);
+		QCOMPARE(admit(filter, "https://example.com:9000/docs/page"), UrlFilter::RejectedZone);
+		// Zones only restrict their own host.
+		QCOMPARE(admit(filter, "https://other.invalid/blog/"), UrlFilter::Admitted);
+		QCOMPARE(admit(filter, "https://www.example.com/blog/"), UrlFilter::Admitted);
+	}
+
+	void zoneHostCase()
+	{
+		UrlFilter filter;
+		QHash<QString, QStringList> zones;
+		zones["Example.COM"]={"https://Example.COM/docs/"};
+		zones["example.com"]={"https://example.com/api/"};
+		filter.compile({}, {}, zones);
+		QCOMPARE(admit(filter, "https://EXAMPLE.com/docs/page"), UrlFilter::Admitted);
+		QCOMPARE(admit(filter, "https://example.com/api/v1"), UrlFilter::Admitted);
+		QCOMPARE(admit(filter, "https://example.com/blog/"), UrlFilter::RejectedZone);
+	}
+
+	void blacklistBeforeZones()
+	{
+		UrlFilter filter;
+		QHash<QString, QStringList> zones;
+		zones["docs.example.com"]={"https://docs.example.com/"};
+		filter.compile({"https"}, {"*.example.com"}, zones);
+		QCOMPARE(admit(filter, "https://docs.example.com/page"), UrlFilter::RejectedHost);
+		QCOMPARE(admit(filter, "http://docs.example.com/page"), UrlFilter::RejectedScheme);
+	}
+};
+
+QTEST_GUILESS_MAIN(UrlFilterTest)
+#include "url_filter_test.moc"
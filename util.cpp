@@ -1,3 +1,8 @@
+#include <cstring>
+#include <array>
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
 #include "util.hpp"
 #include "simple_hash.hpp"
 #include "metrohash128.hpp"
@@ -15,3 +20,135 @@ QByteArray hash_function_128(const QByteArray &data)
 	metrohash128_1((const uint8_t *)data.constData(), data.size(), SEEKLET_PUBLIC_SEED, hash);
 	return QByteArray((const char *)hash, 16);
 }
+
+void varint_append(QByteArray &out, quint64 value)
+{
+	while(value>=0x80)
+	{
+		out.append(char((value & 0x7F) | 0x80));
+		value>>=7;
+	}
+	out.append(char(value));
+}
+
+bool varint_read(const char *&data, const char *end, quint64 &value)
+{
+	value=0;
+	for(int shift=0; shift<64 && data<end; shift+=7)
+	{
+		quint8 byte=quint8(*data++);
+		value|=quint64(byte & 0x7F)<<shift;
+		if((byte & 0x80)==0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static constexpr quint32 CRC32C_POLYNOMIAL=0x82F63B78;
+
+static quint32 crc32c_software(const char *data, qsizetype size, quint32 crc)
+{
+	static const std::array<quint32, 256> table=[]()
+		{
+			std::array<quint32, 256> table;
+			for(quint32 i=0; i<256; i++)
+			{
+				quint32 value=i;
+				for(int bit=0; bit<8; bit++)
+				{
+					value=(value & 1) ? (value>>1)^CRC32C_POLYNOMIAL : value>>1;
+				}
+				table[i]=value;
+			}
+			return table;
+		}();
+	for(qsizetype i=0; i<size; i++)
+	{
+		crc=table[(crc^quint8(data[i])) & 0xFF]^(crc>>8);
+	}
+	return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2"))) static quint32 crc32c_sse42(const char *data, qsizetype size, quint32 crc)
+{
+	quint64 crc64=crc;
+	while(size>=8)
+	{
+		quint64 word;
+		memcpy(&word, data, sizeof(word));
+		crc64=_mm_crc32_u64(crc64, word);
+		data+=8;
+		size-=8;
+	}
+	crc=crc64;
+	while(size>0)
+	{
+		crc=_mm_crc32_u8(crc, quint8(*data));
+		data++;
+		size--;
+	}
+	return crc;
+}
+#endif
+
+quint32 crc32c(const char *data, qsizetype size, quint32 crc)
+{
+	crc=~crc;
+#if defined(__x86_64__)
+	static const bool sse42=__builtin_cpu_supports("sse4.2");
+	if(sse42)
+	{
+		return ~crc32c_sse42(data, size, crc);
+	}
+#endif
+	return ~crc32c_software(data, size, crc);
+}
+
+bool take_options(QStringList &arguments, const QString &name, QStringList &values)
+{
+	qsizetype option;
+	while((option=arguments.indexOf(name))>=0)
+	{
+		if(option+1>=arguments.size())
+		{
+			return false;
+		}
+		values.append(arguments.at(option+1));
+		arguments.remove(option, 2);
+	}
+	return true;
+}
+
+// A single-valued option given twice is an error.
+bool take_option(QStringList &arguments, const QString &name, QString &value)
+{
+	QStringList values;
+	if(!take_options(arguments, name, values) || values.size()>1)
+	{
+		return false;
+	}
+	if(!values.isEmpty())
+	{
+		value=values.first();
+	}
+	return true;
+}
+
+// Accepts only non-negative integers.
+bool take_number_option(QStringList &arguments, const QString &name, int &value)
+{
+	QString number;
+	if(!take_option(arguments, name, number))
+	{
+		return false;
+	}
+	bool valid=true;
+	if(!number.isEmpty())
+	{
+		value=number.toInt(&valid);
+	}
+	return valid && value>=0;
+}
@@ -2,8 +2,18 @@
 #define UTIL_HPP
 
 #include <QByteArray>
+#include <QStringList>
 
 uint64_t hash_function_64(const QByteArray &data);
 QByteArray hash_function_128(const QByteArray &data);
+void varint_append(QByteArray &out, quint64 value);
+bool varint_read(const char *&data, const char *end, quint64 &value);
+quint32 crc32c(const char *data, qsizetype size, quint32 crc=0);
+// Command line helpers for the tools. Each removes the "name value" pairs it
+// consumes from arguments and returns false if a value is missing; an option
+// that is absent leaves value untouched.
+bool take_options(QStringList &arguments, const QString &name, QStringList &values);
+bool take_option(QStringList &arguments, const QString &name, QString &value);
+bool take_number_option(QStringList &arguments, const QString &name, int &value);
 
 #endif // UTIL_HPP
@@ -7,13 +7,49 @@
 #include <QSettings>
 #include <QDir>
 #include <QScreen>
+#include <QDebug>
+#include <QRegularExpression>
+#include <QWebEngineScript>
 #include <QtSql/QSqlDatabase>
 #include <QtSql/QSqlQuery>
 #include <QtSql/QSqlError>
-#include <htmlcxx/html/ParserDom.h>
-#include <htmlcxx/html/Uri.h>
 #include "main.hpp"
 #include "web_page_processor.hpp"
+#include "html_tokenizer.hpp"
+
+static const QString gPageExtractionScript=QStringLiteral(R"JS(
+(function()
+{
+	var result={};
+	result.title=document.title||'';
+	result.lang=(document.documentElement && document.documentElement.lang)||'';
+	var canonical=document.querySelector('link[rel~="canonical" i][href]');
+	result.canonical=canonical ? canonical.href : '';
+	var robots=document.querySelector('meta[name="robots" i]');
+	result.robots=robots ? (robots.getAttribute('content')||'') : '';
+	result.text=document.body ? document.body.innerText : '';
+	var links=[];
+	var seen=new Set();
+	var anchors=document.querySelectorAll('a[href], area[href]');
+	for(var i=0; i<anchors.length; i++)
+	{
+		var anchor=anchors[i];
+		if(/(^|\s)nofollow(\s|$)/i.test(anchor.getAttribute('rel')||''))
+		{
+			continue;
+		}
+		var href=anchor.href;
+		if(typeof href!=='string' || href.length==0 || seen.has(href))
+		{
+			continue;
+		}
+		seen.add(href);
+		links.push(href);
+	}
+	result.links=links;
+	return result;
+})();
+)JS");
 
 void WebPageProcessor::createNewWebPage()
 {
@@ -41,15 +77,44 @@ void WebPageProcessor::waitForJSToFinish(bool ok)
 	}
 }
 
-void WebPageProcessor::extractPageContentTEXT()
+bool WebPageProcessor::applyExtractionResult(const QVariant &result)
+{
+	if(result.typeId()!=QMetaType::QVariantMap)
+	{
+		return false;
+	}
+	const QVariantMap resultMap=result.toMap();
+	mPageContentTEXT=resultMap.value("text").toString();
+	mPageTitle=resultMap.value("title").toString();
+	mPageLanguage=resultMap.value("lang").toString();
+	mPageRobots=resultMap.value("robots").toString().toLower();
+	mPageCanonicalURL=QUrl(resultMap.value("canonical").toString());
+	const QVariantList links=resultMap.value("links").toList();
+	mPageLinks.reserve(links.size());
+	for(const QVariant &link : links)
+	{
+		QUrl linkUrl(link.toString());
+		if(linkUrl.isValid())
+		{
+			mPageLinks.append(linkUrl);
+		}
+	}
+	return true;
+}
+
+void WebPageProcessor::extractPageContent()
 {
-	mWebPage->toPlainText(
-		[this](const QString &text)
+	mWebPage->runJavaScript(gPageExtractionScript, QWebEngineScript::ApplicationWorld,
+		[this](const QVariant &result)
 		{
-			this->mPageContentTEXT = text;
-			if(!this->mPageContentHTML.isEmpty())
+			if(this->applyExtractionResult(result))
+			{
+				emit pageProcessingFinished();
+			}
+			else
 			{
-				emit pageLoadingSuccess();
+				qDebug() << "In-page extraction failed, falling back to HTML parsing";
+				this->extractPageContentHTML();
 			}
 		});
 }
@@ -60,56 +125,73 @@ void WebPageProcessor::extractPageContentHTML()
 		[this](const QString &html)
 		{
 			this->mPageContentHTML = html;
-			if(!this->mPageContentTEXT.isEmpty())
-			{
-				emit pageLoadingSuccess();
-			}
+			emit pageLoadingSuccess();
 		});
 }
 
-void WebPageProcessor::extractPageLinks()
+struct PageContentCollector
 {
-	using namespace htmlcxx;
-	HTML::ParserDom parser;
-	parser.parseTree(mPageContentHTML.toStdString());
-	const tree<HTML::Node> &domTree=parser.getTree();
-	QUrl baseUrl=mWebPage->url();
-	for (HTML::Node &domNode : domTree)
+	QUrl pageUrl;
+	QUrl baseUrl;
+	QUrl canonicalUrl;
+	QString robots;
+	QString text;
+	QList<QUrl> links;
+	QStringList hrefs;
+	void onLink(const char16_t *href, size_t len, bool nofollow)
 	{
-		if (domNode.isTag())
+		if(!nofollow && len>0)
 		{
-			if ((domNode.tagName() != "a") && (domNode.tagName() != "A"))
-			{
-				continue;
-			}
-			else
-			{
-				domNode.parseAttributes();
-				std::pair<bool, std::string> href_pair = domNode.attribute("href");
-				if (href_pair.first)
-				{
-					QString hrefQString=QString::fromStdString(href_pair.second);
-					hrefQString.replace("&amp;", "&");
-					if(!hrefQString.isEmpty())
-					{
-						QUrl processedUrl;
-						if (baseUrl.isValid())
-						{
-							processedUrl=baseUrl.resolved(QUrl(hrefQString));
-						}
-						else
-						{
-							processedUrl=QUrl(hrefQString);
-						}
-						if (processedUrl.isValid())
-						{
-							mPageLinks.append(processedUrl);
-						}
-					}
-				}
-			}
+			hrefs.append(QString(reinterpret_cast<const QChar *>(href), len));
 		}
 	}
+	void onBase(const char16_t *href, size_t len)
+	{
+		baseUrl=pageUrl.resolved(QUrl(QString(reinterpret_cast<const QChar *>(href), len)));
+	}
+	void onCanonical(const char16_t *href, size_t len)
+	{
+		canonicalUrl=QUrl(QString(reinterpret_cast<const QChar *>(href), len));
+	}
+	void onMetaRobots(const char16_t *content, size_t len)
+	{
+		robots=QString(reinterpret_cast<const QChar *>(content), len).toLower();
+	}
+	void onText(const char16_t *chunk, size_t len)
+	{
+		text.append(reinterpret_cast<const QChar *>(chunk), len);
+	}
+};
+
+void WebPageProcessor::extractPageContentFromHTML()
+{
+	PageContentCollector collector;
+	collector.pageUrl=mWebPage->url();
+	collector.baseUrl=collector.pageUrl;
+	HtmlTokenizer<char16_t> tokenizer;
+	tokenizer.tokenize(reinterpret_cast<const char16_t *>(mPageContentHTML.constData()), mPageContentHTML.size(), collector);
+	for(const QString &href : collector.hrefs)
+	{
+		QUrl processedUrl;
+		if(collector.baseUrl.isValid())
+		{
+			processedUrl=collector.baseUrl.resolved(QUrl(href));
+		}
+		else
+		{
+			processedUrl=QUrl(href);
+		}
+		if(processedUrl.isValid())
+		{
+			mPageLinks.append(processedUrl);
+		}
+	}
+	if(collector.canonicalUrl.isValid())
+	{
+		mPageCanonicalURL=collector.baseUrl.resolved(collector.canonicalUrl);
+	}
+	mPageRobots=collector.robots;
+	mPageContentTEXT=collector.text;
 	emit pageProcessingFinished();
 }
 
@@ -123,13 +205,16 @@ WebPageProcessor::WebPageProcessor(QObject *parent) : QObject(parent)
 	mProfile->setHttpCacheType(QWebEngineProfile::MemoryHttpCache);
 	mProfile->setPersistentCookiesPolicy(QWebEngineProfile::AllowPersistentCookies);
 	mProfile->setHttpUserAgent(gSettings->httpUserAgent());
+	mRequestInterceptor=new RequestInterceptor(this);
+	mRequestInterceptor->setBlockedResourceTypes(gSettings->blockedResourceTypes());
+	mRequestInterceptor->setBlockedHosts(gSettings->blockedRequestHosts());
+	mProfile->setUrlRequestInterceptor(mRequestInterceptor);
 	mWebPage=nullptr;
 	createNewWebPage();
 	mJSCompletionTimer=new QTimer(this);
 	mJSCompletionTimer->setSingleShot(1);
-	connect(mJSCompletionTimer, &QTimer::timeout, this, &WebPageProcessor::extractPageContentTEXT);
-	connect(mJSCompletionTimer, &QTimer::timeout, this, &WebPageProcessor::extractPageContentHTML);
-	connect(this, &WebPageProcessor::pageLoadingSuccess, this, &WebPageProcessor::extractPageLinks);
+	connect(mJSCompletionTimer, &QTimer::timeout, this, &WebPageProcessor::extractPageContent);
+	connect(this, &WebPageProcessor::pageLoadingSuccess, this, &WebPageProcessor::extractPageContentFromHTML);
 }
 
 void WebPageProcessor::setHttpUserAgent(const QString &user_agent)
@@ -242,7 +327,12 @@ void WebPageProcessor::loadPage(const QUrl &url)
 {
 	mPageContentHTML.clear();
 	mPageContentTEXT.clear();
+	mPageTitle.clear();
+	mPageLanguage.clear();
+	mPageRobots.clear();
+	mPageCanonicalURL.clear();
 	mPageLinks.clear();
+	mRequestInterceptor->resetStatistics();
 	mWebPage->load(url);
 }
 
@@ -258,7 +348,43 @@ const QString &WebPageProcessor::getPageContentAsTEXT() const
 
 QString WebPageProcessor::getPageTitle() const
 {
-	return mWebPage->title();
+	if(mPageTitle.isEmpty())
+	{
+		return mWebPage->title();
+	}
+	return mPageTitle;
+}
+
+const QString &WebPageProcessor::getPageLanguage() const
+{
+	return mPageLanguage;
+}
+
+const QString &WebPageProcessor::getPageRobots() const
+{
+	return mPageRobots;
+}
+
+const QUrl &WebPageProcessor::getPageCanonicalURL() const
+{
+	return mPageCanonicalURL;
+}
+
+// Meta robots directives are whole tokens separated by commas or whitespace.
+static bool has_robots_directive(const QString &robots, const QString &directive)
+{
+	static const QRegularExpression directiveSeparators("[,\\s]+");
+	return robots.split(directiveSeparators, Qt::SkipEmptyParts).contains(directive);
+}
+
+bool WebPageProcessor::isPageIndexingAllowed() const
+{
+	return !(has_robots_directive(mPageRobots, "noindex") || has_robots_directive(mPageRobots, "none"));
+}
+
+bool WebPageProcessor::isPageFollowingAllowed() const
+{
+	return !(has_robots_directive(mPageRobots, "nofollow") || has_robots_directive(mPageRobots, "none"));
 }
 
 QUrl WebPageProcessor::getPageURL() const
@@ -275,3 +401,13 @@ const QList<QUrl> &WebPageProcessor::getPageLinks() const
 {
 	return mPageLinks;
 }
+
+quint64 WebPageProcessor::getRequestsAllowed() const
+{
+	return mRequestInterceptor->requestsAllowed();
+}
+
+quint64 WebPageProcessor::getRequestsBlocked() const
+{
+	return mRequestInterceptor->requestsBlocked();
+}
@@ -7,23 +7,30 @@
 #include <QString>
 #include <QTimer>
 #include <QObject>
+#include "request_interceptor.hpp"
 
 class WebPageProcessor : public QObject
 {
 	Q_OBJECT
 	QWebEnginePage *mWebPage;
 	QWebEngineProfile *mProfile;
+	RequestInterceptor *mRequestInterceptor;
 	QWebEngineView *mWebViewWidget;
 	QTimer *mJSCompletionTimer;
 	QString mPageContentHTML;
 	QString mPageContentTEXT;
+	QString mPageTitle;
+	QString mPageLanguage;
+	QString mPageRobots;
+	QUrl mPageCanonicalURL;
 	QList<QUrl> mPageLinks;
 	void createNewWebPage();
+	bool applyExtractionResult(const QVariant &result);
 private slots:
 	void waitForJSToFinish(bool ok);
-	void extractPageContentTEXT();
+	void extractPageContent();
 	void extractPageContentHTML();
-	void extractPageLinks();
+	void extractPageContentFromHTML();
 public:
 	WebPageProcessor(QObject *parent=nullptr);
 	void setHttpUserAgent(const QString &user_agent);
@@ -34,9 +41,16 @@ public:
 	const QString &getPageContentAsHTML() const;
 	const QString &getPageContentAsTEXT() const;
 	QString getPageTitle() const;
+	const QString &getPageLanguage() const;
+	const QString &getPageRobots() const;
+	const QUrl &getPageCanonicalURL() const;
+	bool isPageIndexingAllowed() const;
+	bool isPageFollowingAllowed() const;
 	QUrl getPageURL() const;
 	QByteArray getPageURLEncoded(QUrl::FormattingOptions options) const;
 	const QList<QUrl> &getPageLinks() const;
+	quint64 getRequestsAllowed() const;
+	quint64 getRequestsBlocked() const;
 signals:
 	void pageLoadingSuccess();
 	void pageLoadingFail();
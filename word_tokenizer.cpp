@@ -0,0 +1,229 @@
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "word_tokenizer.hpp"
+#include "simple_hash.hpp"
+#include "stemmer.hpp"
+
+static constexpr size_t WORD_LENGTH_MIN=3;
+static constexpr size_t WORD_LENGTH_MAX=32;
+static constexpr size_t SLOTS_NUM_INITIAL=1024;
+
+static constexpr char16_t CYRILLIC_FIRST=0x0400;
+static constexpr char16_t CYRILLIC_LAST=0x045F;
+static constexpr char16_t LATIN_CAPITAL_I_WITH_DOT=0x0130;
+static constexpr char16_t KELVIN_SIGN=0x212A;
+
+struct WordTokenizerTables
+{
+	uint8_t ascii[128];
+	char16_t cyrillic[CYRILLIC_LAST-CYRILLIC_FIRST+1];
+	constexpr WordTokenizerTables() : ascii(), cyrillic()
+	{
+		for(char16_t c='a'; c<='z'; c++)
+		{
+			ascii[c]=uint8_t(c);
+			ascii[c-('a'-'A')]=uint8_t(c);
+		}
+		for(char16_t c=0x0430; c<=0x044F; c++)
+		{
+			cyrillic[c-CYRILLIC_FIRST]=c;
+			cyrillic[c-0x20-CYRILLIC_FIRST]=c;
+		}
+		cyrillic[0x0451-CYRILLIC_FIRST]=0x0451;
+		cyrillic[0x0401-CYRILLIC_FIRST]=0x0451;
+	}
+};
+
+static constexpr WordTokenizerTables gWordTokenizerTables;
+
+WordCounter::WordCounter()
+{
+	mSlots.assign(SLOTS_NUM_INITIAL, 0);
+}
+
+void WordCounter::clear()
+{
+	if(!mEntries.empty())
+	{
+		memset(mSlots.data(), 0, mSlots.size()*sizeof(uint32_t));
+	}
+	mEntries.clear();
+	mArena.clear();
+}
+
+void WordCounter::rehash(size_t slots_num)
+{
+	mSlots.assign(slots_num, 0);
+	size_t mask=slots_num-1;
+	for(size_t i=0; i<mEntries.size(); i++)
+	{
+		size_t slot=mEntries[i].hash & mask;
+		while(mSlots[slot]!=0)
+		{
+			slot=(slot+1) & mask;
+		}
+		mSlots[slot]=uint32_t(i+1);
+	}
+}
+
+void WordCounter::add(const uint8_t *word, uint32_t len)
+{
+	add(word, len, word, len);
+}
+
+void WordCounter::add(const uint8_t *term, uint32_t len, const uint8_t *surface, uint32_t surface_len)
+{
+	uint64_t hash=xorshiftstar_hash_64(term, len);
+	size_t mask=mSlots.size()-1;
+	size_t slot=hash & mask;
+	while(mSlots[slot]!=0)
+	{
+		WordCount &entry=mEntries[mSlots[slot]-1];
+		if(entry.hash==hash && entry.length==len && memcmp(mArena.data()+entry.offset, term, len)==0)
+		{
+			entry.count++;
+			return;
+		}
+		slot=(slot+1) & mask;
+	}
+	mSlots[slot]=uint32_t(mEntries.size()+1);
+	uint32_t offset=uint32_t(mArena.size());
+	mArena.insert(mArena.end(), term, term+len);
+	uint32_t surfaceOffset=offset;
+	if(surface!=term)
+	{
+		surfaceOffset=uint32_t(mArena.size());
+		mArena.insert(mArena.end(), surface, surface+surface_len);
+	}
+	mEntries.push_back({hash, 1, offset, len, surfaceOffset, surface_len});
+	if(mEntries.size()*2>mSlots.size())
+	{
+		rehash(mSlots.size()*2);
+	}
+}
+
+size_t WordCounter::size() const
+{
+	return mEntries.size();
+}
+
+const std::vector<WordCount> &WordCounter::entries() const
+{
+	return mEntries;
+}
+
+const std::vector<uint8_t> &WordCounter::arena() const
+{
+	return mArena;
+}
+
+const uint8_t *WordCounter::word(const WordCount &entry) const
+{
+	return mArena.data()+entry.offset;
+}
+
+const uint8_t *WordCounter::surface(const WordCount &entry) const
+{
+	return mArena.data()+entry.surfaceOffset;
+}
+
+#if defined(__SSE2__)
+// Folds the next 8 code units into word when all of them are ASCII letters.
+static inline bool fold_ascii_letters_8(const char16_t *text, uint8_t *word)
+{
+	__m128i units=_mm_loadu_si128((const __m128i *)text);
+	__m128i folded=_mm_or_si128(units, _mm_set1_epi16(0x20));
+	__m128i belowA=_mm_cmplt_epi16(folded, _mm_set1_epi16('a'));
+	__m128i aboveZ=_mm_cmpgt_epi16(folded, _mm_set1_epi16('z'));
+	if(_mm_movemask_epi8(_mm_or_si128(belowA, aboveZ))!=0)
+	{
+		return false;
+	}
+	_mm_storel_epi64((__m128i *)word, _mm_packus_epi16(folded, folded));
+	return true;
+}
+#endif
+
+static inline void count_word(const uint8_t *word, size_t len, WordCounter &counter, int stemming_languages)
+{
+	if(stemming_languages==STEMMER_LANGUAGE_NONE)
+	{
+		counter.add(word, uint32_t(len));
+		return;
+	}
+	uint8_t stem[WORD_LENGTH_MAX*2];
+	size_t stemLength=stem_word_utf8(word, len, stemming_languages, stem);
+	counter.add(stem, uint32_t(stemLength), word, uint32_t(len));
+}
+
+void count_words(const char16_t *text, size_t len, WordCounter &counter, int stemming_languages)
+{
+	uint8_t word[WORD_LENGTH_MAX*2];
+	size_t wordBytes=0, wordChars=0;
+	size_t pos=0;
+	while(pos<len)
+	{
+#if defined(__SSE2__)
+		if(wordChars+8<=WORD_LENGTH_MAX && pos+8<=len && fold_ascii_letters_8(text+pos, word+wordBytes))
+		{
+			wordBytes+=8;
+			wordChars+=8;
+			pos+=8;
+			continue;
+		}
+#endif
+		char16_t c=text[pos++];
+		char16_t folded=0;
+		bool wordBreak=false;
+		if(c<0x80)
+		{
+			folded=gWordTokenizerTables.ascii[c];
+		}
+		else if(c>=CYRILLIC_FIRST && c<=CYRILLIC_LAST)
+		{
+			folded=gWordTokenizerTables.cyrillic[c-CYRILLIC_FIRST];
+		}
+		else if(c==KELVIN_SIGN)
+		{
+			folded='k';
+		}
+		else if(c==LATIN_CAPITAL_I_WITH_DOT)
+		{
+			// lowercases to 'i' followed by a combining dot above
+			folded='i';
+			wordBreak=true;
+		}
+		if(folded!=0)
+		{
+			if(wordChars<WORD_LENGTH_MAX)
+			{
+				if(folded<0x80)
+				{
+					word[wordBytes++]=uint8_t(folded);
+				}
+				else
+				{
+					word[wordBytes++]=uint8_t(0xC0 | (folded>>6));
+					word[wordBytes++]=uint8_t(0x80 | (folded & 0x3F));
+				}
+			}
+			wordChars++;
+			if(!wordBreak)
+			{
+				continue;
+			}
+		}
+		if(wordChars>=WORD_LENGTH_MIN && wordChars<=WORD_LENGTH_MAX)
+		{
+			count_word(word, wordBytes, counter, stemming_languages);
+		}
+		wordBytes=0;
+		wordChars=0;
+	}
+	if(wordChars>=WORD_LENGTH_MIN && wordChars<=WORD_LENGTH_MAX)
+	{
+		count_word(word, wordBytes, counter, stemming_languages);
+	}
+}
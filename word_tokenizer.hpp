@@ -0,0 +1,45 @@
+#ifndef WORD_TOKENIZER_HPP
+#define WORD_TOKENIZER_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// Single-pass word counter for UTF-16 text. Accepts the same words as
+// splitting the lowercased text on [^a-zа-яё]+ and keeping tokens of 3 to 32
+// characters. Words are folded to lowercase UTF-8 in place and hashed with
+// the same function as hash_function_64(), so no per-token strings are built.
+// With stemming enabled words are counted by stem; the first surface form seen
+// for each stem is kept for display.
+
+struct WordCount
+{
+	uint64_t hash;
+	uint64_t count;
+	uint32_t offset;
+	uint32_t length;
+	uint32_t surfaceOffset;
+	uint32_t surfaceLength;
+};
+
+class WordCounter
+{
+	std::vector<uint32_t> mSlots;
+	std::vector<WordCount> mEntries;
+	std::vector<uint8_t> mArena;
+	void rehash(size_t slots_num);
+public:
+	WordCounter();
+	void clear();
+	void add(const uint8_t *word, uint32_t len);
+	void add(const uint8_t *term, uint32_t len, const uint8_t *surface, uint32_t surface_len);
+	size_t size() const;
+	const std::vector<WordCount> &entries() const;
+	const std::vector<uint8_t> &arena() const;
+	const uint8_t *word(const WordCount &entry) const;
+	const uint8_t *surface(const WordCount &entry) const;
+};
+
+void count_words(const char16_t *text, size_t len, WordCounter &counter, int stemming_languages=0);
+
+#endif // WORD_TOKENIZER_HPP